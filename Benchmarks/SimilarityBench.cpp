@@ -0,0 +1,68 @@
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — similarity search benchmark
+//  Nearest-rhythm queries over 10k and 100k library fingerprints, checked
+//  against a plain per-step comparison and a full scan.
+//
+//    cmake -B build -DOBSTACLE_BENCHMARKS=ON && cmake --build build --target obstacle_similarity_bench
+// ─────────────────────────────────────────────────────────────────────────────
+#include <JuceHeader.h>
+#include <chrono>
+#include <cstdio>
+#include "SimilarityIndex.h"
+
+static int slowDistance (const uint64_t* a, const uint64_t* b)
+{
+    int d = 0;
+    for (int w = 0; w < SimilarityIndex::kWords; ++w)
+        for (int s = 0; s < 64; ++s)
+            d += (int)(((a[w] ^ b[w]) >> s) & 1u);
+    return d;
+}
+
+int main()
+{
+    juce::Random rng (1234);
+    std::printf ("%-8s %4s %12s  %s\n", "entries", "k", "query (ms)", "nearest distances");
+
+    for (int count : { 10000, 100000 })
+    {
+        // Patterns of 4-12 tracks, 16-64 steps, about a third of the steps on
+        std::vector<uint64_t> prints ((size_t)count * SimilarityIndex::kWords);
+        for (int i = 0; i < count; ++i)
+        {
+            Pattern p;
+            const int numTracks = 4 + rng.nextInt (9);
+            for (int t = 0; t < numTracks; ++t)
+            {
+                p.setTrackLength (t, 16 * (1 + rng.nextInt (4)));
+                p.stepBits[(size_t)t] = (uint64_t)rng.nextInt64() & (uint64_t)rng.nextInt64();
+            }
+            const auto f = SimilarityIndex::fingerprint (p, numTracks);
+            std::copy (f.begin(), f.end(), prints.begin() + (std::ptrdiff_t)i * SimilarityIndex::kWords);
+        }
+
+        SimilarityIndex::Fingerprint query {};
+        std::copy (prints.begin(), prints.begin() + SimilarityIndex::kWords, query.begin());
+
+        const int k = 16, runs = 20;
+        std::vector<SimilarityIndex::Match> found;
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < runs; ++r)
+            found = SimilarityIndex::nearest (prints.data(), count, query, k, [] (int) { return true; });
+        const double ms = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() - start).count() / runs;
+
+        // Right distances, and nothing closer left out
+        bool ok = (int)found.size() == k;
+        for (const auto& m : found)
+            ok = ok && m.distance == slowDistance (prints.data() + (size_t)m.index * SimilarityIndex::kWords, query.data());
+        int closer = 0;
+        for (int i = 0; i < count; ++i)
+            closer += SimilarityIndex::distance (prints.data() + (size_t)i * SimilarityIndex::kWords, query.data())
+                          < found.back().distance ? 1 : 0;
+        ok = ok && closer < k;
+
+        std::printf ("%-8d %4d %12.2f  %d .. %d%s\n", count, k, ms,
+                     found.front().distance, found.back().distance, ok ? "" : "  MISMATCH");
+    }
+    return 0;
+}
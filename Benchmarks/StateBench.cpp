@@ -0,0 +1,92 @@
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — state save / load benchmark
+//  Encodes and decodes a session at today's size (NUM_PATTERNS patterns,
+//  NUM_SONG_SLOTS slots, six tracks) and at 100x, and checks the round trip.
+//
+//    cmake -B build -DOBSTACLE_BENCHMARKS=ON && cmake --build build --target obstacle_state_bench
+// ─────────────────────────────────────────────────────────────────────────────
+#include <JuceHeader.h>
+#include <chrono>
+#include <cstdio>
+#include "StateFormat.h"
+
+static SessionState makeSession (int scale, juce::Random& rng)
+{
+    SessionState st;
+    st.layout.numTracks = DEFAULT_NUM_TRACKS;
+
+    for (int i = 0; i < 170; ++i)                      // about the plug-in's parameter count
+        st.params.push_back ({ "param_" + juce::String (i), rng.nextFloat() });
+
+    // One pattern in five left empty, one in five a copy of its neighbour
+    const int numPatterns = NUM_PATTERNS * scale;
+    for (int p = 0; p < numPatterns; ++p)
+    {
+        if (p % 5 == 4) { st.patterns.push_back (nullptr); continue; }
+        if (p % 5 == 3) { st.patterns.push_back (st.patterns.back()); continue; }
+
+        auto pat = std::make_shared<Pattern>();
+        for (int t = 0; t < st.layout.numTracks; ++t)
+        {
+            pat->setTrackLength (t, 16 * (1 + rng.nextInt (4)));
+            pat->stepBits[(size_t)t] = (uint64_t)rng.nextInt64() & stepMaskForLength (pat->trackLength[(size_t)t]);
+            if (isMelodicVoice (st.layout.voice[(size_t)t]))
+                for (int s = 0; s < pat->trackLength[(size_t)t]; ++s)
+                    pat->setNote (t, s, rng.nextInt (7));
+        }
+        st.patterns.push_back (std::move (pat));
+    }
+
+    for (int sl = 0; sl < NUM_SONG_SLOTS * scale; ++sl)
+        st.chain.push_back ({ (uint32_t)rng.nextInt (numPatterns), (uint32_t)(1 + rng.nextInt (MAX_REPEATS)) });
+    return st;
+}
+
+static bool sameSession (const SessionState& a, const SessionState& b)
+{
+    if (a.params.size() != b.params.size() || a.patterns.size() != b.patterns.size() || a.chain != b.chain)
+        return false;
+    for (size_t i = 0; i < a.patterns.size(); ++i)
+        if ((a.patterns[i] == nullptr) != (b.patterns[i] == nullptr)
+            || (a.patterns[i] != nullptr && *a.patterns[i] != *b.patterns[i]))
+            return false;
+    return true;
+}
+
+template <typename Fn>
+static double microsPerRun (int runs, Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i)
+        fn();
+    return std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main()
+{
+    juce::Random rng (1234);
+    bool ok = true;
+    std::printf ("%-6s %10s %10s %12s %12s  %s\n", "scale", "patterns", "slots", "save (us)", "load (us)", "bytes");
+
+    for (int scale : { 1, 100 })
+    {
+        const auto session = makeSession (scale, rng);
+        const int  runs    = scale == 1 ? 2000 : 20;
+
+        juce::MemoryBlock block;
+        const double save = microsPerRun (runs, [&] { StateFormat::write (session, block); });
+
+        SessionState loaded;
+        const double load = microsPerRun (runs, [&] {
+            loaded = SessionState();
+            StateFormat::read (block.getData(), block.getSize(), loaded);
+        });
+        const bool same = sameSession (session, loaded);
+        ok = ok && same;
+
+        std::printf ("%-6s %10d %10d %12.1f %12.1f  %zu%s\n",
+                     (juce::String (scale) + "x").toRawUTF8(), (int)session.patterns.size(), (int)session.chain.size(),
+                     save, load, block.getSize(), same ? "" : "  ROUND TRIP FAILED");
+    }
+    return ok ? 0 : 1;
+}
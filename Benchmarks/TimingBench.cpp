@@ -0,0 +1,177 @@
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — trigger timing jitter
+//  Runs the sequencer clock at tempos whose steps are not a whole number of
+//  samples, starts a voice on every tick and measures where each note
+//  actually begins against the tick's exact time: the bass from its first
+//  sample, the kick on its pitch sweep once the click and the noise have
+//  died away (noise has no phase to be late by). Each note is fitted to a
+//  reference note (started on a sample) shifted by a fraction of a sample;
+//  the error is the fitted start minus the exact one, less its mean. Notes
+//  started on the tick's sample ("whole") wander by up to half a sample
+//  either way (0.29 rms); notes started with the tick's sub-sample lateness
+//  ("fractional") should stay within a few thousandths of one. Exits with 1
+//  if any fractional run exceeds kMaxJitter, or if a whole run shows no
+//  jitter (the measurement itself is broken).
+//
+//    cmake -B build -DOBSTACLE_BENCHMARKS=ON && cmake --build build --target obstacle_timing_bench
+// ─────────────────────────────────────────────────────────────────────────────
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "SeqClock.h"
+#include "SynthEngine.h"
+
+static constexpr int   kWindow   = 256;     // samples of each note that are compared
+static constexpr int   kNotes    = 400;
+static constexpr int   kBlock    = 512;
+static constexpr float kNoteFreq = 55.f;      // no saw wrap inside the window at 22.05 kHz
+
+static constexpr double kMaxJitter    = 0.01;   // worst fractional error allowed (samples)
+static constexpr double kMinWholeRms  = 0.2;    // whole starts must show their jitter
+
+enum class Voice { Bass, Kick };
+
+// Where a voice is compared: the kick after its 40 ms noise thump
+static int windowStart (Voice voice, double sampleRate)
+{
+    return voice == Voice::Kick ? (int)(0.045 * sampleRate) : 0;
+}
+
+template <typename Bank>
+static std::vector<float> renderBank (Bank& bank, int n)
+{
+    std::vector<float> out ((size_t)n, 0.f);
+    float* dest[kVoicesPerBank] = {};
+    float  gains[kVoicesPerBank] = {};
+    dest[0]  = out.data();
+    gains[0] = 1.f;
+    bank.render (dest, n, gains);
+    return out;
+}
+
+// n samples of the compared window of a note started `late` samples after its time
+static std::vector<float> renderNote (Voice voice, double sampleRate, float late, int n)
+{
+    const int skip = windowStart (voice, sampleRate);
+    std::vector<float> out;
+    if (voice == Voice::Kick)
+    {
+        KickBank bank;
+        bank.prepare ((float)sampleRate);
+        bank.trigger (0, late);
+        out = renderBank (bank, skip + n);
+    }
+    else
+    {
+        BassBank bank;
+        bank.prepare ((float)sampleRate);
+        bank.trigger (0, kNoteFreq, late);
+        out = renderBank (bank, skip + n);
+    }
+    out.erase (out.begin(), out.begin() + skip);
+    return out;
+}
+
+// Catmull-Rom interpolation of x at fractional index i
+static float sampleAt (const std::vector<float>& x, double i)
+{
+    const int   k = (int)std::floor (i);
+    const float f = (float)(i - k);
+    auto at = [&] (int j) { return j >= 0 && j < (int)x.size() ? x[(size_t)j] : 0.f; };
+    const float a = at (k - 1), b = at (k), c = at (k + 1), d = at (k + 2);
+    return b + 0.5f * f * (c - a + f * (2.f * a - 5.f * b + 4.f * c - d + f * (3.f * (b - c) + d - a)));
+}
+
+// Shift d (samples) of the reference that best matches the note
+static double fitShift (const std::vector<float>& note, const std::vector<float>& ref)
+{
+    auto error = [&] (double d) {
+        double e = 0.0;
+        for (int k = 2; k < kWindow; ++k)
+        {
+            const double diff = note[(size_t)k] - sampleAt (ref, k + d);
+            e += diff * diff;
+        }
+        return e;
+    };
+
+    double best = 0.0, bestErr = error (0.0);
+    for (double step : { 0.1, 0.01, 0.001, 0.0001 })
+    {
+        const double centre = best;
+        for (int j = -20; j <= 20; ++j)
+        {
+            const double d = centre + j * step;
+            if (const double e = error (d); e < bestErr) { best = d; bestErr = e; }
+        }
+    }
+    return best;
+}
+
+struct Jitter
+{
+    double rms = 0.0, worst = 0.0;
+};
+
+static Jitter measure (Voice voice, double sampleRate, double bpm, bool fractional)
+{
+    SeqClock clock;
+    clock.prepare (sampleRate);
+    clock.setTempo (bpm);
+
+    const auto ref = renderNote (voice, sampleRate, 0.f, kWindow + 4);
+
+    // Errors are taken against their mean: a constant offset is latency, not jitter
+    std::vector<double> errors;
+    while ((int)errors.size() < kNotes)
+    {
+        while (clock.nextTickOffset() < kBlock && (int)errors.size() < kNotes)
+        {
+            const auto tick = clock.consumeTick();
+            const auto note = renderNote (voice, sampleRate, fractional ? tick.late : 0.f, kWindow);
+
+            // It sounds as if started fitShift() samples before the tick's
+            // sample; the exact time was tick.late before it
+            errors.push_back ((double)tick.late - fitShift (note, ref));
+        }
+        clock.endBlock (kBlock);
+    }
+
+    double mean = 0.0;
+    for (double e : errors) mean += e;
+    mean /= (double)errors.size();
+
+    Jitter j;
+    for (double e : errors)
+    {
+        j.rms  += (e - mean) * (e - mean);
+        j.worst = juce::jmax (j.worst, std::abs (e - mean));
+    }
+    j.rms = std::sqrt (j.rms / (double)errors.size());
+    return j;
+}
+
+int main()
+{
+    std::printf ("%-5s %-8s %6s %18s %18s\n", "voice", "rate", "bpm", "whole rms / max", "fractional rms / max");
+
+    bool ok = true;
+    for (auto voice : { Voice::Bass, Voice::Kick })
+        for (double sampleRate : { 22050.0, 44100.0, 48000.0 })
+            for (double bpm : { 97.0, 137.0, 174.0 })
+            {
+                const auto whole = measure (voice, sampleRate, bpm, false);
+                const auto frac  = measure (voice, sampleRate, bpm, true);
+                const bool pass  = frac.worst <= kMaxJitter && whole.rms >= kMinWholeRms;
+                ok = ok && pass;
+                std::printf ("%-5s %-8.0f %6.0f %8.3f / %6.3f %10.3f / %6.3f   samples%s\n",
+                             voice == Voice::Kick ? "kick" : "bass", sampleRate, bpm,
+                             whole.rms, whole.worst, frac.rms, frac.worst, pass ? "" : "   FAIL");
+            }
+
+    std::printf (ok ? "fractional starts within %.3f samples\n"
+                    : "FAILED: fractional jitter above %.3f samples, or none measured for whole starts\n",
+                 kMaxJitter);
+    return ok ? 0 : 1;
+}
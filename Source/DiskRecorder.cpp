@@ -0,0 +1,174 @@
+#include "DiskRecorder.h"
+#include <cmath>
+#include <thread>
+
+// ─────────────────────────────────────────────────────────────────────────────
+juce::File DiskRecorder::defaultDirectory()
+{
+    return juce::File::getSpecialLocation (juce::File::userMusicDirectory)
+               .getChildFile ("OBSTACLE");
+}
+
+DiskRecorder::DiskRecorder()
+    : juce::Thread ("OBSTACLE recorder")
+{
+}
+
+DiskRecorder::~DiskRecorder()
+{
+    stop();
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Message thread
+// ─────────────────────────────────────────────────────────────────────────────
+bool DiskRecorder::start (const juce::File& target, double rate, int bitsPerSample)
+{
+    stop();
+
+    std::unique_ptr<juce::AudioFormat> format;
+    if (target.hasFileExtension ("flac"))
+        format = std::make_unique<juce::FlacAudioFormat>();
+    else
+        format = std::make_unique<juce::WavAudioFormat>();
+
+    target.getParentDirectory().createDirectory();
+    target.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream = target.createOutputStream();
+    if (stream == nullptr)
+        return false;
+
+    // FLAC: the fastest setting keeps the writer well ahead of the audio
+    writer.reset (format->createWriterFor (stream.get(), rate, 2,
+                                           target.hasFileExtension ("flac") ? juce::jmin (bitsPerSample, 24) : bitsPerSample,
+                                           {}, 0));
+    if (writer == nullptr)
+        return false;
+    stream.release();   // owned by the writer
+
+    file       = target;
+    sampleRate = rate;
+
+    const int capacity = (int)std::ceil (kFifoSeconds * rate) + 1;
+    ring.setSize (2, capacity, false, false, true);
+    fifo.setTotalSize (capacity);
+
+    samplesWritten.store (0);
+    samplesDropped.store (0);
+    dropouts.store (0);
+    peakReady.store (0);
+    writeFailed.store (false);
+
+    startThread (juce::Thread::Priority::high);
+    armed.store (true);
+    return true;
+}
+
+void DiskRecorder::stop()
+{
+    if (!armed.exchange (false))
+        return;
+
+    while (pushing.load())
+        std::this_thread::yield();
+
+    // The thread writes out the rest of the ring before it exits
+    signalThreadShouldExit();
+    notify();
+    waitForThreadToExit (-1);
+    writer.reset();   // final header
+}
+
+DiskRecorder::Stats DiskRecorder::getStats() const
+{
+    Stats s;
+    s.samplesWritten = samplesWritten.load();
+    s.samplesDropped = samplesDropped.load();
+    s.dropouts       = dropouts.load();
+    s.peakFill       = (float)peakReady.load() / (float)juce::jmax (1, fifo.getTotalSize() - 1);
+    s.writeFailed    = writeFailed.load();
+    return s;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Audio thread
+// ─────────────────────────────────────────────────────────────────────────────
+void DiskRecorder::push (const juce::AudioBuffer<float>& buffer) noexcept
+{
+    pushing.store (true);
+    if (armed.load())
+    {
+        const int n = buffer.getNumSamples();
+        if (fifo.getFreeSpace() < n)
+        {
+            dropouts.fetch_add (1);
+            samplesDropped.fetch_add (n);
+        }
+        else
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite (n, start1, size1, start2, size2);
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                const float* src = buffer.getReadPointer (juce::jmin (ch, buffer.getNumChannels() - 1));
+                juce::FloatVectorOperations::copy (ring.getWritePointer (ch, start1), src, size1);
+                if (size2 > 0)
+                    juce::FloatVectorOperations::copy (ring.getWritePointer (ch, start2), src + size1, size2);
+            }
+            fifo.finishedWrite (size1 + size2);
+
+            const int ready = fifo.getNumReady();
+            if (ready > peakReady.load (std::memory_order_relaxed))
+                peakReady.store (ready, std::memory_order_relaxed);
+        }
+    }
+    pushing.store (false);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Recorder thread
+// ─────────────────────────────────────────────────────────────────────────────
+void DiskRecorder::drain()
+{
+    const int ready = fifo.getNumReady();
+    if (ready == 0)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (ready, start1, size1, start2, size2);
+
+    if (!writeFailed.load())
+    {
+        const float* part1[] = { ring.getReadPointer (0, start1), ring.getReadPointer (1, start1) };
+        bool ok = writer->writeFromFloatArrays (part1, 2, size1);
+        if (ok && size2 > 0)
+        {
+            const float* part2[] = { ring.getReadPointer (0, start2), ring.getReadPointer (1, start2) };
+            ok = writer->writeFromFloatArrays (part2, 2, size2);
+        }
+
+        if (ok)
+            samplesWritten.fetch_add (size1 + size2);
+        else
+            writeFailed.store (true);
+    }
+
+    fifo.finishedRead (size1 + size2);   // a failed take still empties the ring
+}
+
+void DiskRecorder::run()
+{
+    auto lastFlush = juce::Time::getMillisecondCounter();
+    while (!threadShouldExit())
+    {
+        wait (kWriteIntervalMs);
+        drain();
+
+        if (juce::Time::getMillisecondCounter() - lastFlush >= (juce::uint32)kFlushIntervalMs)
+        {
+            writer->flush();   // WAV rewrites its header; FLAC has nothing to do
+            lastFlush = juce::Time::getMillisecondCounter();
+        }
+    }
+    drain();   // stop(): the audio thread is out, this is the rest
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  DiskRecorder — the main output to a WAV or FLAC file, for the Standalone app
+//
+//  processBlock() hands every block to push(), which copies it into a ring
+//  of kFifoSeconds allocated by start(). The recorder thread drains the ring
+//  into the file writer every kWriteIntervalMs and has the writer rewrite
+//  its header every kFlushIntervalMs, so a crash leaves a playable file. The
+//  audio thread never touches the writer, the disk or the heap.
+//
+//  A block that does not fit in the ring (the disk stalled for the whole
+//  ring) is dropped whole and counted; the take is that much shorter.
+// ─────────────────────────────────────────────────────────────────────────────
+class DiskRecorder : private juce::Thread
+{
+public:
+    // ~/Music/OBSTACLE and equivalents
+    static juce::File defaultDirectory();
+
+    DiskRecorder();
+    ~DiskRecorder() override;
+
+    struct Stats
+    {
+        juce::int64 samplesWritten = 0;
+        juce::int64 samplesDropped = 0;
+        int         dropouts       = 0;      // blocks dropped
+        float       peakFill       = 0.f;    // highest ring fill so far, 0-1
+        bool        writeFailed    = false;  // the disk refused; nothing more is written
+    };
+
+    // ── Message thread ──────────────────────────────────────────────────────
+    // Record to `file` (.flac: FLAC, anything else: WAV), replacing it; false
+    // if it cannot be created. Ends a take in progress first.
+    bool start (const juce::File& file, double sampleRate, int bitsPerSample = 24);
+
+    // Writes out what is still in the ring and closes the file
+    void stop();
+
+    bool        isRecording() const     { return armed.load(); }
+    const juce::File& getFile() const   { return file; }
+    double      getSampleRate() const   { return sampleRate; }
+    Stats       getStats() const;
+
+    // ── Audio thread ────────────────────────────────────────────────────────
+    // Channels 0 and 1 of the block (0 twice for mono); nothing unless recording
+    void push (const juce::AudioBuffer<float>& buffer) noexcept;
+
+private:
+    static constexpr double kFifoSeconds     = 4.0;
+    static constexpr int    kWriteIntervalMs = 50;
+    static constexpr int    kFlushIntervalMs = 5000;
+
+    void drain();   // recorder thread
+    void run() override;
+
+    // Set up by start() while the audio thread stays out (armed is false)
+    juce::File                               file;
+    double                                   sampleRate = 44100.0;
+    std::unique_ptr<juce::AudioFormatWriter> writer;   // recorder thread while armed
+    juce::AudioBuffer<float>                 ring;
+    juce::AbstractFifo                       fifo { 1 };
+
+    // stop() clears `armed`, then waits while a push() that may have seen it
+    // set is still running: the ring and the writer are then ours again
+    std::atomic<bool> armed   { false };
+    std::atomic<bool> pushing { false };
+
+    std::atomic<juce::int64> samplesWritten { 0 };
+    std::atomic<juce::int64> samplesDropped { 0 };
+    std::atomic<int>         dropouts       { 0 };
+    std::atomic<int>         peakReady      { 0 };
+    std::atomic<bool>        writeFailed    { false };
+
+    JUCE_DECLARE_NON_COPYABLE (DiskRecorder)
+};
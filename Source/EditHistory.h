@@ -0,0 +1,151 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include "Pattern.h"
+#include "PatternBank.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  PersistentArray — fixed-size array as a root of shared, immutable leaves
+//
+//  Copying one is a pointer copy. A new version is built against an older
+//  one and takes over every leaf whose values are unchanged, so a version
+//  costs one root plus the leaves that differ. Two versions built that way
+//  hold equal values exactly when they share the root.
+// ─────────────────────────────────────────────────────────────────────────────
+template <typename T, int N, int LeafSize>
+class PersistentArray
+{
+public:
+    static_assert (N % LeafSize == 0, "leaves must tile the array");
+    static constexpr int kLeaves = N / LeafSize;
+
+    using Leaf = std::array<T, LeafSize>;
+
+    // A version whose value i is get (i), sharing what it can with `base`
+    template <typename Get>
+    static PersistentArray build (const PersistentArray* base, Get&& get)
+    {
+        auto root = std::make_shared<Root>();
+        bool allShared = base != nullptr;
+        for (int l = 0; l < kLeaves; ++l)
+        {
+            Leaf values;
+            for (int i = 0; i < LeafSize; ++i)
+                values[(size_t)i] = get (l * LeafSize + i);
+
+            if (base != nullptr && base->leaf (l) == values)
+                (*root)[(size_t)l] = (*base->root)[(size_t)l];
+            else
+            {
+                (*root)[(size_t)l] = std::make_shared<const Leaf> (values);
+                allShared = false;
+            }
+        }
+
+        PersistentArray a;
+        a.root = allShared ? base->root : std::move (root);
+        return a;
+    }
+
+    const T& operator[] (int i) const { return leaf (i / LeafSize)[(size_t)(i % LeafSize)]; }
+
+    const Leaf& leaf (int l) const { return *(*root)[(size_t)l]; }
+
+    // Same storage for leaf l: its values are equal and need no comparing
+    bool sharesLeaf (const PersistentArray& o, int l) const { return (*root)[(size_t)l] == (*o.root)[(size_t)l]; }
+
+    bool operator== (const PersistentArray& o) const { return root == o.root; }
+    bool operator!= (const PersistentArray& o) const { return root != o.root; }
+
+private:
+    using Root = std::array<std::shared_ptr<const Leaf>, kLeaves>;
+    std::shared_ptr<const Root> root;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  EditHistory — unlimited undo / redo of the patterns and the song chain
+//
+//  Every version shares unchanged banks of patterns and unchanged pages of
+//  the chain with the one before it; patterns themselves are the bank's
+//  copy-on-write storage, held rather than copied. An edit therefore costs
+//  a root, the bank / page it touched and (once the bank unshares it) one
+//  pattern. Undo and redo move a cursor; the caller applies the difference
+//  between the two versions, found by comparing leaves. Message thread only.
+// ─────────────────────────────────────────────────────────────────────────────
+class EditHistory
+{
+public:
+    static constexpr int kChainPage = 64;   // song slots per chain leaf
+
+    using PatternArray = PersistentArray<std::shared_ptr<const Pattern>, NUM_PATTERNS, PATTERNS_PER_BANK>;
+    using ChainArray   = PersistentArray<SongSlot, NUM_SONG_SLOTS, kChainPage>;
+
+    struct Version
+    {
+        PatternArray patterns;
+        ChainArray   chain;
+        int          chainLength = 1;
+
+        bool operator== (const Version& o) const
+        {
+            return patterns == o.patterns && chain == o.chain && chainLength == o.chainLength;
+        }
+    };
+
+    // Forget everything; the current state becomes the only version
+    void reset (const PatternBank& bank, const std::array<SongSlot, NUM_SONG_SLOTS>& chain, int chainLength)
+    {
+        versions.clear();
+        versions.push_back (capture (nullptr, bank, chain, chainLength));
+        cursor = 0;
+    }
+
+    // Add the current state as a new version unless it is the current one;
+    // versions that were undone are dropped
+    bool record (const PatternBank& bank, const std::array<SongSlot, NUM_SONG_SLOTS>& chain, int chainLength)
+    {
+        auto v = capture (versions.empty() ? nullptr : &versions[cursor], bank, chain, chainLength);
+        if (!versions.empty() && v == versions[cursor])
+            return false;
+
+        versions.resize (versions.empty() ? 0 : cursor + 1);
+        versions.push_back (std::move (v));
+        cursor = versions.size() - 1;
+        return true;
+    }
+
+    bool canUndo() const { return cursor > 0; }
+    bool canRedo() const { return cursor + 1 < versions.size(); }
+
+    const Version& current() const { return versions[cursor]; }
+
+    // Step back / forward; returns the version left behind, to diff against
+    Version undo() { jassert (canUndo()); return versions[cursor--]; }
+    Version redo() { jassert (canRedo()); return versions[cursor++]; }
+
+    int size() const { return (int)versions.size(); }
+
+private:
+    static Version capture (const Version* base, const PatternBank& bank,
+                            const std::array<SongSlot, NUM_SONG_SLOTS>& chain, int chainLength)
+    {
+        Version v;
+        v.patterns = PatternArray::build (base != nullptr ? &base->patterns : nullptr, [&] (int i) {
+            // Equal content under other storage (interning) keeps the old pointer
+            auto p = bank.share (i);
+            if (base != nullptr && base->patterns[i] != p && *base->patterns[i] == *p)
+                return base->patterns[i];
+            return p;
+        });
+        v.chain = ChainArray::build (base != nullptr ? &base->chain : nullptr, [&] (int i) {
+            return chain[(size_t)i];
+        });
+        v.chainLength = chainLength;
+        return v;
+    }
+
+    std::vector<Version> versions;
+    size_t               cursor = 0;
+};
@@ -0,0 +1,219 @@
+#include "EditJournal.h"
+
+namespace
+{
+    uint32_t get32 (const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+juce::File EditJournal::defaultDirectory()
+{
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+               .getChildFile ("OBSTACLE")
+               .getChildFile ("Journal");
+}
+
+EditJournal::EditJournal (juce::File dir)
+    : juce::Thread ("OBSTACLE journal"), directory (std::move (dir))
+{
+    open ({}, 0, nullptr);
+    startThread (juce::Thread::Priority::low);
+}
+
+EditJournal::~EditJournal()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (2000);
+
+    const juce::ScopedLock fl (fileLock);
+    closeFile (true);
+    lock.reset();
+}
+
+juce::File EditJournal::fileFor (const juce::String& journalId) const
+{
+    return directory.getChildFile (journalId + ".objnl");
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Message thread
+// ─────────────────────────────────────────────────────────────────────────────
+bool EditJournal::open (const juce::String& wantedId, uint32_t wantedSeq, SessionState* state)
+{
+    const juce::ScopedLock fl (fileLock);
+    {
+        const juce::ScopedLock ql (queueLock);
+        queue.clear();
+    }
+    base = nullptr;
+
+    // Our own journal: the host went back to a state of this session (its
+    // undo, a preset), whose later edits are not to be replayed
+    if (wantedId.isNotEmpty() && wantedId == id)
+        return false;
+
+    closeFile (true);   // the loaded state replaces everything it recorded
+    lock.reset();
+
+    Replayed r;
+    if (wantedId.isNotEmpty() && (lock = FileLock::tryLock (fileFor (wantedId))) != nullptr)
+    {
+        id   = wantedId;
+        file = fileFor (id);
+        r    = replay (file, wantedSeq, state);
+        seq  = juce::jmax (wantedSeq, r.lastSeq);
+    }
+    else
+    {
+        // A new journal; none at all if the directory can't be written
+        id   = {};
+        file = juce::File();
+        seq  = 0;
+        for (int attempt = 0; attempt < 3 && lock == nullptr; ++attempt)
+        {
+            const auto fresh = juce::Uuid().toString();
+            if ((lock = FileLock::tryLock (fileFor (fresh))) != nullptr)
+            {
+                id   = fresh;
+                file = fileFor (id);
+            }
+        }
+    }
+    validBytes = r.validBytes;
+    return r.applied;
+}
+
+void EditJournal::append (std::shared_ptr<const SessionState> state)
+{
+    const juce::ScopedLock ql (queueLock);
+    queue.push_back ({ ++seq, std::move (state) });
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Replay — records up to the first torn or damaged one
+// ─────────────────────────────────────────────────────────────────────────────
+EditJournal::Replayed EditJournal::replay (const juce::File& f, uint32_t fromSeq, SessionState* state) const
+{
+    Replayed r;
+    juce::MemoryBlock data;
+    if (!f.existsAsFile() || !f.loadFileAsData (data) || data.getSize() < kHeaderBytes)
+        return r;
+
+    const auto* bytes = static_cast<const uint8_t*> (data.getData());
+    const size_t size = data.getSize();
+    if (get32 (bytes) != kMagic || (int)(get32 (bytes + 4) & 0xFFFF) > kVersion)
+        return r;
+
+    size_t pos = kHeaderBytes;
+    while (pos + 4 <= size)
+    {
+        const uint32_t recSeq = get32 (bytes + pos);
+        const size_t   block  = StateFormat::blockSize (bytes + pos + 4, size - pos - 4);
+        if (block == 0)
+            break;
+
+        if (recSeq > fromSeq && state != nullptr)
+        {
+            if (!StateFormat::applyChanges (bytes + pos + 4, block, *state))
+                break;
+            r.applied = true;
+        }
+        r.lastSeq = juce::jmax (r.lastSeq, recSeq);
+        pos += 4 + block;
+    }
+    r.validBytes = (juce::int64)pos;
+    return r;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Journal thread
+// ─────────────────────────────────────────────────────────────────────────────
+void EditJournal::closeFile (bool remove)
+{
+    stream.reset();
+    if (remove && lock != nullptr && file.existsAsFile())
+        file.deleteFile();
+}
+
+bool EditJournal::openStream()
+{
+    if (lock == nullptr)
+        return false;
+
+    directory.createDirectory();
+    stream = std::make_unique<juce::FileOutputStream> (file);   // positioned at the end
+    if (!stream->openedOk())
+    {
+        stream.reset();
+        return false;
+    }
+
+    // Drop a torn tail, or start the file
+    if (stream->getPosition() != validBytes)
+    {
+        stream->setPosition (validBytes);
+        stream->truncate();
+    }
+    if (validBytes < (juce::int64)kHeaderBytes)
+    {
+        stream->setPosition (0);
+        stream->truncate();
+        stream->writeInt ((int)kMagic);
+        stream->writeShort ((short)kVersion);
+        stream->writeShort (0);
+    }
+    return true;
+}
+
+void EditJournal::writePending()
+{
+    const juce::ScopedLock fl (fileLock);
+    std::vector<Queued> batch;
+    {
+        const juce::ScopedLock ql (queueLock);
+        batch.swap (queue);
+    }
+
+    bool wrote = false;
+    for (auto& q : batch)
+    {
+        juce::MemoryBlock block;
+        if (base != nullptr && StateFormat::writeChanges (*base, *q.state, block)
+            && (stream != nullptr || openStream()))
+        {
+            stream->writeInt ((int)q.seq);
+            stream->write (block.getData(), block.getSize());
+            wrote = true;
+        }
+        base = std::move (q.state);
+    }
+
+    if (wrote)
+    {
+        stream->flush();   // fsync
+        validBytes = stream->getPosition();
+    }
+}
+
+void EditJournal::removeStale()
+{
+    const auto cutoff = juce::Time::getCurrentTime() - juce::RelativeTime::days (kMaxAgeDays);
+    for (const auto& f : directory.findChildFiles (juce::File::findFiles, false, "*.objnl"))
+        if (f.getLastModificationTime() < cutoff)
+            if (auto held = FileLock::tryLock (f))   // not being written by any instance
+                f.deleteFile();
+}
+
+void EditJournal::run()
+{
+    removeStale();
+    while (!threadShouldExit())
+    {
+        wait (kFlushIntervalMs);
+        writePending();
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+#include "FileLock.h"
+#include "StateFormat.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  EditJournal — append-only record of edits, for recovery after a crash
+//
+//    header  'OBSJ' | u16 version | u16 reserved                    (8 bytes)
+//    records u32 sequence number | StateFormat change block (checksummed)
+//
+//  The message thread hands over a SessionState after each edit (pointer
+//  copies: patterns are shared, immutable storage). The journal thread diffs
+//  consecutive states, appends only what changed and syncs the file to disk
+//  every kFlushIntervalMs. A saved state names its journal and the sequence
+//  number it was saved at; loading it replays the records written after
+//  that, i.e. the edits the host never saved. A torn last record fails its
+//  checksum and ends the replay.
+//
+//  A journal is held under an exclusive OS lock on its file for as long as
+//  an instance writes it, which keeps out every other instance, in this
+//  process or another host's. An instance that closes normally deletes its
+//  journal: edits it never saved were discarded on purpose. Journals left
+//  behind by a crash are removed after kMaxAgeDays, once their lock can be
+//  taken. Nothing is deleted without holding its lock. Never used by the
+//  audio thread.
+// ─────────────────────────────────────────────────────────────────────────────
+class EditJournal : private juce::Thread
+{
+public:
+    // ~/Library/Application Support/OBSTACLE/Journal and equivalents
+    static juce::File defaultDirectory();
+
+    explicit EditJournal (juce::File directory);
+    ~EditJournal() override;
+
+    // ── Message thread ──────────────────────────────────────────────────────
+    // Continue journal `id` from a state saved at record `seq`, first applying
+    // the records after it to `state`; true if there were any. An empty id,
+    // or one another instance is writing (a duplicated plug-in, another host),
+    // starts a new journal. Ends the current journal, whose edits the state
+    // replaces.
+    bool open (const juce::String& id, uint32_t seq, SessionState* state);
+
+    // Queue the state after an edit; the first one after open() is the base
+    // the following ones are diffed against
+    void append (std::shared_ptr<const SessionState> state);
+
+    // For the state being saved: the journal and its last queued record
+    const juce::String& getId() const { return id; }
+    uint32_t            getSeq() const { return seq; }
+
+private:
+    static constexpr uint32_t kMagic           = 0x4A53424F;   // "OBSJ"
+    static constexpr int      kVersion         = 1;
+    static constexpr size_t   kHeaderBytes     = 8;
+    static constexpr int      kFlushIntervalMs = 500;
+    static constexpr int      kMaxAgeDays      = 30;
+
+    struct Queued
+    {
+        uint32_t                            seq = 0;
+        std::shared_ptr<const SessionState> state;
+    };
+
+    struct Replayed
+    {
+        uint32_t    lastSeq    = 0;
+        juce::int64 validBytes = 0;       // header + intact records
+        bool        applied    = false;
+    };
+
+    juce::File fileFor (const juce::String& journalId) const;
+    Replayed   replay (const juce::File& f, uint32_t fromSeq, SessionState* state) const;
+    bool       openStream();
+    void       closeFile (bool remove);
+    void       writePending();
+    void       removeStale();
+
+    void run() override;
+
+    juce::File   directory;
+
+    // Message thread
+    juce::String id;
+    uint32_t     seq = 0;
+
+    juce::CriticalSection fileLock;    // file, lock, stream, base (held while writing)
+    juce::File            file;
+    std::unique_ptr<FileLock> lock;    // on `file`; none when journaling is off
+    juce::int64           validBytes = 0;   // appends start here
+    std::unique_ptr<juce::FileOutputStream> stream;
+    std::shared_ptr<const SessionState>     base;   // last state diffed against
+
+    juce::CriticalSection queueLock;   // queue (message + journal thread)
+    std::vector<Queued>   queue;
+
+    JUCE_DECLARE_NON_COPYABLE (EditJournal)
+};
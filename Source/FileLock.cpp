@@ -0,0 +1,65 @@
+#include "FileLock.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/file.h>
+ #include <unistd.h>
+#endif
+
+FileLock::~FileLock()
+{
+   #if JUCE_WINDOWS
+    if (handle != nullptr) CloseHandle ((HANDLE) handle);
+   #else
+    if (fd >= 0) ::close (fd);
+   #endif
+}
+
+std::unique_ptr<FileLock> FileLock::tryLock (const juce::File& f)
+{
+    f.getParentDirectory().createDirectory();
+    std::unique_ptr<FileLock> held (new FileLock());
+
+   #if JUCE_WINDOWS
+    // Read access and every share mode, so write streams and mappings still
+    // open and the file can still be deleted. Byte-range locks are mandatory
+    // here, so the locked byte lies far past the end of any file.
+    const HANDLE h = CreateFileW (f.getFullPathName().toWideCharPointer(), GENERIC_READ,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return nullptr;
+    held->handle = h;
+
+    OVERLAPPED at {};
+    at.OffsetHigh = 0x7FFFFFFF;
+    if (!LockFileEx (h, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &at))
+        return nullptr;
+   #else
+    // flock() belongs to the open file description: a second instance in
+    // this process is refused like one in another process
+    held->fd = ::open (f.getFullPathName().toRawUTF8(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (held->fd < 0 || ::flock (held->fd, LOCK_EX | LOCK_NB) != 0)
+        return nullptr;
+   #endif
+
+    return held;
+}
+
+std::unique_ptr<FileLock> FileLock::lock (const juce::File& f, int timeoutMs)
+{
+    const auto giveUp = juce::Time::getMillisecondCounter() + (juce::uint32) juce::jmax (0, timeoutMs);
+    for (;;)
+    {
+        if (auto held = tryLock (f))
+            return held;
+        if (juce::Time::getMillisecondCounter() >= giveUp)
+            return nullptr;
+        juce::Thread::sleep (5);
+    }
+}
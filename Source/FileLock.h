@@ -0,0 +1,33 @@
+#pragma once
+#include <JuceHeader.h>
+#include <memory>
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  FileLock — an exclusive OS lock on a file (created if missing), released
+//  when destroyed. It is taken through a handle of its own, so it outlives
+//  the streams opened and closed around it, and it refuses a second
+//  instance in this process like one in another process. The file's
+//  contents stay readable and writable by everyone.
+// ─────────────────────────────────────────────────────────────────────────────
+class FileLock
+{
+public:
+    ~FileLock();
+
+    // Null if another instance holds the lock or the file can't be opened
+    static std::unique_ptr<FileLock> tryLock (const juce::File& f);
+
+    // Waits up to `timeoutMs` for another instance to let go
+    static std::unique_ptr<FileLock> lock (const juce::File& f, int timeoutMs);
+
+private:
+    FileLock() = default;
+
+   #if JUCE_WINDOWS
+    void* handle = nullptr;   // HANDLE
+   #else
+    int fd = -1;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (FileLock)
+};
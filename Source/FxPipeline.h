@@ -0,0 +1,340 @@
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "LockFree.h"
+#include "SynthEngine.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — two-stage pipeline: voices on the audio thread, FX on a worker
+// ─────────────────────────────────────────────────────────────────────────────
+//  Callback N renders its dry voice mix while the worker runs the master
+//  FXChain over the dry mix of callback N-1. The wet output is a FIFO that
+//  starts with `latency` zeros (the prepared block size), so every sample
+//  comes out exactly `latency` samples late, whatever block sizes the host
+//  sends. A block larger than the prepared size cannot be pipelined.
+//
+//  Each stage carries the three FXChain inputs: direct, delay send, reverb
+//  send. While the pipeline is active only whoever claims the queued stage
+//  touches the FXChain: the worker, or the audio thread itself when the
+//  worker has not woken by the end of the block, so a late wake never makes
+//  the block miss its deadline. FX controls are queued with their sample
+//  offset and applied at the same dry sample, so automation stays
+//  sample-accurate, one block later.
+//
+//  The worker thread only runs while pipeline mode is on (start() / stop()).
+class FxPipeline
+{
+public:
+    enum Control : uint8_t { ReverbMix, DelayMix, DelayFeedback, Cutoff, Drive, DelayTime };
+
+    static void apply(FXChain& fx, Control c, float v)
+    {
+        switch (c)
+        {
+            case ReverbMix:     fx.setReverbMix(v);      break;
+            case DelayMix:      fx.setDelayMix(v);       break;
+            case DelayFeedback: fx.setDelayFeedback(v);  break;
+            case Cutoff:        fx.setLPCutoff(v);       break;
+            case Drive:         fx.setDrive(v);          break;
+            case DelayTime:     fx.updateDelayTime(v);   break;
+            default: break;
+        }
+    }
+
+    ~FxPipeline() { release(); }
+
+    // ── Message thread (prepareToPlay / releaseResources) ───────────────────
+    void prepare(FXChain& chain, int blockSize, double sampleRate)
+    {
+        release();
+        fx      = &chain;
+        latency = juce::jmax(1, blockSize);
+        rate    = sampleRate;
+        for (auto& s : stages)
+        {
+            s.dry.assign((size_t)latency * 3, 0.f);
+            s.numSamples  = 0;
+            s.numControls = 0;
+        }
+        wet.assign((size_t)latency * 2, 0.f);
+        reset();
+    }
+
+    void release()
+    {
+        stop();
+        active = false;
+    }
+
+    // Worker thread, only while pipeline mode is on. stop() only while the
+    // audio thread cannot be inside a pipelined block.
+    void start()
+    {
+        if (worker != nullptr || fx == nullptr)
+            return;
+
+        worker = std::make_unique<Worker>(*this);
+        const auto options = juce::Thread::RealtimeOptions{}
+                                 .withPriority(9)
+                                 .withApproximateAudioProcessingTime(latency, rate);
+        if (!worker->startRealtimeThread(options))
+            worker->startThread(juce::Thread::Priority::highest);
+    }
+
+    void stop()
+    {
+        if (worker != nullptr)
+        {
+            worker->signalThreadShouldExit();
+            worker->wake.post();
+            worker->stopThread(1000);
+            worker.reset();
+        }
+    }
+
+    int getLatencySamples() const { return latency; }
+
+    // ── Audio thread ────────────────────────────────────────────────────────
+    bool isActive() const { return active; }
+
+    // Switch on/off between blocks; the FIFO restarts from silence
+    void setActive(bool on)
+    {
+        if (on == active) return;
+        if (active) flush();
+        else        reset();
+        active = on && worker != nullptr;
+    }
+
+    // Can this block go through the pipeline?
+    bool fits(int numSamples) const { return active && numSamples <= latency; }
+
+    // Hand the previous block's dry mix to the worker; returns the buffers the
+    // current block renders into: direct, then the delay and reverb sends at
+    // +latency and +2 × latency (each at least `latency` samples, zeroed)
+    float* beginBlock()
+    {
+        auto& done = stages[(size_t)(current ^ 1)];
+        if (done.numSamples > 0 || done.numControls > 0)
+        {
+            job = current ^ 1;
+            state.store(Queued, std::memory_order_seq_cst);
+            if (worker != nullptr && worker->asleep.exchange(false, std::memory_order_seq_cst))
+                worker->wake.post();   // lock-free, once per sleep
+        }
+
+        auto& cur = stages[(size_t)current];
+        std::fill(cur.dry.begin(), cur.dry.end(), 0.f);
+        cur.numSamples  = 0;
+        cur.numControls = 0;
+        return cur.dry.data();
+    }
+
+    // Queue an FX change for `offset` within the block being rendered
+    void control(Control c, float v, int offset)
+    {
+        auto& cur = stages[(size_t)current];
+        if (cur.numControls == kMaxControls)
+            coalesce(cur);
+        cur.controls[(size_t)cur.numControls++] = { offset, c, v };
+    }
+
+    // Controls or samples still to go through the chain (flush() applies them)
+    bool hasPending() const
+    {
+        for (const auto& s : stages)
+            if (s.numSamples > 0 || s.numControls > 0)
+                return true;
+        return false;
+    }
+
+    // Wait for the worker, then output the wet samples that are now due
+    void endBlock(int numSamples, float* outL, float* outR)
+    {
+        join();
+        stages[(size_t)current].numSamples = numSamples;
+        current ^= 1;
+
+        const int cap = (int)wet.size();
+        for (int i = 0; i < numSamples; ++i)
+        {
+            outL[i] = outR[i] = wet[(size_t)wetRead];
+            wetRead = (wetRead + 1) % cap;
+        }
+    }
+
+    // Stop the pipeline between blocks (transport stop, oversized block):
+    // queued controls go straight to the chain and the FIFO restarts
+    void flush()
+    {
+        join();
+        for (int older : { current ^ 1, current })
+        {
+            auto& s = stages[(size_t)older];
+            for (int k = 0; k < s.numControls; ++k)
+                apply(*fx, s.controls[(size_t)k].control, s.controls[(size_t)k].value);
+            s.numControls = 0;
+        }
+        reset();
+    }
+
+private:
+    static constexpr int kMaxControls = 64;
+    static constexpr int kSpinMicros  = 300;
+
+    enum JobState : int { Idle, Queued, Running };
+
+    struct QueuedControl
+    {
+        int     offset;
+        Control control;
+        float   value;
+    };
+
+    struct Stage
+    {
+        std::vector<float>                          dry;
+        int                                         numSamples  = 0;
+        std::array<QueuedControl, kMaxControls>     controls {};
+        int                                         numControls = 0;
+    };
+
+    struct Worker : juce::Thread
+    {
+        explicit Worker(FxPipeline& p) : juce::Thread("OBSTACLE fx"), pipe(p) {}
+
+        void run() override
+        {
+            using Clock = std::chrono::steady_clock;
+            auto idleSince = Clock::now();
+
+            while (!threadShouldExit())
+            {
+                if (pipe.claim())
+                {
+                    pipe.runJob();
+                    idleSince = Clock::now();
+                }
+                else if (Clock::now() - idleSince < std::chrono::microseconds(kSpinMicros))
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    // The flag is set before re-checking, so a stage queued in
+                    // between always posts
+                    asleep.store(true, std::memory_order_seq_cst);
+                    if (pipe.state.load(std::memory_order_seq_cst) != Queued)
+                        wake.wait(100);
+                    asleep.store(false, std::memory_order_relaxed);
+                    idleSince = Clock::now();
+                }
+            }
+        }
+
+        FxPipeline&       pipe;
+        std::atomic<bool> asleep { false };
+        WakeSignal        wake;
+    };
+
+    // Take the queued stage; only one of the worker and the audio thread wins
+    bool claim()
+    {
+        int expected = Queued;
+        return state.load(std::memory_order_relaxed) == Queued
+            && state.compare_exchange_strong(expected, Running, std::memory_order_acq_rel);
+    }
+
+    void runJob()
+    {
+        process(stages[(size_t)job]);
+        state.store(Idle, std::memory_order_release);
+    }
+
+    // FX over one stage's dry samples, controls at their offsets (whoever claimed it)
+    void process(Stage& s)
+    {
+        const int cap = (int)wet.size();
+        int k = 0;
+        for (int i = 0; i < s.numSamples; ++i)
+        {
+            while (k < s.numControls && s.controls[(size_t)k].offset <= i)
+            {
+                apply(*fx, s.controls[(size_t)k].control, s.controls[(size_t)k].value);
+                ++k;
+            }
+            wet[(size_t)wetWrite] = fx->process(s.dry[(size_t)i],
+                                                s.dry[(size_t)(latency + i)],
+                                                s.dry[(size_t)(2 * latency + i)]);
+            wetWrite = (wetWrite + 1) % cap;
+        }
+        for (; k < s.numControls; ++k)
+            apply(*fx, s.controls[(size_t)k].control, s.controls[(size_t)k].value);
+
+        s.numSamples  = 0;
+        s.numControls = 0;
+    }
+
+    // Full queue: only the newest change of each control is kept, in order
+    static void coalesce(Stage& s)
+    {
+        uint32_t seen = 0;
+        int kept = 0;
+        for (int k = s.numControls - 1; k >= 0; --k)   // newest first, packed at the back
+        {
+            const uint32_t bit = 1u << s.controls[(size_t)k].control;
+            if ((seen & bit) != 0)
+                continue;
+            seen |= bit;
+            s.controls[(size_t)(s.numControls - 1 - kept++)] = s.controls[(size_t)k];
+        }
+        std::copy(s.controls.begin() + (s.numControls - kept), s.controls.begin() + s.numControls,
+                  s.controls.begin());
+        s.numControls = kept;
+    }
+
+    // Audio thread: a stage the worker has not started yet is run here
+    void join()
+    {
+        if (claim())
+        {
+            runJob();
+            return;
+        }
+        while (state.load(std::memory_order_acquire) != Idle)
+            std::this_thread::yield();
+    }
+
+    // FIFO back to `latency` samples of silence (worker idle)
+    void reset()
+    {
+        std::fill(wet.begin(), wet.end(), 0.f);
+        wetRead  = 0;
+        wetWrite = latency % juce::jmax(1, (int)wet.size());
+        for (auto& s : stages)
+            s.numSamples = 0;
+    }
+
+    FXChain* fx = nullptr;
+    int    latency = 512;
+    double rate    = 44100.0;
+    bool   active  = false;
+
+    std::array<Stage, 2> stages;
+    int current = 0;                  // stage the audio thread renders into
+    int job     = 1;                  // stage handed to the worker
+
+    std::vector<float> wet;           // 2 × latency ring
+    int wetRead = 0, wetWrite = 0;
+
+    std::unique_ptr<Worker> worker;
+    alignas(64) std::atomic<int> state { Idle };
+
+    JUCE_DECLARE_NON_COPYABLE(FxPipeline)
+};
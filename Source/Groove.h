@@ -0,0 +1,34 @@
+#pragma once
+#include <array>
+#include <iterator>
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Groove templates — a delay for each 16th of the bar, in steps
+//  A track plays through one of them (Pattern::trackGroove): its step s is
+//  late by offset[s % kGrooveLength], on top of swing and the step's own
+//  nudge. Delays only, like swing: the sequencer never looks ahead of the
+//  step it is on. Index 0 is straight; stored indices never change meaning.
+//  MPC-style percentages put the second 16th of each pair at that share of
+//  the 8th: 58 % = (0.58 - 0.5) * 2 = 0.16 of a step late.
+// ─────────────────────────────────────────────────────────────────────────────
+static constexpr int kGrooveLength = 16;
+
+struct GrooveTemplate
+{
+    const char*                       name;
+    std::array<float, kGrooveLength>  offset;
+};
+
+static const GrooveTemplate kGrooves[] = {
+    { "Straight",   {} },
+    { "MPC 54%",    { 0, .08f, 0, .08f, 0, .08f, 0, .08f, 0, .08f, 0, .08f, 0, .08f, 0, .08f } },
+    { "MPC 58%",    { 0, .16f, 0, .16f, 0, .16f, 0, .16f, 0, .16f, 0, .16f, 0, .16f, 0, .16f } },
+    { "MPC 62%",    { 0, .24f, 0, .24f, 0, .24f, 0, .24f, 0, .24f, 0, .24f, 0, .24f, 0, .24f } },
+    { "Triplet 16", { 0, .333f, 0, .333f, 0, .333f, 0, .333f, 0, .333f, 0, .333f, 0, .333f, 0, .333f } },
+    { "Triplet 8",  { 0, 0, .667f, 0, 0, 0, .667f, 0, 0, 0, .667f, 0, 0, 0, .667f, 0 } },
+    { "Laid back",  { 0, .04f, .02f, .06f, .12f, .04f, .02f, .06f, 0, .04f, .02f, .06f, .12f, .04f, .02f, .06f } },
+    { "Shuffle",    { 0, .12f, .04f, .2f, 0, .12f, .04f, .2f, 0, .12f, .04f, .2f, 0, .12f, .04f, .2f } },
+    { "Drunk",      { 0, .22f, .06f, .3f, .02f, .18f, .1f, .26f, 0, .24f, .04f, .28f, .08f, .2f, .12f, .3f } },
+};
+
+static constexpr int kNumGrooves = (int)std::size (kGrooves);
@@ -0,0 +1,74 @@
+#include "LockFree.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <time.h>
+#endif
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  WakeSignal
+// ─────────────────────────────────────────────────────────────────────────────
+WakeSignal::WakeSignal()
+{
+   #if JUCE_WINDOWS
+    handle = CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr);
+   #elif JUCE_MAC || JUCE_IOS
+    handle = (void*) dispatch_semaphore_create (0);
+   #else
+    auto* sem = new sem_t;
+    sem_init (sem, 0, 0);
+    handle = sem;
+   #endif
+}
+
+WakeSignal::~WakeSignal()
+{
+   #if JUCE_WINDOWS
+    CloseHandle ((HANDLE) handle);
+   #elif JUCE_MAC || JUCE_IOS
+    dispatch_release ((dispatch_semaphore_t) handle);
+   #else
+    sem_destroy ((sem_t*) handle);
+    delete (sem_t*) handle;
+   #endif
+}
+
+// One atomic increment; the kernel is entered only when a thread is waiting
+void WakeSignal::post()
+{
+   #if JUCE_WINDOWS
+    ReleaseSemaphore ((HANDLE) handle, 1, nullptr);
+   #elif JUCE_MAC || JUCE_IOS
+    dispatch_semaphore_signal ((dispatch_semaphore_t) handle);
+   #else
+    sem_post ((sem_t*) handle);
+   #endif
+}
+
+void WakeSignal::wait (int timeoutMs)
+{
+   #if JUCE_WINDOWS
+    WaitForSingleObject ((HANDLE) handle, (DWORD) timeoutMs);
+   #elif JUCE_MAC || JUCE_IOS
+    dispatch_semaphore_wait ((dispatch_semaphore_t) handle,
+                             dispatch_time (DISPATCH_TIME_NOW, (int64_t) timeoutMs * 1000000));
+   #else
+    timespec deadline;
+    clock_gettime (CLOCK_REALTIME, &deadline);
+    deadline.tv_sec  += timeoutMs / 1000;
+    deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    sem_timedwait ((sem_t*) handle, &deadline);   // EINTR or timeout: the caller loops
+   #endif
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — lock-free building blocks shared by the audio and UI threads
+// ─────────────────────────────────────────────────────────────────────────────
+
+// ── Bounded multi-producer / single-consumer queue ───────────────────────────
+//  Producers: message thread, host automation thread, audio thread.
+//  Consumer:  audio thread only. push() never blocks and never allocates;
+//  it returns false when the ring is full so the caller can fall back.
+template <typename T, int Capacity>
+class MpscQueue
+{
+    static_assert ((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue()
+    {
+        for (uint32_t i = 0; i < (uint32_t)Capacity; ++i)
+            cells[i].seq.store (i, std::memory_order_relaxed);
+    }
+
+    bool push (const T& item)
+    {
+        uint32_t pos = tail.load (std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[pos & kMask];
+            const uint32_t seq = cell.seq.load (std::memory_order_acquire);
+            const int32_t  dif = (int32_t)(seq - pos);
+
+            if (dif == 0)
+            {
+                if (tail.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.data = item;
+                    cell.seq.store (pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (dif < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = tail.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop (T& out)
+    {
+        const uint32_t pos = head.load (std::memory_order_relaxed);
+        auto& cell = cells[pos & kMask];
+        const uint32_t seq = cell.seq.load (std::memory_order_acquire);
+        if ((int32_t)(seq - (pos + 1)) < 0)
+            return false; // empty (or a producer is mid-write)
+
+        out = cell.data;
+        cell.seq.store (pos + (uint32_t)Capacity, std::memory_order_release);
+        head.store (pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static constexpr uint32_t kMask = (uint32_t)Capacity - 1;
+
+    struct Cell
+    {
+        std::atomic<uint32_t> seq { 0 };
+        T data {};
+    };
+
+    std::array<Cell, Capacity> cells;
+    alignas (64) std::atomic<uint32_t> head { 0 };
+    alignas (64) std::atomic<uint32_t> tail { 0 };
+};
+
+// ── Audio epoch ──────────────────────────────────────────────────────────────
+//  Brackets each processBlock so the message thread knows when an object it
+//  unpublished can no longer be referenced by the audio thread. Readers may
+//  only hold published pointers inside one block.
+class AudioEpoch
+{
+public:
+    struct Scope
+    {
+        explicit Scope (AudioEpoch& e) : epoch (e) { epoch.active.store (true); }
+        ~Scope() { epoch.counter.fetch_add (1); epoch.active.store (false); }
+        AudioEpoch& epoch;
+    };
+
+    uint64_t now() const { return counter.load(); }
+
+    // True once no block that started before `stamp` can still be running
+    bool hasPassed (uint64_t stamp) const
+    {
+        return !active.load() || counter.load() != stamp;
+    }
+
+private:
+    std::atomic<uint64_t> counter { 0 };
+    std::atomic<bool>     active  { false };
+};
+
+// ── Wake-up for a sleeping realtime worker ───────────────────────────────────
+//  post() takes no lock and never blocks, so the audio thread may call it: a
+//  counting OS semaphore (futex-backed sem_t on Linux, dispatch semaphore on
+//  macOS, kernel semaphore on Windows). A post nobody waits for is kept, and
+//  the next wait() returns at once.
+class WakeSignal
+{
+public:
+    WakeSignal();
+    ~WakeSignal();
+
+    void post();
+    void wait (int timeoutMs);   // worker thread
+
+private:
+    void* handle = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE (WakeSignal)
+};
+
+// ── Deferred deletion (message thread) ───────────────────────────────────────
+//  Objects replaced via an atomic pointer are parked here and freed once the
+//  audio thread has finished every block that might have seen them. Ptr may
+//  be a shared_ptr when several atomic pointers publish the same object.
+template <typename T, typename Ptr = std::unique_ptr<T>>
+class RetireList
+{
+public:
+    void retire (Ptr obj, const AudioEpoch& epoch)
+    {
+        if (obj != nullptr)
+            items.push_back ({ epoch.now(), std::move (obj) });
+    }
+
+    void collect (const AudioEpoch& epoch)
+    {
+        items.erase (std::remove_if (items.begin(), items.end(),
+                                     [&] (const Item& it) { return epoch.hasPassed (it.stamp); }),
+                     items.end());
+    }
+
+private:
+    struct Item
+    {
+        uint64_t stamp;
+        Ptr      obj;
+    };
+    std::vector<Item> items;
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <JuceHeader.h>
+#include "LockFree.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Dense parameter IDs — shared by the host, the audio thread and the UI bridge
+// ─────────────────────────────────────────────────────────────────────────────
+enum ParamID
+{
+    PID_BPM = 0,
+    PID_MASTER_VOL,
+    PID_FX_REVERB,
+    PID_FX_DELAY_MIX,
+    PID_FX_DELAY_FEED,
+    PID_FX_CUTOFF,
+    PID_FX_SWING,
+    PID_FX_DRIVE,
+    PID_KEY,
+    PID_TRACK_BASE          // per-track block starts here
+};
+
+// Per-track parameter block: id = PID_TRACK_BASE + track * NUM_TRACK_PARAMS + field
+enum TrackParam { TP_VOL = 0, TP_MUTE, TP_DEC, TP_DLY_SEND, TP_REV_SEND, NUM_TRACK_PARAMS };
+
+inline constexpr int trackParamID (int track, int field)
+{
+    return PID_TRACK_BASE + track * NUM_TRACK_PARAMS + field;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  ParamRegistry
+//  Maps dense IDs ↔ AudioParameters and turns every value change (host
+//  automation, UI, state restore) into a timestamped event for the audio
+//  thread. processBlock drains the events once per block and splits the
+//  block at their sample offsets, so only changed parameters are applied.
+// ─────────────────────────────────────────────────────────────────────────────
+class ParamRegistry  : private juce::AudioProcessorParameter::Listener
+{
+public:
+    struct Event
+    {
+        int   sampleOffset = 0;
+        int   id           = 0;
+        float value        = 0.f;   // plain (denormalised) value
+    };
+
+    static constexpr int kMaxParams = 256;
+
+    ParamRegistry() { indexToId.fill (-1); }
+
+    ~ParamRegistry() override
+    {
+        for (int id = 0; id < numParams; ++id)
+            if (params[id] != nullptr)
+                params[id]->removeListener (this);
+    }
+
+    // Register a parameter after AudioProcessor::addParameter (its index must be valid).
+    // uiName/uiScale describe how the WebView bridge addresses it: plain = ui * uiScale.
+    void add (int id, juce::RangedAudioParameter* p, const char* uiName = nullptr, float uiScale = 1.f)
+    {
+        jassert (id >= 0 && id < kMaxParams && p != nullptr);
+        params[id]  = p;
+        uiScales[id] = uiScale;
+        numParams   = juce::jmax (numParams, id + 1);
+
+        const int index = p->getParameterIndex();
+        if (juce::isPositiveAndBelow (index, kMaxParams))
+            indexToId[index] = id;
+
+        if (uiName != nullptr)
+            uiNames.set (uiName, id);
+
+        p->addListener (this);
+    }
+
+    juce::RangedAudioParameter* get (int id) const
+    {
+        return juce::isPositiveAndBelow (id, numParams) ? params[id] : nullptr;
+    }
+
+    int size() const { return numParams; }
+
+    // ── UI bridge ─────────────────────────────────────────────────────────────
+    int idForUiName (const juce::String& name) const
+    {
+        return uiNames.contains (name) ? uiNames[name] : -1;
+    }
+
+    void setFromUi (int id, float uiValue)
+    {
+        if (auto* p = get (id))
+            p->setValueNotifyingHost (p->convertTo0to1 (uiValue * uiScales[id]));
+    }
+
+    // ── Event producers ───────────────────────────────────────────────────────
+    // Any thread. Events that do not fit trigger a full resync on the next block.
+    void push (int id, float value, int sampleOffset = 0)
+    {
+        if (!queue.push ({ sampleOffset, id, value }))
+            resyncAll.store (true, std::memory_order_release);
+    }
+
+    // Re-emit every parameter on the next collect() (prepareToPlay, overflow)
+    void markAllDirty() { resyncAll.store (true, std::memory_order_release); }
+
+    // ── Audio thread ──────────────────────────────────────────────────────────
+    // Drains pending events into dst (sorted by offset, clamped to the block).
+    int collect (Event* dst, int maxEvents, int numSamples)
+    {
+        int n = 0;
+
+        if (resyncAll.exchange (false, std::memory_order_acq_rel))
+        {
+            Event e;
+            while (queue.pop (e)) {}   // superseded by the full snapshot below
+
+            for (int id = 0; id < numParams && n < maxEvents; ++id)
+                if (params[id] != nullptr)
+                    dst[n++] = { 0, id, params[id]->convertFrom0to1 (params[id]->getValue()) };
+            return n;
+        }
+
+        Event e;
+        while (n < maxEvents && queue.pop (e))
+        {
+            e.sampleOffset = juce::jlimit (0, juce::jmax (0, numSamples - 1), e.sampleOffset);
+
+            // insertion sort — blocks rarely carry more than a handful of events
+            int i = n++;
+            while (i > 0 && dst[i - 1].sampleOffset > e.sampleOffset)
+            {
+                dst[i] = dst[i - 1];
+                --i;
+            }
+            dst[i] = e;
+        }
+
+        if (n == maxEvents && queue.pop (e))
+            resyncAll.store (true, std::memory_order_release);  // catch up next block
+
+        return n;
+    }
+
+private:
+    void parameterValueChanged (int parameterIndex, float newValue) override
+    {
+        if (!juce::isPositiveAndBelow (parameterIndex, kMaxParams)) return;
+        const int id = indexToId[parameterIndex];
+        if (id < 0) return;
+        push (id, params[id]->convertFrom0to1 (newValue));
+    }
+
+    void parameterGestureChanged (int, bool) override {}
+
+    std::array<juce::RangedAudioParameter*, kMaxParams> params {};
+    std::array<float, kMaxParams>                       uiScales {};
+    std::array<int,   kMaxParams>                       indexToId {};
+    int                                                 numParams = 0;
+
+    juce::HashMap<juce::String, int> uiNames;
+
+    MpscQueue<Event, 1024> queue;
+    std::atomic<bool>      resyncAll { true };
+};
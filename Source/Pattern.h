@@ -0,0 +1,289 @@
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Voice types and track layout
+//  Every track plays one voice type; several tracks may share a type.
+// ─────────────────────────────────────────────────────────────────────────────
+//  SAMPLE plays an audio file chosen per track (SamplePool.h).
+enum VoiceType { KICK = 0, SNARE, HIHAT, BASS, LEAD, PAD, SAMPLE, NUM_VOICE_TYPES };
+
+static constexpr int MAX_TRACKS         = 32;
+static constexpr int DEFAULT_NUM_TRACKS = PAD + 1;  // one track per synth voice type
+
+static const char* kVoiceTypeNames[NUM_VOICE_TYPES] = { "Kick", "Snare", "Hihat", "Bass", "Lead", "Pad", "Sample" };
+
+inline bool isMelodicVoice(int type) { return type >= BASS && type <= PAD; }
+
+// General MIDI drum notes the unpitched voices send and answer to (SAMPLE: clap)
+static constexpr std::array<int, NUM_VOICE_TYPES> kDrumMidiNotes = { 36, 38, 42, 0, 0, 0, 39 };
+
+// MIDI input per track: the note it plays on (-1 = any, melodic voices at
+// its pitch) and the channel it listens to (1-16, 0 = any). By default the
+// drum voices take their GM note on any channel, so one drum controller or
+// clip plays them all; melodic voices take every note on the channel their
+// track sends on.
+struct TrackLayout {
+    int numTracks = DEFAULT_NUM_TRACKS;
+    std::array<uint8_t, MAX_TRACKS> voice {};   // VoiceType per track
+    std::array<int8_t, MAX_TRACKS>  midiInNote {};
+    std::array<uint8_t, MAX_TRACKS> midiInChannel {};
+
+    TrackLayout() {
+        for (int t = 0; t < MAX_TRACKS; ++t) {
+            voice[t] = (uint8_t)(t % DEFAULT_NUM_TRACKS);
+            resetMidiIn(t);
+        }
+    }
+
+    // The defaults for the track's voice type
+    void resetMidiIn(int t) {
+        const bool melodic = isMelodicVoice(voice[t]);
+        midiInNote[t]    = (int8_t)(melodic ? -1 : kDrumMidiNotes[voice[t]]);
+        midiInChannel[t] = (uint8_t)(melodic ? t % 16 + 1 : 0);
+    }
+};
+
+// A-natural minor scale, per voice type — MIDI base notes
+// stepNotes[track][step] = 0..6 → index into these arrays
+static constexpr std::array<int, 7> kBassBaseMidi = { 33, 35, 36, 38, 40, 41, 43 }; // A1 to G2
+static constexpr std::array<int, 7> kLeadBaseMidi = { 57, 59, 60, 62, 64, 65, 67 }; // A3 to G4
+static constexpr std::array<int, 7> kPadBaseMidi  = { 45, 47, 48, 50, 52, 53, 55 }; // A2 to G3
+
+static const char* kNoteNames[] = { "A", "B", "C", "D", "E", "F", "G" };
+
+inline float midiToFreq(int midi) {
+    return 440.f * std::pow(2.f, (midi - 69) / 12.f);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Song Mode structures
+// ─────────────────────────────────────────────────────────────────────────────
+//  Patterns come in banks of eight (A-H); pattern p is bank p / 8, letter
+//  p % 8. The first bank and the first 16 slots are what pre-bank states hold.
+static constexpr int PATTERNS_PER_BANK = 8;
+static constexpr int NUM_BANKS         = 16;
+static constexpr int NUM_PATTERNS      = PATTERNS_PER_BANK * NUM_BANKS;  // 128
+static constexpr int NUM_SONG_SLOTS    = 4096;
+static constexpr int MAX_REPEATS       = 64;
+
+static constexpr int LEGACY_NUM_PATTERNS   = 8;
+static constexpr int LEGACY_NUM_SONG_SLOTS = 16;
+static constexpr int LEGACY_MAX_REPEATS    = 8;
+
+static constexpr int MAX_STEPS     = 64;  // per track — one bit each in a uint64_t
+static constexpr int DEFAULT_STEPS = 16;
+
+inline constexpr uint64_t stepMaskForLength(int len)
+{
+    return len >= 64 ? ~uint64_t(0) : ((uint64_t(1) << len) - 1);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Parameter locks — a step's own value for a track parameter (or a global
+//  FX one), held from that step's trigger until the track triggers again.
+//  Timing locks (nudge, ratchet) change when the step plays instead; they
+//  are compiled into its trigger events and never held.
+// ─────────────────────────────────────────────────────────────────────────────
+enum LockParam : uint8_t { LOCK_NONE = 0, LOCK_VOL, LOCK_TONE, LOCK_DLY_SEND, LOCK_REV_SEND,
+                           LOCK_CUTOFF, LOCK_DRIVE, NUM_SOUND_LOCKS,
+                           LOCK_NUDGE = NUM_SOUND_LOCKS,   // delay: value / 256 of a step
+                           LOCK_RATCHET,                   // hits per step: value 1..MAX_RATCHETS
+                           NUM_LOCK_PARAMS };
+
+static const char* kLockParamNames[NUM_LOCK_PARAMS] = { "", "vol", "tone", "dly", "rev", "cutoff", "drive",
+                                                        "nudge", "ratchet" };
+
+static constexpr int MAX_PARAM_LOCKS = 128;   // per pattern, over all tracks and steps
+static constexpr int MAX_RATCHETS    = 8;
+
+struct ParamLock {
+    uint8_t track = 0;
+    uint8_t step  = 0;
+    uint8_t param = LOCK_NONE;   // LOCK_NONE = unused entry
+    uint8_t value = 0;           // 0-255 over the parameter's range
+
+    static int keyOf(int t, int s, int param) { return (t * MAX_STEPS + s) * NUM_LOCK_PARAMS + param; }
+    int key() const { return keyOf(track, step, param); }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Pattern — bit-packed, per-track length (polymeter)
+//  stepBits[t] bit s = step s is on. Bits past trackLength[t] are kept (so
+//  shortening and re-lengthening a track is lossless) but never played.
+//  Notes are scale degrees 0..6. The pattern's own length — what the song
+//  chain counts — is its longest active track. Storage is sized for
+//  MAX_TRACKS; the layout decides how many tracks are in use.
+//  Parameter locks are a sparse list sorted by (track, step, param) and
+//  packed at the front of `locks`; lockSteps[t] bit s = step s has any.
+//  trackGroove[t] is the groove template track t plays through (Groove.h).
+// ─────────────────────────────────────────────────────────────────────────────
+struct Pattern {
+    std::array<uint64_t, MAX_TRACKS>                       stepBits {};
+    std::array<std::array<uint8_t, MAX_STEPS>, MAX_TRACKS> stepNotes {};
+    std::array<uint8_t, MAX_TRACKS>                        trackLength {};
+    std::array<uint64_t, MAX_TRACKS>                       lockSteps {};
+    std::array<ParamLock, MAX_PARAM_LOCKS>                 locks {};
+    std::array<uint8_t, MAX_TRACKS>                        trackGroove {};
+
+    Pattern() { trackLength.fill(DEFAULT_STEPS); }
+
+    bool step(int t, int s) const { return ((stepBits[t] >> s) & 1u) != 0; }
+
+    void setStep(int t, int s, bool on)
+    {
+        const uint64_t bit = uint64_t(1) << s;
+        stepBits[t] = on ? (stepBits[t] | bit) : (stepBits[t] & ~bit);
+    }
+
+    void toggleStep(int t, int s) { stepBits[t] ^= uint64_t(1) << s; }
+
+    int  note(int t, int s) const     { return stepNotes[t][s]; }
+    void setNote(int t, int s, int d) { stepNotes[t][s] = (uint8_t)juce::jlimit(0, 6, d); }
+
+    // Steps that actually play on track t
+    uint64_t activeSteps(int t) const { return stepBits[t] & stepMaskForLength(trackLength[t]); }
+
+    void setTrackLength(int t, int len) { trackLength[t] = (uint8_t)juce::jlimit(1, MAX_STEPS, len); }
+
+    int length(int numTracks) const
+    {
+        int len = 1;
+        for (int t = 0; t < numTracks; ++t) len = juce::jmax(len, (int)trackLength[t]);
+        return len;
+    }
+
+    // ── Parameter locks ──────────────────────────────────────────────────────
+    int numLocks() const
+    {
+        int n = 0;
+        while (n < MAX_PARAM_LOCKS && locks[n].param != LOCK_NONE) ++n;
+        return n;
+    }
+
+    // Value (0-255) of the lock, or -1 if the step does not lock the parameter
+    int lock(int t, int s, int param) const
+    {
+        if (((lockSteps[t] >> s) & 1u) == 0) return -1;
+        const int i = findLock(t, s, param);
+        return i >= 0 ? locks[i].value : -1;
+    }
+
+    // Locks of track t step s are locks[first, first + count)
+    int stepLocks(int t, int s, int& count) const
+    {
+        const int first = lockIndex(ParamLock::keyOf(t, s, LOCK_NONE));
+        count = 0;
+        while (first + count < MAX_PARAM_LOCKS && locks[first + count].param != LOCK_NONE
+               && locks[first + count].track == t && locks[first + count].step == s)
+            ++count;
+        return first;
+    }
+
+    // False if the pattern already holds MAX_PARAM_LOCKS other locks
+    bool setLock(int t, int s, int param, int value)
+    {
+        const ParamLock l { (uint8_t)t, (uint8_t)s, (uint8_t)param, (uint8_t)juce::jlimit(0, 255, value) };
+        if (const int i = findLock(t, s, param); i >= 0) {
+            locks[i] = l;
+            return true;
+        }
+
+        const int n = numLocks();
+        if (n == MAX_PARAM_LOCKS) return false;
+        const int i = lockIndex(l.key());
+        std::memmove(&locks[i + 1], &locks[i], (size_t)(n - i) * sizeof(ParamLock));
+        locks[i] = l;
+        lockSteps[t] |= uint64_t(1) << s;
+        return true;
+    }
+
+    void clearLock(int t, int s, int param)
+    {
+        if (const int i = findLock(t, s, param); i >= 0)
+            removeLocks(i, 1);
+    }
+
+    void clearLocks(int t, int s)
+    {
+        int count = 0;
+        const int first = stepLocks(t, s, count);
+        removeLocks(first, count);
+    }
+
+    void clearTrackLocks(int t)
+    {
+        for (uint64_t bits = lockSteps[t]; bits != 0; bits &= bits - 1)
+            clearLocks(t, juce::countNumberOfBits((bits & (~bits + 1)) - 1));
+    }
+
+    void clear()
+    {
+        stepBits.fill(0);
+        for (auto& r : stepNotes) r.fill(0);
+        lockSteps.fill(0);
+        locks.fill(ParamLock());
+    }
+
+    // Byte-wise: every member is a plain integer array with no padding
+    bool operator==(const Pattern& o) const { return std::memcmp(this, &o, sizeof(Pattern)) == 0; }
+    bool operator!=(const Pattern& o) const { return !(*this == o); }
+
+    uint64_t hash() const
+    {
+        uint64_t h = 14695981039346656037ull;                 // FNV-1a over 64-bit words
+        const auto* w = reinterpret_cast<const uint64_t*>(this);
+        for (size_t i = 0; i < sizeof(Pattern) / sizeof(uint64_t); ++i)
+            h = (h ^ w[i]) * 1099511628211ull;
+        return h;
+    }
+
+private:
+    int findLock(int t, int s, int param) const
+    {
+        const int key = ParamLock::keyOf(t, s, param);
+        const int i   = lockIndex(key);
+        return i < MAX_PARAM_LOCKS && locks[i].param != LOCK_NONE && locks[i].key() == key ? i : -1;
+    }
+
+    // First entry whose key is not below `key` (the used entries are sorted)
+    int lockIndex(int key) const
+    {
+        int lo = 0, hi = numLocks();
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            if (locks[mid].key() < key) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    void removeLocks(int first, int count)
+    {
+        if (count <= 0) return;
+        const int t = locks[first].track, s = locks[first].step;
+        const int n = numLocks();
+        std::memmove(&locks[first], &locks[first + count], (size_t)(n - first - count) * sizeof(ParamLock));
+        std::fill(locks.begin() + (n - count), locks.begin() + n, ParamLock());
+
+        int left = 0;
+        stepLocks(t, s, left);
+        if (left == 0) lockSteps[t] &= ~(uint64_t(1) << s);
+    }
+};
+static_assert(std::has_unique_object_representations_v<Pattern>, "Pattern must compare byte-wise");
+static_assert(sizeof(Pattern) % sizeof(uint64_t) == 0, "Pattern::hash reads whole words");
+
+// Two bytes per slot, so thousands of slots cost a few kilobytes
+struct SongSlot {
+    uint8_t patternIndex = 0;  // 0-127 (bank * 8 + A-H)
+    uint8_t repeatCount  = 1;  // 1-64 loops before advancing
+
+    bool operator==(const SongSlot& o) const { return patternIndex == o.patternIndex && repeatCount == o.repeatCount; }
+    bool operator!=(const SongSlot& o) const { return !(*this == o); }
+};
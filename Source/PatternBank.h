@@ -0,0 +1,116 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <memory>
+#include "Pattern.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  PatternBank — NUM_PATTERNS patterns with copy-on-write storage
+//
+//  Each index holds a shared pointer to its pattern. Every unedited index
+//  points at one shared empty pattern, and indices with identical content
+//  can share one copy (intern / dedupe). edit() clones the storage only when
+//  it is shared, so memory grows with distinct content rather than with
+//  NUM_PATTERNS. Shared storage is never written, so a state snapshot can
+//  hold on to it (share()) while editing carries on. Message thread only: the
+//  audio thread never reads patterns, it plays their compiled form.
+// ─────────────────────────────────────────────────────────────────────────────
+class PatternBank
+{
+public:
+    PatternBank()
+    {
+        empty = std::make_shared<Pattern>();
+        slots.fill (empty);
+    }
+
+    const Pattern& operator[] (int i) const { return *slots[(size_t)i]; }
+
+    // Storage identity: equal pointers mean equal content
+    const Pattern* storage (int i) const { return slots[(size_t)i].get(); }
+
+    // Writable pattern i, unshared first if needed
+    Pattern& edit (int i)
+    {
+        auto& s = slots[(size_t)i];
+        if (s.use_count() > 1)
+            s = std::make_shared<Pattern> (*s);
+        return const_cast<Pattern&> (*s);   // sole owner; every Pattern here is created non-const
+    }
+
+    // dst shares src's storage until either is edited
+    void copy (int dst, int src) { slots[(size_t)dst] = slots[(size_t)src]; }
+
+    // Never edited (or edited back to empty)
+    bool isEmpty (int i) const { return slots[(size_t)i] == empty; }
+
+    // Pattern i's storage, kept alive and unchanged for as long as it is held
+    std::shared_ptr<const Pattern> share (int i) const { return slots[(size_t)i]; }
+
+    void assign (int i, std::shared_ptr<const Pattern> p) { slots[(size_t)i] = p != nullptr ? std::move (p) : empty; }
+
+    void clearAll() { slots.fill (empty); }
+
+    // Apply fn to every pattern, once per distinct storage, keeping the sharing
+    template <typename Fn>
+    void editAll (Fn&& fn)
+    {
+        const auto before = slots;
+        for (int i = 0; i < NUM_PATTERNS; ++i)
+        {
+            int first = 0;
+            while (before[(size_t)first] != before[(size_t)i]) ++first;
+            if (first < i)
+            {
+                slots[(size_t)i] = slots[(size_t)first];
+                continue;
+            }
+
+            auto edited = std::make_shared<Pattern> (*before[(size_t)i]);
+            fn (*edited);
+            if (*edited != *before[(size_t)i])
+                slots[(size_t)i] = std::move (edited);
+        }
+    }
+
+    // Share pattern i's storage with an identical pattern, if there is one
+    void intern (int i)
+    {
+        const auto& s = slots[(size_t)i];
+        if (*s == *empty) { slots[(size_t)i] = empty; return; }
+
+        for (int q = 0; q < NUM_PATTERNS; ++q)
+            if (q != i && slots[(size_t)q] != s && *slots[(size_t)q] == *s)
+            {
+                slots[(size_t)i] = slots[(size_t)q];
+                return;
+            }
+    }
+
+    // Collapse every group of identical patterns to one copy
+    void dedupe()
+    {
+        std::array<uint64_t, NUM_PATTERNS> hashes {};
+        for (int i = 0; i < NUM_PATTERNS; ++i)
+        {
+            hashes[(size_t)i] = slots[(size_t)i]->hash();
+            if (*slots[(size_t)i] == *empty)
+            {
+                slots[(size_t)i] = empty;
+                continue;
+            }
+            for (int q = 0; q < i; ++q)
+                if (hashes[(size_t)q] == hashes[(size_t)i] && *slots[(size_t)q] == *slots[(size_t)i])
+                {
+                    slots[(size_t)i] = slots[(size_t)q];
+                    break;
+                }
+        }
+    }
+
+private:
+    std::shared_ptr<const Pattern>                           empty;
+    std::array<std::shared_ptr<const Pattern>, NUM_PATTERNS> slots;
+
+    JUCE_DECLARE_NON_COPYABLE (PatternBank)
+};
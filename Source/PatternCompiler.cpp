@@ -0,0 +1,79 @@
+#include "PatternCompiler.h"
+
+std::unique_ptr<CompiledPattern> compilePattern (const Pattern& pat, const TrackLayout& layout, float swing,
+                                                 const LockRanges& lockRanges)
+{
+    const int numTracks = juce::jlimit (1, MAX_TRACKS, layout.numTracks);
+
+    auto cp = std::make_unique<CompiledPattern>();
+    cp->length   = pat.length (numTracks);
+    cp->numLanes = numTracks;
+
+    int numEvents = 0;
+    for (int t = 0; t < numTracks; ++t)
+        numEvents += juce::countNumberOfBits (pat.activeSteps (t));
+    cp->events.reserve ((size_t)numEvents);
+
+    for (int t = 0; t < numTracks; ++t)
+    {
+        const int   type   = layout.voice[(size_t)t];
+        const auto& groove = kGrooves[juce::jmin ((int)pat.trackGroove[(size_t)t], kNumGrooves - 1)].offset;
+
+        auto& lane      = cp->lanes[(size_t)t];
+        lane.mask       = pat.activeSteps (t);
+        lane.length     = pat.trackLength[(size_t)t];
+        lane.firstEvent = (uint16_t)cp->events.size();
+
+        for (uint64_t bits = lane.mask; bits != 0; bits &= bits - 1)
+        {
+            const int s = juce::countNumberOfBits ((bits & (~bits + 1)) - 1);   // lowest set bit
+
+            TriggerEvent e;
+            e.track   = (uint8_t)t;
+            e.voice   = (uint8_t)type;
+            e.channel = (uint8_t)(t % 16 + 1);
+
+            // Swing: odd track steps land `swing` of a step late; the groove
+            // moves each 16th of the bar on top of that
+            e.offset  = ((s % 2 == 1) ? swing : 0.f) + groove[(size_t)(s % kGrooveLength)];
+
+            if (!isMelodicVoice (type))
+            {
+                e.note = (uint8_t)kDrumMidiNotes[(size_t)type];
+            }
+            else
+            {
+                const int deg  = juce::jlimit (0, 6, pat.note (t, s));
+                const int midi = (type == BASS) ? kBassBaseMidi[deg]
+                               : (type == LEAD) ? kLeadBaseMidi[deg]
+                                                : kPadBaseMidi[deg];
+                e.note = (uint8_t)midi;
+                e.freq = midiToFreq (midi);
+            }
+            // Locks: only steps that have any pay for them. Timing locks end
+            // up in the event's timing; sound locks in lockValues.
+            if ((pat.lockSteps[(size_t)t] >> s) & 1u)
+            {
+                int count = 0;
+                const int first = pat.stepLocks (t, s, count);
+                e.firstLock = (uint16_t)cp->lockValues.size();
+                for (int i = first; i < first + count; ++i)
+                {
+                    const auto& l = pat.locks[(size_t)i];
+                    if (l.param == LOCK_NUDGE)
+                        e.offset += (float)l.value / 256.f;
+                    else if (l.param == LOCK_RATCHET)
+                        e.ratchets = (uint8_t)juce::jlimit (1, MAX_RATCHETS, (int)l.value);
+                    else
+                    {
+                        const auto& r = lockRanges[l.param];
+                        e.lockMask |= (uint8_t)(1u << l.param);
+                        cp->lockValues.push_back (r.start + (r.end - r.start) * (float)l.value / 255.f);
+                    }
+                }
+            }
+            cp->events.push_back (e);
+        }
+    }
+    return cp;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Groove.h"
+#include "Pattern.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Pattern compiler
+//  Turns an edited Pattern grid into dense per-step trigger lists, resolved
+//  once on the message thread: voice, base pitch (no std::pow on the audio
+//  thread), MIDI channel/note, timing (swing, groove template, nudge and
+//  ratchets) and the step's parameter locks as plain values. On each tick the audio thread does one
+//  bit test per track. Key transpose stays a runtime parameter so it
+//  remains sample-accurate under automation.
+// ─────────────────────────────────────────────────────────────────────────────
+struct TriggerEvent
+{
+    float   freq     = 0.f;   // untransposed pitch in Hz, 0 = unpitched (drums)
+    float   offset   = 0.f;   // delay of the first hit after the step boundary, in steps
+    uint8_t track    = 0;
+    uint8_t voice    = 0;     // VoiceType of the track
+    uint8_t channel  = 1;     // MIDI channel 1-16 (tracks past 16 wrap)
+    uint8_t note     = 0;     // untransposed MIDI note
+    uint8_t velocity = 100;   // step velocity, scaled by track volume on trigger
+    uint8_t ratchets = 1;     // hits, spread evenly over one step from `offset`
+    uint8_t lockMask = 0;     // bit p = locks sound LockParam p; 0 = no locks
+    uint16_t firstLock = 0;   // its lock values: CompiledPattern::lockValues[firstLock...]
+};
+
+// Plain range a lock's 0-255 value spans, per LockParam (tone: normalised)
+struct LockRange
+{
+    float start = 0.f, end = 1.f;
+};
+using LockRanges = std::array<LockRange, NUM_LOCK_PARAMS>;
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  One lane per track. Events exist only for set bits, so the event of track
+//  step s is found by rank: firstEvent + popcount(mask below s).
+// ─────────────────────────────────────────────────────────────────────────────
+struct CompiledPattern
+{
+    struct Lane
+    {
+        uint64_t mask       = 0;   // playable steps (track length applied)
+        uint16_t firstEvent = 0;
+        uint8_t  length     = DEFAULT_STEPS;
+    };
+
+    int length   = DEFAULT_STEPS;   // pattern length = longest track
+    int numLanes = 0;               // tracks in the layout it was compiled for
+
+    std::array<Lane, MAX_TRACKS> lanes {};
+    std::vector<TriggerEvent>    events;   // lane-major
+    std::vector<float>           lockValues;   // plain, in LockParam order per locked event
+
+    // Event of track t at track step s, or nullptr if the step is off
+    const TriggerEvent* find (int t, int s) const
+    {
+        const auto& lane = lanes[(size_t)t];
+        const uint64_t bit = uint64_t (1) << s;
+        if ((lane.mask & bit) == 0)
+            return nullptr;
+        return &events[lane.firstEvent + (size_t)juce::countNumberOfBits (lane.mask & (bit - 1))];
+    }
+};
+
+// swing: odd-step delay as a fraction of a step
+std::unique_ptr<CompiledPattern> compilePattern (const Pattern& pat, const TrackLayout& layout, float swing,
+                                                 const LockRanges& lockRanges);
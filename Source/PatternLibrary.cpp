@@ -0,0 +1,576 @@
+#include "PatternLibrary.h"
+#include <algorithm>
+#include <cstring>
+#include "FileLock.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    uint32_t get16 (const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8); }
+    uint32_t get32 (const uint8_t* p) { return get16 (p) | (get16 (p + 2) << 16); }
+
+    // Index record fields
+    constexpr size_t kRecOffset = PatternLibrary::kMaxNameBytes;
+    constexpr size_t kRecSize   = kRecOffset + 4;
+    constexpr size_t kRecKind   = kRecSize + 4;
+    constexpr size_t kRecTracks = kRecKind + 1;
+
+    uint8_t lowerAscii (uint8_t c) { return c >= 'A' && c <= 'Z' ? (uint8_t)(c + 32) : c; }
+
+    size_t nameLength (const uint8_t* rec)
+    {
+        size_t n = 0;
+        while (n < (size_t)PatternLibrary::kMaxNameBytes && rec[n] != 0) ++n;
+        return n;
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+juce::File PatternLibrary::defaultFile()
+{
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+               .getChildFile ("OBSTACLE")
+               .getChildFile ("Library.obslib");
+}
+
+PatternLibrary::PatternLibrary (juce::File f)
+    : juce::Thread ("OBSTACLE library"), file (std::move (f))
+{
+    // Not while another instance is raising the entry count
+    std::unique_ptr<FileLock> held;
+    if (file.existsAsFile() && file.hasWriteAccess())
+        held = FileLock::lock (file, 200);
+    current = std::make_shared<const Mapping> (file);
+    held.reset();
+
+    startThread (juce::Thread::Priority::low);
+}
+
+PatternLibrary::~PatternLibrary()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (2000);
+
+    // Entries added just before closing are still written
+    for (auto& job : additions)
+    {
+        const int added = write (*job);
+        if (job->done)
+            job->done (added);
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Mapping — header and index are checked once; payloads on every load.
+//  Other processes may write to the file while it is mapped (on Windows a
+//  juce::MemoryMappedFile would refuse them): the view never covers what
+//  they append, and what it covers never changes.
+// ─────────────────────────────────────────────────────────────────────────────
+struct PatternLibrary::Mapping::View
+{
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+
+    explicit View (const juce::File& f)
+    {
+       #if JUCE_WINDOWS
+        const HANDLE h = CreateFileW (f.getFullPathName().toWideCharPointer(), GENERIC_READ,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h == INVALID_HANDLE_VALUE)
+            return;
+
+        LARGE_INTEGER bytes {};
+        if (GetFileSizeEx (h, &bytes) && bytes.QuadPart > 0 && (uint64_t)bytes.QuadPart <= SIZE_MAX)
+        {
+            if (const HANDLE m = CreateFileMappingW (h, nullptr, PAGE_READONLY, 0, 0, nullptr))
+            {
+                data = static_cast<const uint8_t*> (MapViewOfFile (m, FILE_MAP_READ, 0, 0, 0));
+                size = data != nullptr ? (size_t)bytes.QuadPart : 0;
+                CloseHandle (m);   // the view keeps the mapping
+            }
+        }
+        CloseHandle (h);
+       #else
+        const int fd = ::open (f.getFullPathName().toRawUTF8(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        struct stat st {};
+        if (::fstat (fd, &st) == 0 && st.st_size > 0)
+        {
+            void* p = ::mmap (nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                data = static_cast<const uint8_t*> (p);
+                size = (size_t)st.st_size;
+            }
+        }
+        ::close (fd);   // the mapping keeps the file
+       #endif
+    }
+
+    ~View()
+    {
+        if (data == nullptr)
+            return;
+       #if JUCE_WINDOWS
+        UnmapViewOfFile (data);
+       #else
+        ::munmap (const_cast<uint8_t*> (data), size);
+       #endif
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (View)
+};
+
+PatternLibrary::Mapping::Mapping (const juce::File& f)
+{
+    if (!f.existsAsFile() || f.getSize() == 0)
+    {
+        valid = true;   // no library yet
+        return;
+    }
+
+    view = std::make_unique<View> (f);
+    parse (view->data, view->size);
+}
+
+PatternLibrary::Mapping::~Mapping() = default;
+
+void PatternLibrary::Mapping::parse (const uint8_t* data, size_t dataSize)
+{
+    bytes = data;
+    size  = dataSize;
+    const int version = bytes != nullptr && size >= kHeaderBytes ? (int)get16 (bytes + 4) : 0;
+    if (bytes == nullptr || size < kHeaderBytes || get32 (bytes) != kMagic
+        || version < 1 || version > kVersion || get16 (bytes + 6) != kRecordBytes)
+        return;
+
+    const uint32_t n   = get32 (bytes + 8);
+    const uint32_t off = get32 (bytes + 12);
+    if (off < kHeaderBytes || off > size || (size - off) / kRecordBytes < n)
+        return;
+
+    numEntries  = n;
+    indexOffset = off;
+    records     = bytes + off;
+    valid       = true;
+
+    // Fingerprints: optional, 8-byte aligned so they are scanned in place
+    const uint32_t printsAt   = get32 (bytes + 16);
+    const size_t   printBytes = (size_t)SimilarityIndex::kWords * sizeof (uint64_t);
+    if (printsAt != 0 && printsAt % 8 == 0 && get16 (bytes + 20) == (uint32_t)SimilarityIndex::kWords
+        && printsAt >= off + (size_t)n * kRecordBytes && printsAt <= size && (size - printsAt) / printBytes >= n)
+    {
+        prints       = reinterpret_cast<const uint64_t*> (bytes + printsAt);
+        printsOffset = printsAt;
+    }
+
+    // Spare slots to append into: both tables must have them, or the next
+    // add moves the index
+    capacity = version >= 2 ? get32 (bytes + 22) : n;
+    if (capacity < n || prints == nullptr
+        || (size - off) / kRecordBytes < capacity
+        || printsAt < off + (size_t)capacity * kRecordBytes
+        || (size - printsAt) / printBytes < capacity)
+        capacity = n;
+}
+
+bool PatternLibrary::Mapping::payload (int index, const uint8_t*& data, size_t& size) const
+{
+    if (!juce::isPositiveAndBelow (index, (int)numEntries))
+        return false;
+
+    const uint8_t* rec = record (index);
+    const uint32_t off = get32 (rec + kRecOffset);
+    const uint32_t len = get32 (rec + kRecSize);
+    if (off < kHeaderBytes || off > size || len > size - off)
+        return false;
+
+    data = bytes + off;
+    size = len;
+    return true;
+}
+
+std::shared_ptr<const PatternLibrary::Mapping> PatternLibrary::mapping() const
+{
+    const juce::SpinLock::ScopedLockType sl (mapLock);
+    return current;
+}
+
+void PatternLibrary::publish (std::shared_ptr<const Mapping> next)
+{
+    const juce::SpinLock::ScopedLockType sl (mapLock);
+    current = std::move (next);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Browsing — names straight from the mapped index
+// ─────────────────────────────────────────────────────────────────────────────
+int PatternLibrary::size() const
+{
+    return (int)mapping()->numEntries;
+}
+
+bool PatternLibrary::getEntry (int index, Entry& entry) const
+{
+    const auto map = mapping();
+    if (!juce::isPositiveAndBelow (index, (int)map->numEntries))
+        return false;
+
+    const uint8_t* rec = map->record (index);
+    entry.name      = juce::String::fromUTF8 (reinterpret_cast<const char*> (rec), (int)nameLength (rec));
+    entry.kind      = rec[kRecKind] == Kit ? Kit : PatternEntry;
+    entry.numTracks = rec[kRecTracks];
+    return true;
+}
+
+std::vector<int> PatternLibrary::find (const juce::String& filter, int start, int max, int& total) const
+{
+    std::vector<uint8_t> needle;
+    for (auto* c = filter.toRawUTF8(); *c != 0; ++c)
+        needle.push_back (lowerAscii ((uint8_t)*c));
+
+    const auto map = mapping();
+    std::vector<int> found;
+    total = 0;
+    for (int i = 0; i < (int)map->numEntries; ++i)
+    {
+        if (!needle.empty())
+        {
+            const uint8_t* rec = map->record (i);
+            const auto hit = std::search (rec, rec + nameLength (rec), needle.begin(), needle.end(),
+                                          [] (uint8_t a, uint8_t b) { return lowerAscii (a) == b; });
+            if (hit == rec + nameLength (rec))
+                continue;
+        }
+
+        if (total >= start && (int)found.size() < max)
+            found.push_back (i);
+        ++total;
+    }
+    return found;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Loading and prefetch
+// ─────────────────────────────────────────────────────────────────────────────
+//  Entries never move or change once written, so the cache stays valid
+//  across add() and is keyed by index alone.
+std::shared_ptr<const SessionState> PatternLibrary::decode (const Mapping& map, int index) const
+{
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    auto state = std::make_shared<SessionState>();
+    if (!map.payload (index, data, bytes) || !StateFormat::read (data, bytes, *state))
+        return nullptr;
+    return state;
+}
+
+std::shared_ptr<const SessionState> PatternLibrary::cached (int index) const
+{
+    const juce::ScopedLock sl (cacheLock);
+    for (const auto& c : cache)
+        if (c.index == index)
+            return c.state;
+    return nullptr;
+}
+
+void PatternLibrary::remember (int index, std::shared_ptr<const SessionState> state)
+{
+    const juce::ScopedLock sl (cacheLock);
+    cache.erase (std::remove_if (cache.begin(), cache.end(), [index] (const Cached& c) { return c.index == index; }),
+                 cache.end());
+    cache.insert (cache.begin(), { index, std::move (state) });
+    if ((int)cache.size() > kCacheSize)
+        cache.pop_back();
+}
+
+bool PatternLibrary::load (int index, SessionState& state)
+{
+    auto decoded = cached (index);
+    if (decoded == nullptr)
+    {
+        decoded = decode (*mapping(), index);
+        if (decoded == nullptr)
+            return false;
+        remember (index, decoded);
+    }
+    state = *decoded;
+    return true;
+}
+
+void PatternLibrary::prefetch (int index)
+{
+    if (!juce::isPositiveAndBelow (index, size()))
+        return;
+
+    {
+        const juce::ScopedLock sl (cacheLock);
+        if ((int)queue.size() >= kCacheSize)
+            queue.erase (queue.begin());   // scrolled past: drop the oldest request
+        queue.push_back (index);
+    }
+    notify();
+}
+
+void PatternLibrary::run()
+{
+    while (!threadShouldExit())
+    {
+        int index = -1;
+        std::unique_ptr<Addition> addition;
+        std::unique_ptr<Search> job;
+        {
+            const juce::ScopedLock sl (cacheLock);
+            if (!additions.empty())
+            {
+                addition = std::move (additions.front());
+                additions.erase (additions.begin());
+            }
+            else if (search != nullptr)
+                job = std::move (search);
+            else if (!queue.empty())
+            {
+                index = queue.front();
+                queue.erase (queue.begin());
+            }
+        }
+
+        if (addition != nullptr)
+        {
+            const int added = write (*addition);
+            if (addition->done)
+                addition->done (added);
+            continue;
+        }
+
+        if (job != nullptr)
+        {
+            runSearch (*job);
+            continue;
+        }
+
+        if (index < 0)
+        {
+            wait (-1);
+            continue;
+        }
+
+        // Decoding reads the whole payload, which also pages it in
+        if (cached (index) == nullptr)
+            if (auto decoded = decode (*mapping(), index))
+                remember (index, std::move (decoded));
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Similarity search — on the library thread, over the mapped fingerprints
+// ─────────────────────────────────────────────────────────────────────────────
+SimilarityIndex::Fingerprint PatternLibrary::fingerprint (Kind kind, const SessionState& state)
+{
+    if (kind != PatternEntry || state.patterns.empty() || state.patterns.front() == nullptr)
+        return {};
+    return SimilarityIndex::fingerprint (*state.patterns.front(), state.layout.numTracks);
+}
+
+void PatternLibrary::storeFingerprint (const Mapping& map, int index, uint64_t* prints) const
+{
+    SimilarityIndex::Fingerprint fp {};
+    if (map.record (index)[kRecKind] == PatternEntry)
+        if (auto state = decode (map, index))
+            fp = fingerprint (PatternEntry, *state);
+    std::copy (fp.begin(), fp.end(), prints + (size_t)index * SimilarityIndex::kWords);
+}
+
+void PatternLibrary::findSimilar (const Pattern& query, int numTracks, int k, SimilarCallback done)
+{
+    auto job = std::make_unique<Search>();
+    job->query = SimilarityIndex::fingerprint (query, numTracks);
+    job->k     = juce::jlimit (1, 256, k);
+    job->done  = std::move (done);
+    {
+        const juce::ScopedLock sl (cacheLock);
+        search = std::move (job);
+    }
+    notify();
+}
+
+void PatternLibrary::runSearch (const Search& job)
+{
+    const auto map = mapping();
+    const uint64_t* prints = map->prints;
+    if (prints == nullptr && map->numEntries > 0)
+    {
+        // Older file: fingerprint every entry once per mapping
+        if (backfillFor != map)
+        {
+            backfill.assign ((size_t)map->numEntries * SimilarityIndex::kWords, 0);
+            for (int i = 0; i < (int)map->numEntries && !threadShouldExit(); ++i)
+                storeFingerprint (*map, i, backfill.data());
+            backfillFor = map;
+        }
+        prints = backfill.data();
+    }
+
+    const auto& m = *map;
+    job.done (SimilarityIndex::nearest (prints, (int)m.numEntries, job.query, job.k,
+                                        [&m] (int i) { return m.record (i)[kRecKind] == PatternEntry; }));
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Adding — appended under the file's lock. The entry count in the header
+//  is raised last, once everything it points at is on disk, so a failed or
+//  torn write leaves the library as it was.
+// ─────────────────────────────────────────────────────────────────────────────
+void PatternLibrary::add (Kind kind, const juce::String& name, const SessionState& state, AddedCallback done)
+{
+    // Encoded here, so the state need not outlive the call
+    auto job = std::make_unique<Addition>();
+    job->kind      = kind;
+    job->name      = name;
+    job->numTracks = state.layout.numTracks;
+    job->print     = fingerprint (kind, state);
+    job->done      = std::move (done);
+    StateFormat::write (state, job->block);
+    {
+        const juce::ScopedLock sl (cacheLock);
+        additions.push_back (std::move (job));
+    }
+    notify();
+}
+
+int PatternLibrary::write (const Addition& job)
+{
+    if (!file.getParentDirectory().createDirectory())
+        return -1;
+
+    // Another instance may have added entries since this one last looked:
+    // the library is re-read under the lock and appended to as it is now
+    const auto held = FileLock::lock (file, kLockTimeoutMs);
+    if (held == nullptr)
+        return -1;
+
+    auto map = std::make_shared<const Mapping> (file);
+    if (!map->valid)
+        return -1;   // not a library we can read: never overwrite it
+
+    const auto&    block      = job.block;
+    const uint32_t n          = map->numEntries;
+    const size_t   printBytes = (size_t)SimilarityIndex::kWords * sizeof (uint64_t);
+    const bool     spareSlot  = n < map->capacity;
+
+    // Payload at the end; a full index moves after it with twice the room
+    const size_t payloadAt = juce::jmax (map->size, kHeaderBytes);
+    size_t   end      = payloadAt + block.getSize();
+    uint32_t capacity = map->capacity;
+    size_t   indexAt  = map->indexOffset;
+    size_t   printsAt = map->printsOffset;
+    if (!spareSlot)
+    {
+        capacity = juce::jmax (kMinCapacity, n * 2);
+        indexAt  = end;
+        printsAt = (indexAt + (size_t)capacity * kRecordBytes + 7) & ~(size_t)7;
+        end      = printsAt + (size_t)capacity * printBytes;
+    }
+    if (n >= 0x7FFFFFFF || end > 0xFFFFFFFFu)
+        return -1;
+
+    // Name cut to the field at a UTF-8 character boundary
+    uint8_t rec[kRecordBytes] = {};
+    const char* utf8 = job.name.toRawUTF8();
+    size_t len = std::strlen (utf8);
+    if (len > (size_t)kMaxNameBytes)
+    {
+        len = (size_t)kMaxNameBytes;
+        while (len > 0 && ((uint8_t)utf8[len] & 0xC0) == 0x80)
+            --len;
+    }
+    std::memcpy (rec, utf8, len);
+    for (int i = 0; i < 4; ++i)
+    {
+        rec[kRecOffset + (size_t)i] = (uint8_t)(payloadAt >> (8 * i));
+        rec[kRecSize + (size_t)i]   = (uint8_t)(block.getSize() >> (8 * i));
+    }
+    rec[kRecKind]   = job.kind;
+    rec[kRecTracks] = (uint8_t)job.numTracks;
+
+    bool written = false;
+    {
+        juce::FileOutputStream out (file);
+        if (!out.openedOk())
+            return -1;
+
+        written = out.setPosition ((juce::int64)payloadAt) && out.write (block.getData(), block.getSize());
+
+        if (spareSlot)
+        {
+            written = written && out.setPosition ((juce::int64)(indexAt + (size_t)n * kRecordBytes))
+                              && out.write (rec, kRecordBytes)
+                              && out.setPosition ((juce::int64)(printsAt + (size_t)n * printBytes));
+            for (auto word : job.print)
+                written = written && out.writeInt64 ((juce::int64)word);
+        }
+        else if (written)
+        {
+            // Libraries written before fingerprints existed get them now, once
+            std::vector<uint64_t> prints ((size_t)n * SimilarityIndex::kWords);
+            if (map->prints != nullptr)
+                std::memcpy (prints.data(), map->prints, (size_t)n * printBytes);
+            else
+                for (int i = 0; i < (int)n; ++i)
+                    storeFingerprint (*map, i, prints.data());
+            prints.insert (prints.end(), job.print.begin(), job.print.end());
+
+            const size_t spare = capacity - n - 1;
+            const size_t align = printsAt - indexAt - (size_t)capacity * kRecordBytes;
+            if (n > 0)
+                out.write (map->records, (size_t)n * kRecordBytes);
+            out.write (rec, kRecordBytes);
+            out.writeRepeatedByte (0, spare * kRecordBytes + align);
+            for (auto word : prints)
+                out.writeInt64 ((juce::int64)word);
+            out.writeRepeatedByte (0, spare * printBytes);
+        }
+
+        out.flush();   // everything the header will point at, first
+        written = written && !out.getStatus().failed();
+
+        if (written)
+        {
+            juce::MemoryOutputStream header (kHeaderBytes);
+            header.writeInt ((int)kMagic);
+            header.writeShort ((short)kVersion);
+            header.writeShort ((short)kRecordBytes);
+            header.writeInt ((int)(n + 1));
+            header.writeInt ((int)indexAt);
+            header.writeInt ((int)printsAt);
+            header.writeShort ((short)SimilarityIndex::kWords);
+            header.writeInt ((int)capacity);
+            header.writeRepeatedByte (0, kHeaderBytes - 26);
+
+            written = out.setPosition (0) && out.write (header.getData(), header.getDataSize());
+            out.flush();
+            written = written && !out.getStatus().failed();
+        }
+    }
+
+    // The library as it is now, read before another instance can change it
+    publish (std::make_shared<const Mapping> (file));
+    backfillFor.reset();
+    backfill.clear();
+    return written ? (int)n : -1;
+}
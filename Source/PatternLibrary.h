@@ -0,0 +1,165 @@
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "SimilarityIndex.h"
+#include "StateFormat.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  PatternLibrary — kits and patterns in one memory-mapped file
+//
+//    header  'OBSL' | u16 version | u16 record bytes | u32 entries |
+//            u32 index offset | u32 fingerprints offset | u16 words per
+//            fingerprint | u32 index capacity | 6 reserved bytes  (32 bytes)
+//    payload one StateFormat block per entry, anywhere after the header
+//    index   room for `capacity` fixed-size records, the first `entries`
+//            in use: name (UTF-8, zero padded) | u32 offset | u32 size |
+//            u8 kind | u8 tracks | reserved
+//    prints  8-byte aligned SimilarityIndex fingerprint per index slot (u64
+//            words, zero for kits); optional, a zero offset means none
+//
+//  The file is mapped read-only. Listing and searching read the names in
+//  place from the mapped index, so browsing tens of thousands of entries
+//  neither loads nor copies the library. An entry is decoded only when it
+//  is loaded; prefetch() decodes likely next loads on a background thread
+//  into a small cache. add() hands the entry to the same thread, which
+//  takes the file's OS lock (every plug-in instance and the Standalone app
+//  share the file), re-reads the header, appends the payload, fills the
+//  next index and fingerprint slot and only then raises the entry count.
+//  Written bytes never move or change, so other instances keep reading
+//  their own mappings meanwhile. A full index moves to the end of the file
+//  with twice the room, so an add costs the size of its entry, not of the
+//  library. Never used by the audio thread: a loaded pattern reaches it
+//  compiled.
+class PatternLibrary : private juce::Thread
+{
+public:
+    enum Kind : uint8_t { Kit = 1, PatternEntry = 2 };
+
+    struct Entry
+    {
+        juce::String name;
+        Kind         kind      = PatternEntry;
+        int          numTracks = 0;
+    };
+
+    static constexpr int kMaxNameBytes = 40;
+
+    // ~/Library/Application Support/OBSTACLE/Library.obslib and equivalents
+    static juce::File defaultFile();
+
+    explicit PatternLibrary (juce::File file);
+    ~PatternLibrary() override;
+
+    // ── Message thread ──────────────────────────────────────────────────────
+    int  size() const;
+    bool getEntry (int index, Entry& entry) const;
+
+    // Entries whose name contains `filter` (ASCII case-insensitive), skipping
+    // the first `start` matches and returning at most `max`; `total` counts
+    // every match. An empty filter matches everything.
+    std::vector<int> find (const juce::String& filter, int start, int max, int& total) const;
+
+    // Decoded entry (from the prefetch cache when it is there)
+    bool load (int index, SessionState& state);
+
+    // Decode an entry in the background ahead of a load
+    void prefetch (int index);
+
+    // Append an entry on the library thread; `done` gets its index there,
+    // or -1 if the library could not be written. Entries are written in the
+    // order they were added.
+    using AddedCallback = std::function<void (int index)>;
+    void add (Kind kind, const juce::String& name, const SessionState& state, AddedCallback done);
+
+    // The k pattern entries whose rhythm is nearest to `query`, found on the
+    // library thread and passed to `done` there. A search that has not
+    // started yet is replaced by a newer one and never reported.
+    using SimilarCallback = std::function<void (std::vector<SimilarityIndex::Match>)>;
+    void findSimilar (const Pattern& query, int numTracks, int k, SimilarCallback done);
+
+private:
+    static constexpr uint32_t kMagic         = 0x4C53424F;   // "OBSL"
+    static constexpr int      kVersion       = 2;            // 1: no spare index slots
+    static constexpr size_t   kHeaderBytes   = 32;
+    static constexpr size_t   kRecordBytes   = 64;
+    static constexpr int      kCacheSize     = 4;
+    static constexpr uint32_t kMinCapacity   = 256;          // index slots of a new or grown index
+    static constexpr int      kLockTimeoutMs = 5000;
+
+    struct Mapping
+    {
+        explicit Mapping (const juce::File& f);
+        ~Mapping();
+
+        const uint8_t* record (int index) const { return records + (size_t)index * kRecordBytes; }
+        bool payload (int index, const uint8_t*& data, size_t& size) const;
+
+        void parse (const uint8_t* data, size_t size);
+
+        struct View;
+        std::unique_ptr<View> view;
+        const uint8_t* bytes   = nullptr;
+        size_t   size          = 0;
+        const uint8_t* records = nullptr;
+        const uint64_t* prints = nullptr;   // numEntries × kWords, or none
+        uint32_t numEntries    = 0;
+        uint32_t capacity      = 0;        // index and fingerprint slots
+        uint32_t indexOffset   = (uint32_t)kHeaderBytes;
+        uint32_t printsOffset  = 0;
+        bool     valid         = false;   // empty or a readable library
+    };
+
+    struct Cached
+    {
+        int                                 index = -1;
+        std::shared_ptr<const SessionState> state;
+    };
+
+    struct Search
+    {
+        SimilarityIndex::Fingerprint query {};
+        int                          k = 10;
+        SimilarCallback              done;
+    };
+
+    struct Addition
+    {
+        Kind                         kind = PatternEntry;
+        juce::String                 name;
+        int                          numTracks = 0;
+        juce::MemoryBlock            block;   // the entry's StateFormat payload
+        SimilarityIndex::Fingerprint print {};
+        AddedCallback                done;
+    };
+
+    static SimilarityIndex::Fingerprint fingerprint (Kind kind, const SessionState& state);
+    void storeFingerprint (const Mapping& map, int index, uint64_t* prints) const;
+    void runSearch (const Search& job);
+    int  write (const Addition& job);
+
+    std::shared_ptr<const Mapping> mapping() const;
+    std::shared_ptr<const SessionState> cached (int index) const;
+    std::shared_ptr<const SessionState> decode (const Mapping& map, int index) const;
+    void remember (int index, std::shared_ptr<const SessionState> state);
+    void publish (std::shared_ptr<const Mapping> next);
+
+    void run() override;
+
+    juce::File                     file;
+    juce::SpinLock                 mapLock;
+    std::shared_ptr<const Mapping> current;
+
+    juce::CriticalSection          cacheLock;   // cache + queues (message + library thread)
+    std::vector<Cached>            cache;       // most recent first
+    std::vector<int>               queue;
+    std::unique_ptr<Search>        search;      // latest similarity query
+    std::vector<std::unique_ptr<Addition>> additions;   // oldest first
+
+    // Library thread: fingerprints for a file written without them
+    std::shared_ptr<const Mapping> backfillFor;
+    std::vector<uint64_t>          backfill;
+
+    JUCE_DECLARE_NON_COPYABLE (PatternLibrary)
+};
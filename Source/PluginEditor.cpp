@@ -919,8 +919,11 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                        [this] (const juce::var& args, auto complete) {
                            int ti = (int)args[0], s = (int)args[1];
                            int pi = proc.editPatternIdx.load();
-                           if (ti >= 0 && ti < NUM_TRACKS && s >= 0 && s < 16)
-                               proc.patterns[pi].steps[ti][s] = !proc.patterns[pi].steps[ti][s];
+                           if (ti >= 0 && ti < proc.layout.numTracks && s >= 0 && s < MAX_STEPS)
+                           {
+                               proc.patterns.edit (pi).toggleStep (ti, s);
+                               proc.patternEdited (pi);
+                           }
                            complete (juce::var{});
                        })
                    // ── Set melodic note (current edit pattern) ───────────────
@@ -928,10 +931,125 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                        [this] (const juce::var& args, auto complete) {
                            int ti = (int)args[0], s = (int)args[1], v = (int)args[2];
                            int pi = proc.editPatternIdx.load();
-                           if (ti >= 0 && ti < NUM_TRACKS && s >= 0 && s < 16)
-                               proc.patterns[pi].stepNotes[ti][s] = juce::jlimit (0, 6, v);
+                           if (ti >= 0 && ti < proc.layout.numTracks && s >= 0 && s < MAX_STEPS)
+                           {
+                               proc.patterns.edit (pi).setNote (ti, s, v);
+                               proc.patternEdited (pi);
+                           }
                            complete (juce::var{});
                        })
+                   // ── Parameter locks of one step (current edit pattern):
+                   //    {vol, tone, …} as 0-255, -1 = not locked ────────────
+                   .withNativeFunction ("juceLockGet",
+                       [this] (const juce::var& args, auto complete) {
+                           int ti = (int)args[0], s = (int)args[1];
+                           auto* obj = new juce::DynamicObject();
+                           if (ti >= 0 && ti < proc.layout.numTracks && s >= 0 && s < MAX_STEPS)
+                           {
+                               const auto& pat = proc.patterns[proc.editPatternIdx.load()];
+                               for (int p = LOCK_VOL; p < NUM_LOCK_PARAMS; ++p)
+                                   obj->setProperty (kLockParamNames[p], pat.lock (ti, s, p));
+                           }
+                           complete (juce::var (obj));
+                       })
+                   // Lock a parameter on a step (value 0-255, -1 = unlock);
+                   // false when the pattern has no room for another lock
+                   .withNativeFunction ("juceLockSet",
+                       [this] (const juce::var& args, auto complete) {
+                           int ti = (int)args[0], s = (int)args[1], v = (int)args[3];
+                           int param = LOCK_NONE;
+                           for (int p = LOCK_VOL; p < NUM_LOCK_PARAMS; ++p)
+                               if (args[2].toString() == kLockParamNames[p]) param = p;
+
+                           int pi = proc.editPatternIdx.load();
+                           const auto& pat = proc.patterns[pi];
+                           bool ok = ti >= 0 && ti < proc.layout.numTracks && s >= 0 && s < MAX_STEPS
+                                  && param != LOCK_NONE
+                                  && (v < 0 || pat.lock (ti, s, param) >= 0 || pat.numLocks() < MAX_PARAM_LOCKS);
+                           if (ok)
+                           {
+                               if (param == LOCK_RATCHET && v >= 0)
+                                   v = juce::jlimit (1, MAX_RATCHETS, v);
+                               auto& dst = proc.patterns.edit (pi);
+                               if (v < 0) dst.clearLock (ti, s, param);
+                               else       dst.setLock (ti, s, param, v);
+                               proc.patternEdited (pi);
+                           }
+                           complete (ok);
+                       })
+                   // ── Set track length (current edit pattern, polymeter) ────
+                   .withNativeFunction ("juceTrackLength",
+                       [this] (const juce::var& args, auto complete) {
+                           int ti = (int)args[0], len = (int)args[1];
+                           int pi = proc.editPatternIdx.load();
+                           if (ti >= 0 && ti < proc.layout.numTracks)
+                           {
+                               proc.patterns.edit (pi).setTrackLength (ti, len);
+                               proc.patternEdited (pi);
+                           }
+                           complete (juce::var{});
+                       })
+                   // ── Set track groove template (current edit pattern) ──────
+                   .withNativeFunction ("juceTrackGroove",
+                       [this] (const juce::var& args, auto complete) {
+                           int ti = (int)args[0], g = (int)args[1];
+                           int pi = proc.editPatternIdx.load();
+                           if (ti >= 0 && ti < proc.layout.numTracks && g >= 0 && g < kNumGrooves)
+                           {
+                               proc.patterns.edit (pi).trackGroove[(size_t)ti] = (uint8_t)g;
+                               proc.patternEdited (pi);
+                           }
+                           complete (juce::var{});
+                       })
+                   // ── Track layout: add / remove last / change voice type ───
+                   //    (each returns the full state — every pattern changes shape)
+                   .withNativeFunction ("juceTrackAdd",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.addTrack ((int)args[0]);
+                           complete (buildStateVar());
+                       })
+                   .withNativeFunction ("juceTrackRemove",
+                       [this] (const juce::var&, auto complete) {
+                           proc.removeLastTrack();
+                           complete (buildStateVar());
+                       })
+                   .withNativeFunction ("juceTrackVoice",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.setTrackVoice ((int)args[0], (int)args[1]);
+                           complete (buildStateVar());
+                       })
+                   .withNativeFunction ("juceTrackOutput",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.setTrackOutput ((int)args[0], (int)args[1]);
+                           complete (buildStateVar());
+                       })
+                   // MIDI input map: [track, note (-1 = any), channel (0 = any)]
+                   .withNativeFunction ("juceTrackMidiIn",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.setTrackMidiIn ((int)args[0], (int)args[1], (int)args[2]);
+                           complete (buildStateVar());
+                       })
+                   // Sample track file: [track, clear] — picks one unless clearing
+                   .withNativeFunction ("juceTrackSample",
+                       [this] (const juce::var& args, auto complete) {
+                           const int t = juce::jlimit (0, MAX_TRACKS - 1, (int)args[0]);
+                           if ((int)args[1] != 0) {
+                               proc.setTrackSample (t, {});
+                               complete (buildStateVar());
+                               return;
+                           }
+                           const auto current = proc.getTrackSample (t);
+                           sampleChooser = std::make_unique<juce::FileChooser> (
+                               "Sample for track " + juce::String (t + 1),
+                               current.existsAsFile() ? current : juce::File::getSpecialLocation (juce::File::userMusicDirectory),
+                               "*.wav;*.aif;*.aiff");
+                           sampleChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                               [this, t, complete] (const juce::FileChooser& fc) {
+                                   if (fc.getResult() != juce::File())
+                                       proc.setTrackSample (t, fc.getResult());
+                                   complete (buildStateVar());
+                               });
+                       })
                    // ── Select pattern to edit ────────────────────────────────
                    .withNativeFunction ("jucePatternSelect",
                        [this] (const juce::var& args, auto complete) {
@@ -939,6 +1057,14 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                            proc.editPatternIdx.store (idx);
                            complete (buildPatternVar (idx));
                        })
+                   // ── Paste: pattern args[0] shares args[1]'s storage ───────
+                   .withNativeFunction ("jucePatternCopy",
+                       [this] (const juce::var& args, auto complete) {
+                           int dst = juce::jlimit (0, NUM_PATTERNS - 1, (int)args[0]);
+                           int src = juce::jlimit (0, NUM_PATTERNS - 1, (int)args[1]);
+                           proc.copyPattern (dst, src);
+                           complete (buildPatternVar (dst));
+                       })
                    // ── Force next song slot ───────────────────────────────────
                    .withNativeFunction ("juceSongNext",
                        [this] (const juce::var&, auto complete) {
@@ -950,12 +1076,20 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                        [this] (const juce::var& args, auto complete) {
                            int slot    = juce::jlimit (0, NUM_SONG_SLOTS - 1, (int)args[0]);
                            int patIdx  = juce::jlimit (0, NUM_PATTERNS  - 1, (int)args[1]);
-                           int repeat  = juce::jlimit (1, 8,                  (int)args[2]);
-                           proc.songChain[slot].patternIndex = patIdx;
-                           proc.songChain[slot].repeatCount  = repeat;
+                           int repeat  = juce::jlimit (1, MAX_REPEATS,        (int)args[2]);
+                           proc.songChain[slot].patternIndex = (uint8_t)patIdx;
+                           proc.songChain[slot].repeatCount  = (uint8_t)repeat;
                            // Expand/shrink chain length
                            if (slot + 1 > proc.songChainLength)
                                proc.songChainLength = slot + 1;
+                           proc.songChainEdited (slot);
+                           complete (juce::var{});
+                       })
+                   // ── Shorten / lengthen the song chain ─────────────────────
+                   .withNativeFunction ("juceSongChainLength",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.songChainLength = juce::jlimit (1, NUM_SONG_SLOTS, (int)args[0]);
+                           proc.songChainEdited (proc.songChainLength - 1);
                            complete (juce::var{});
                        })
                    // ── Set loop mode ──────────────────────────────────────────
@@ -964,6 +1098,83 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                            proc.songLoopMode = ((int)args[0] != 0);
                            complete (juce::var{});
                        })
+                   // ── Library: page of entries matching a name filter ───────
+                   .withNativeFunction ("juceLibraryList",
+                       [this] (const juce::var& args, auto complete) {
+                           int total = 0;
+                           const auto found = proc.library.find (args[0].toString(),
+                                                                 juce::jmax (0, (int)args[1]),
+                                                                 juce::jlimit (1, 256, (int)args[2]), total);
+                           juce::Array<juce::var> entries;
+                           for (int index : found)
+                           {
+                               auto entry = buildLibraryEntryVar (index);
+                               if (entry.isObject())
+                                   entries.add (entry);
+                           }
+                           auto* obj = new juce::DynamicObject();
+                           obj->setProperty ("total",   total);
+                           obj->setProperty ("entries", juce::var (entries));
+                           obj->setProperty ("cued",    proc.getCuedLibraryEntry());
+                           complete (juce::var (obj));
+                       })
+                   // ── Library: args[0] entries nearest to the edited pattern's
+                   //    rhythm; searched on the library thread, answered here ─
+                   .withNativeFunction ("juceLibrarySimilar",
+                       [this] (const juce::var& args, auto complete) {
+                           juce::Component::SafePointer<ObstacleEditor> editor (this);
+                           proc.library.findSimilar (proc.patterns[proc.editPatternIdx.load()], proc.layout.numTracks,
+                                                     (int)args[0],
+                               [editor, complete] (std::vector<SimilarityIndex::Match> matches) {
+                                   juce::MessageManager::callAsync ([editor, complete, matches] {
+                                       if (editor == nullptr)
+                                           return;
+                                       juce::Array<juce::var> entries;
+                                       for (const auto& m : matches)
+                                       {
+                                           auto entry = editor->buildLibraryEntryVar (m.index);
+                                           if (auto* obj = entry.getDynamicObject())
+                                           {
+                                               obj->setProperty ("distance", m.distance);
+                                               entries.add (entry);
+                                           }
+                                       }
+                                       complete (juce::var (entries));
+                                   });
+                               });
+                       })
+                   // ── Library: save the edit pattern (0) or the kit (1);
+                   //    written on the library thread, answered here ────────
+                   .withNativeFunction ("juceLibrarySave",
+                       [this] (const juce::var& args, auto complete) {
+                           const auto kind = (int)args[0] != 0 ? PatternLibrary::Kit : PatternLibrary::PatternEntry;
+                           juce::Component::SafePointer<ObstacleEditor> editor (this);
+                           proc.saveToLibrary (kind, args[1].toString(),
+                               [editor, complete] (int index) {
+                                   juce::MessageManager::callAsync ([editor, complete, index] {
+                                       if (editor == nullptr)
+                                           return;
+                                       complete (index);
+                                   });
+                               });
+                       })
+                   // ── Library: decode ahead of a load (selection) ───────────
+                   .withNativeFunction ("juceLibraryPrefetch",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.library.prefetch ((int)args[0]);
+                           complete (juce::var{});
+                       })
+                   // ── Library: load args[0] (next loop boundary while
+                   //    playing), then prefetch args[1], the entry after it ──
+                   .withNativeFunction ("juceLibraryLoad",
+                       [this] (const juce::var& args, auto complete) {
+                           const bool ok = proc.loadFromLibrary ((int)args[0]);
+                           proc.library.prefetch ((int)args[1]);
+                           auto* obj = new juce::DynamicObject();
+                           obj->setProperty ("ok",   ok);
+                           obj->setProperty ("cued", proc.getCuedLibraryEntry());
+                           complete (juce::var (obj));
+                       })
                    // ── Play / Stop ───────────────────────────────────────────
                    .withNativeFunction ("jucePlay",
                        [this] (const juce::var&, auto complete) {
@@ -975,6 +1186,18 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                            proc.playing.store (false);
                            complete (juce::var{});
                        })
+                   // ── Undo / redo (return the full state: any pattern or
+                   //    chain slot may have changed) ───────────────────────
+                   .withNativeFunction ("juceUndo",
+                       [this] (const juce::var&, auto complete) {
+                           proc.undo();
+                           complete (buildStateVar());
+                       })
+                   .withNativeFunction ("juceRedo",
+                       [this] (const juce::var&, auto complete) {
+                           proc.redo();
+                           complete (buildStateVar());
+                       })
                    // ── Randomize and return new pattern ─────────────────────
                    .withNativeFunction ("juceRandomize",
                        [this] (const juce::var&, auto complete) {
@@ -985,13 +1208,54 @@ ObstacleEditor::ObstacleEditor (ObstacleProcessor& p)
                    // ── Parameter change ──────────────────────────────────────
                    .withNativeFunction ("juceParam",
                        [this] (const juce::var& args, auto complete) {
-                           setParam (args[0].toString(), (float)args[1]);
+                           // Dense ID from the UI (legacy pages may still send names)
+                           const int id = args[0].isString()
+                                              ? proc.params.idForUiName (args[0].toString())
+                                              : (int)args[0];
+                           proc.params.setFromUi (id, (float)args[1]);
                            complete (juce::var{});
                        })
                    // ── Initial state request ─────────────────────────────────
                    .withNativeFunction ("juceGetState",
                        [this] (const juce::var&, auto complete) {
                            complete (buildStateVar());
+                       })
+                   // ── Multi-core rendering on/off ───────────────────────────
+                   .withNativeFunction ("juceMultiCore",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.setMultiCore ((int)args[0] != 0);
+                           auto* obj = new juce::DynamicObject();
+                           obj->setProperty ("multiCore",     proc.getMultiCore());
+                           obj->setProperty ("renderThreads", proc.getNumRenderThreads());
+                           complete (juce::var (obj));
+                       })
+                   // ── FX pipeline on/off (reports the added latency) ────────
+                   .withNativeFunction ("juceFxPipeline",
+                       [this] (const juce::var& args, auto complete) {
+                           proc.setPipelineMode ((int)args[0] != 0);
+                           auto* obj = new juce::DynamicObject();
+                           obj->setProperty ("pipeline",        proc.getPipelineMode());
+                           obj->setProperty ("latencySamples",  proc.getLatencySamples());
+                           complete (juce::var (obj));
+                       })
+                   // ── Disk recorder (Standalone): [on, "wav" | "flac"] ──────
+                   .withNativeFunction ("juceRecord",
+                       [this] (const juce::var& args, auto complete) {
+                           if ((int)args[0] != 0)
+                               proc.startRecording (args[1].toString() == "flac");
+                           else
+                               proc.stopRecording();
+                           complete (buildRecorderVar());
+                       })
+                   // ── Host-sync instrumentation ─────────────────────────────
+                   .withNativeFunction ("juceClockStats",
+                       [this] (const juce::var&, auto complete) {
+                           const auto& clk = proc.getClock();
+                           auto* obj = new juce::DynamicObject();
+                           obj->setProperty ("driftSamples",    (double)clk.getLastDriftSamples());
+                           obj->setProperty ("maxDriftSamples", (double)clk.getMaxDriftSamples());
+                           obj->setProperty ("resyncs",         clk.getResyncCount());
+                           complete (juce::var (obj));
                        }))
 {
     clearWebViewCache();
@@ -1042,6 +1306,34 @@ void ObstacleEditor::timerCallback()
         obj->setProperty ("playSongSlot",   psSlot);
         webView.emitEventIfBrowserIsVisible ("songStateUpdate", juce::var (obj));
     }
+
+    const int history = (proc.canUndo() ? 1 : 0) | (proc.canRedo() ? 2 : 0);
+    if (history != lastHistory) {
+        lastHistory = history;
+        auto* obj = new juce::DynamicObject();
+        obj->setProperty ("canUndo", (history & 1) != 0);
+        obj->setProperty ("canRedo", (history & 2) != 0);
+        webView.emitEventIfBrowserIsVisible ("historyUpdate", juce::var (obj));
+    }
+
+    // Recorder: once a second while recording, at every dropout, start and stop
+    const auto rec        = proc.recorder.getStats();
+    const auto recSeconds = proc.recorder.isRecording()
+                                ? rec.samplesWritten / juce::jmax ((juce::int64)1, (juce::int64)proc.recorder.getSampleRate())
+                                : (juce::int64)-1;
+    if (recSeconds != lastRecSeconds || rec.dropouts != lastRecDropouts || rec.writeFailed != lastRecFailed) {
+        lastRecSeconds  = recSeconds;
+        lastRecDropouts = rec.dropouts;
+        lastRecFailed   = rec.writeFailed;
+        webView.emitEventIfBrowserIsVisible ("recorderUpdate", buildRecorderVar());
+    }
+
+    // Library cue waiting → committed (the UI then reloads the state)
+    const int cued = proc.getCuedLibraryEntry();
+    if (cued != lastLibraryCue) {
+        lastLibraryCue = cued;
+        webView.emitEventIfBrowserIsVisible ("libraryCueUpdate", juce::var (cued));
+    }
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -1068,22 +1360,26 @@ ObstacleEditor::getResource (const juce::String& url)
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  Build flat track array [{pattern,notes}...] — used by juceRandomize
+//  Build flat track array [{pattern,notes,locks,length,groove}...] — used by juceRandomize
 // ─────────────────────────────────────────────────────────────────────────────
 juce::var ObstacleEditor::buildPatternArray (int patIdx) const
 {
     const auto& pat = proc.patterns[patIdx];
     juce::Array<juce::var> result;
-    for (int t = 0; t < NUM_TRACKS; ++t)
+    for (int t = 0; t < proc.layout.numTracks; ++t)
     {
         auto* obj = new juce::DynamicObject();
-        juce::Array<juce::var> pats, notes;
-        for (int s = 0; s < 16; ++s) {
-            pats.add  (juce::var (pat.steps[t][s]));
-            notes.add (juce::var (pat.stepNotes[t][s]));
+        juce::Array<juce::var> pats, notes, locks;
+        for (int s = 0; s < MAX_STEPS; ++s) {
+            pats.add  (juce::var (pat.step (t, s)));
+            notes.add (juce::var (pat.note (t, s)));
+            locks.add (juce::var (((pat.lockSteps[t] >> s) & 1u) != 0));
         }
         obj->setProperty ("pattern", juce::var (pats));
         obj->setProperty ("notes",   juce::var (notes));
+        obj->setProperty ("locks",   juce::var (locks));
+        obj->setProperty ("length",  (int)pat.trackLength[t]);
+        obj->setProperty ("groove",  (int)pat.trackGroove[t]);
         result.add (juce::var (obj));
     }
     return juce::var (result);
@@ -1094,26 +1390,48 @@ juce::var ObstacleEditor::buildPatternArray (int patIdx) const
 // ─────────────────────────────────────────────────────────────────────────────
 juce::var ObstacleEditor::buildPatternVar (int patIdx) const
 {
-    const auto& pat = proc.patterns[patIdx];
     auto* wrapper = new juce::DynamicObject();
-
-    juce::Array<juce::var> trackArr;
-    for (int t = 0; t < NUM_TRACKS; ++t)
-    {
-        auto* obj = new juce::DynamicObject();
-        juce::Array<juce::var> pats, notes;
-        for (int s = 0; s < 16; ++s) {
-            pats.add  (juce::var (pat.steps[t][s]));
-            notes.add (juce::var (pat.stepNotes[t][s]));
-        }
-        obj->setProperty ("pattern", juce::var (pats));
-        obj->setProperty ("notes",   juce::var (notes));
-        trackArr.add (juce::var (obj));
-    }
-    wrapper->setProperty ("tracks", juce::var (trackArr));
+    wrapper->setProperty ("tracks", buildPatternArray (patIdx));
     return juce::var (wrapper);
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+//  Library entry {index, name, kit, tracks}, or void if there is none
+// ─────────────────────────────────────────────────────────────────────────────
+juce::var ObstacleEditor::buildLibraryEntryVar (int index) const
+{
+    PatternLibrary::Entry e;
+    if (!proc.library.getEntry (index, e))
+        return {};
+
+    auto* obj = new juce::DynamicObject();
+    obj->setProperty ("index",  index);
+    obj->setProperty ("name",   e.name);
+    obj->setProperty ("kit",    e.kind == PatternLibrary::Kit);
+    obj->setProperty ("tracks", e.numTracks);
+    return juce::var (obj);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// { available, recording, file, seconds, dropouts, droppedSeconds, peakFill, failed }
+juce::var ObstacleEditor::buildRecorderVar() const
+{
+    const auto& rec   = proc.recorder;
+    const auto  stats = rec.getStats();
+    const auto  rate  = juce::jmax (1.0, rec.getSampleRate());
+
+    auto* obj = new juce::DynamicObject();
+    obj->setProperty ("available",      proc.wrapperType == juce::AudioProcessor::wrapperType_Standalone);
+    obj->setProperty ("recording",      rec.isRecording());
+    obj->setProperty ("file",           rec.getFile().getFullPathName());
+    obj->setProperty ("seconds",        (double)stats.samplesWritten / rate);
+    obj->setProperty ("dropouts",       stats.dropouts);
+    obj->setProperty ("droppedSeconds", (double)stats.samplesDropped / rate);
+    obj->setProperty ("peakFill",       stats.peakFill);
+    obj->setProperty ("failed",         stats.writeFailed);
+    return juce::var (obj);
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 //  Build full state juce::var (for initial sync)
 // ─────────────────────────────────────────────────────────────────────────────
@@ -1127,47 +1445,94 @@ juce::var ObstacleEditor::buildStateVar() const
     if (proc.driveParam)     obj->setProperty ("drive",  (double)juce::jlimit (1.f, 20.f, proc.driveParam->get() * 2.f));
     if (proc.keyParam)       obj->setProperty ("key",    (int)proc.keyParam->get());
 
+    // Dense parameter IDs for the UI bridge (name → id)
+    auto* ids = new juce::DynamicObject();
+    for (auto name : { "bpm", "reverb", "delay", "cutoff", "drive", "key" })
+        ids->setProperty (name, proc.params.idForUiName (name));
+    obj->setProperty ("paramIds", juce::var (ids));
+
     obj->setProperty ("editPatternIdx", proc.editPatternIdx.load());
     obj->setProperty ("playPatternIdx", proc.playPatternIdx.load());
     obj->setProperty ("playSongSlot",   proc.playSongSlot.load());
     obj->setProperty ("songChainLength", proc.songChainLength);
     obj->setProperty ("songLoopMode",    proc.songLoopMode);
-
-    // All 8 patterns as flat track arrays [{pattern,notes}...]
-    juce::Array<juce::var> allPats;
-    for (int pi = 0; pi < NUM_PATTERNS; ++pi)
-        allPats.add (buildPatternArray (pi));
-    obj->setProperty ("allPatterns", juce::var (allPats));
-
-    // Song chain slots
+    obj->setProperty ("multiCore",       proc.getMultiCore());
+    obj->setProperty ("renderThreads",   proc.getNumRenderThreads());
+    obj->setProperty ("pipeline",        proc.getPipelineMode());
+    obj->setProperty ("latencySamples",  proc.getLatencySamples());
+    obj->setProperty ("recorder",        buildRecorderVar());
+
+    // Track layout: voice type per track + the type names for the selector
+    juce::Array<juce::var> trackArr, typeNames;
+    for (int t = 0; t < proc.layout.numTracks; ++t)
+        trackArr.add ((int)proc.layout.voice[(size_t)t]);
+    for (auto* name : kVoiceTypeNames)
+        typeNames.add (juce::String (name));
+    obj->setProperty ("trackVoices", juce::var (trackArr));
+
+    // Output routing: 0 = main, 1 = aux pre-FX, 2 = aux post-FX; aux only
+    // takes effect while the host has that track's bus enabled
+    juce::Array<juce::var> outArr, busArr;
+    for (int t = 0; t < proc.layout.numTracks; ++t) {
+        outArr.add (proc.getTrackOutput (t));
+        busArr.add (proc.isAuxBusEnabled (t));
+    }
+    obj->setProperty ("trackOutputs", juce::var (outArr));
+    obj->setProperty ("auxEnabled",   juce::var (busArr));
+
+    // MIDI input map: note (-1 = any) and channel (0 = any) per track
+    juce::Array<juce::var> inNoteArr, inChanArr;
+    for (int t = 0; t < proc.layout.numTracks; ++t) {
+        inNoteArr.add ((int)proc.layout.midiInNote[(size_t)t]);
+        inChanArr.add ((int)proc.layout.midiInChannel[(size_t)t]);
+    }
+    obj->setProperty ("midiInNotes",    juce::var (inNoteArr));
+    obj->setProperty ("midiInChannels", juce::var (inChanArr));
+
+    // Sample files: "" for none, else { name, seconds, streamed, error }
+    juce::Array<juce::var> sampleArr;
+    for (int t = 0; t < proc.layout.numTracks; ++t) {
+        const auto& file = proc.getTrackSample (t);
+        if (file == juce::File()) {
+            sampleArr.add (juce::String());
+            continue;
+        }
+        auto* smp = new juce::DynamicObject();
+        smp->setProperty ("name",  file.getFileName());
+        smp->setProperty ("error", proc.getTrackSampleError (t));
+        if (auto src = proc.getTrackSampleSource (t)) {
+            smp->setProperty ("seconds",  (double)src->length / src->sampleRate);
+            smp->setProperty ("streamed", !src->resident);
+        }
+        sampleArr.add (juce::var (smp));
+    }
+    obj->setProperty ("trackSamples", juce::var (sampleArr));
+    obj->setProperty ("voiceTypes",  juce::var (typeNames));
+
+    juce::Array<juce::var> grooveNames;
+    for (const auto& g : kGrooves)
+        grooveNames.add (juce::String (g.name));
+    obj->setProperty ("grooves",     juce::var (grooveNames));
+    obj->setProperty ("maxTracks",   MAX_TRACKS);
+
+    // The edited pattern's bank as flat track arrays [{pattern,notes}...];
+    // other banks are sent by jucePatternSelect when opened
+    const int bankBase = proc.editPatternIdx.load() / PATTERNS_PER_BANK * PATTERNS_PER_BANK;
+    juce::Array<juce::var> bankPats;
+    for (int pi = bankBase; pi < bankBase + PATTERNS_PER_BANK; ++pi)
+        bankPats.add (buildPatternArray (pi));
+    obj->setProperty ("bankBase",     bankBase);
+    obj->setProperty ("bankPatterns", juce::var (bankPats));
+
+    // Active song chain slots
     juce::Array<juce::var> chain;
-    for (int sl = 0; sl < NUM_SONG_SLOTS; ++sl) {
+    for (int sl = 0; sl < proc.songChainLength; ++sl) {
         auto* slotObj = new juce::DynamicObject();
-        slotObj->setProperty ("patternIndex", proc.songChain[sl].patternIndex);
-        slotObj->setProperty ("repeatCount",  proc.songChain[sl].repeatCount);
+        slotObj->setProperty ("patternIndex", (int)proc.songChain[sl].patternIndex);
+        slotObj->setProperty ("repeatCount",  (int)proc.songChain[sl].repeatCount);
         chain.add (juce::var (slotObj));
     }
     obj->setProperty ("songChain", juce::var (chain));
 
     return juce::var (obj);
 }
-
-// ─────────────────────────────────────────────────────────────────────────────
-//  Set parameter from JS
-// ─────────────────────────────────────────────────────────────────────────────
-void ObstacleEditor::setParam (const juce::String& name, float value)
-{
-    auto setNorm = [] (juce::AudioParameterFloat* p, float v) {
-        if (p) p->setValueNotifyingHost (p->getNormalisableRange().convertTo0to1 (v));
-    };
-
-    if      (name == "bpm")    setNorm (proc.bpmParam,       juce::jlimit (60.f, 200.f, value));
-    else if (name == "reverb") setNorm (proc.reverbParam,     juce::jlimit (0.f,  1.f,   value / 100.f));
-    else if (name == "delay")  setNorm (proc.delayMixParam,   juce::jlimit (0.f,  0.9f,  value / 100.f * 0.9f));
-    else if (name == "cutoff") setNorm (proc.filterCutParam,  juce::jlimit (500.f, 20000.f, value));
-    else if (name == "drive")  setNorm (proc.driveParam,      juce::jlimit (0.5f, 10.f, value * 0.5f));
-    else if (name == "key" && proc.keyParam)
-        proc.keyParam->setValueNotifyingHost (
-            proc.keyParam->getNormalisableRange().convertTo0to1 (
-                juce::jlimit (-12.f, 12.f, value)));
-}
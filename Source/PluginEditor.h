@@ -38,13 +38,20 @@ private:
     juce::var buildPatternVar(int patIdx)    const; // { tracks:[{pattern,notes}...] }
     juce::var buildPatternArray(int patIdx) const; // flat [{pattern,notes}...] for randomize
     juce::var buildStateVar()               const;
-    void      setParam (const juce::String& name, float value);
+    juce::var buildRecorderVar()            const;
+    juce::var buildLibraryEntryVar(int index) const;
 
     // ── state ─────────────────────────────────────────────────────────────────
     int  lastStep              = -1;
     bool uiPlaying             = false;
     int  lastPlayPatternIdx    = -1;
     int  lastPlaySongSlot      = -1;
+    int  lastLibraryCue        = -1;
+    int  lastHistory           = -1;    // bit 0 = can undo, bit 1 = can redo
+    juce::int64 lastRecSeconds = -2;    // -1 = not recording
+    int  lastRecDropouts       = -1;
+    bool lastRecFailed         = false;
+    std::unique_ptr<juce::FileChooser> sampleChooser;   // open while a sample is being picked
 
     // ── WebView (must come AFTER proc in declaration order) ───────────────────
     SinglePageBrowser webView;
@@ -1,9 +1,37 @@
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+#if ! OBSTACLE_HEADLESS
+ #include "PluginEditor.h"
+#endif
+
+// Per voice type range of the track "tone" parameter: {min, max, default}
+static const float kToneRange[NUM_VOICE_TYPES][3] = {
+    { 0.10f, 1.50f, 0.40f },   // KICK  : sub decay
+    { 0.05f, 0.50f, 0.18f },   // SNARE : noise decay
+    { 0.01f, 0.30f, 0.06f },   // HIHAT : closed decay
+    { 0.00f, 1.00f, 0.80f },   // BASS  : filter openness
+    { 0.01f, 0.50f, 0.12f },   // LEAD  : attack
+    { 0.10f, 5.00f, 1.50f },   // PAD   : attack
+    { 0.02f, 60.0f, 60.0f },   // SAMPLE: length
+};
+
+static float toneDefault01(int type)
+{
+    const auto* r = kToneRange[type];
+    return (r[2] - r[0]) / (r[1] - r[0]);
+}
+
+// Main stereo out + one optional aux out per track (disabled until the host enables it)
+static juce::AudioProcessor::BusesProperties makeBuses()
+{
+    auto buses = juce::AudioProcessor::BusesProperties()
+                     .withOutput ("Output", juce::AudioChannelSet::stereo(), true);
+    for (int t = 0; t < MAX_TRACKS; ++t)
+        buses = buses.withOutput ("Track " + juce::String (t + 1), juce::AudioChannelSet::stereo(), false);
+    return buses;
+}
 
 ObstacleProcessor::ObstacleProcessor()
-    : AudioProcessor (BusesProperties()
-                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true))
+    : AudioProcessor (makeBuses())
 {
     // ── Global ──────────────────────────────────────────────────────────────
     addParameter (bpmParam = new juce::AudioParameterFloat (
@@ -42,38 +70,68 @@ ObstacleProcessor::ObstacleProcessor()
         "key", "Key Transpose", -12, 12, 0));
 
     // ── Per-track ────────────────────────────────────────────────────────────
+    //  The classic six keep their IDs and ranges; tracks 7-32 get a 0-1 tone
+    //  control that is mapped onto whatever voice type the track plays.
     static const char* ids[]   = { "kick","snare","hihat","bass","lead","pad" };
     static const char* names[] = { "Kick","Snare","Hihat","Bass","Lead","Pad" };
 
-    // decay param ranges per track: {min, max, default}
-    static const float decRange[NUM_TRACKS][3] = {
-        { 0.10f, 1.50f, 0.40f },   // KICK  : sub decay
-        { 0.05f, 0.50f, 0.18f },   // SNARE : noise decay
-        { 0.01f, 0.30f, 0.06f },   // HIHAT : closed decay
-        { 0.00f, 1.00f, 0.80f },   // BASS  : filter openness
-        { 0.01f, 0.50f, 0.12f },   // LEAD  : attack
-        { 0.10f, 5.00f, 1.50f },   // PAD   : attack
-    };
-
     static const char* decIds[]   = { "kick_dec","snare_dec","hihat_dec","bass_filt","lead_atk","pad_atk" };
     static const char* decNames[] = { "Kick Decay","Snare Decay","Hihat Decay","Bass Filter","Lead Attack","Pad Attack" };
 
-    for (int t = 0; t < NUM_TRACKS; ++t)
+    for (int t = 0; t < MAX_TRACKS; ++t)
     {
+        const bool   classic = t < DEFAULT_NUM_TRACKS;
+        juce::String id      = classic ? juce::String(ids[t])   : "t" + juce::String(t + 1);
+        juce::String name    = classic ? juce::String(names[t]) : "Track " + juce::String(t + 1);
+
         addParameter (trackVolParam[t] = new juce::AudioParameterFloat (
-            juce::String(ids[t]) + "_vol",
-            juce::String(names[t]) + " Volume",
+            id + "_vol",
+            name + " Volume",
             juce::NormalisableRange<float>(0.f, 1.5f, 0.01f), 1.0f));
 
         addParameter (trackMuteParam[t] = new juce::AudioParameterBool (
-            juce::String(ids[t]) + "_mute",
-            juce::String(names[t]) + " Mute",
+            id + "_mute",
+            name + " Mute",
             false));
 
-        addParameter (trackDecParam[t] = new juce::AudioParameterFloat (
-            decIds[t], decNames[t],
-            juce::NormalisableRange<float>(decRange[t][0], decRange[t][1], 0.001f),
-            decRange[t][2]));
+        if (classic)
+            addParameter (trackDecParam[t] = new juce::AudioParameterFloat (
+                decIds[t], decNames[t],
+                juce::NormalisableRange<float>(kToneRange[t][0], kToneRange[t][1], 0.001f),
+                kToneRange[t][2]));
+        else
+            addParameter (trackDecParam[t] = new juce::AudioParameterFloat (
+                id + "_tone", name + " Tone",
+                juce::NormalisableRange<float>(0.f, 1.f, 0.001f),
+                toneDefault01(t % DEFAULT_NUM_TRACKS)));
+
+        addParameter (trackDlySendParam[t] = new juce::AudioParameterFloat (
+            id + "_dly_send", name + " Delay Send",
+            juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 1.0f));
+
+        addParameter (trackRevSendParam[t] = new juce::AudioParameterFloat (
+            id + "_rev_send", name + " Reverb Send",
+            juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 1.0f));
+    }
+
+    // ── Dense IDs: UI bridge names + scale from UI units to plain values ─────
+    params.add (PID_BPM,           bpmParam,       "bpm");
+    params.add (PID_MASTER_VOL,    masterVolParam);
+    params.add (PID_FX_REVERB,     reverbParam,    "reverb", 0.01f);   // 0-100 %
+    params.add (PID_FX_DELAY_MIX,  delayMixParam,  "delay",  0.009f);  // 0-100 % → 0-0.9
+    params.add (PID_FX_DELAY_FEED, delayFeedParam);
+    params.add (PID_FX_CUTOFF,     filterCutParam, "cutoff");
+    params.add (PID_FX_SWING,      swingParam);
+    params.add (PID_FX_DRIVE,      driveParam,     "drive",  0.5f);    // 1-20 x
+    params.add (PID_KEY,           keyParam,       "key");
+
+    for (int t = 0; t < MAX_TRACKS; ++t)
+    {
+        params.add (trackParamID (t, TP_VOL),  trackVolParam[t]);
+        params.add (trackParamID (t, TP_MUTE), trackMuteParam[t]);
+        params.add (trackParamID (t, TP_DEC),  trackDecParam[t]);
+        params.add (trackParamID (t, TP_DLY_SEND), trackDlySendParam[t]);
+        params.add (trackParamID (t, TP_REV_SEND), trackRevSendParam[t]);
     }
 
     // Pattern A = default, B-H = empty (Pattern constructor fills with false/0)
@@ -82,8 +140,38 @@ ObstacleProcessor::ObstacleProcessor()
     // Song chain: all slots point to pattern A, 1 repeat each
     for (auto& slot : songChain)
         slot = { 0, 1 };
-
-    for (int t = 0; t < NUM_TRACKS; ++t) midiActiveNote[t] = -1;
+    songChainEdited(0);
+
+    for (int t = 0; t < MAX_TRACKS; ++t) midiActiveNote[t] = -1;
+    trackVoice.fill(-1);
+    liveNote.fill(-1);
+    std::fill(std::begin(trackDlySend), std::end(trackDlySend), 1.f);
+    std::fill(std::begin(trackRevSend), std::end(trackRevSend), 1.f);
+    std::fill(std::begin(trackDlyGains), std::end(trackDlyGains), 1.f);
+    std::fill(std::begin(trackRevGains), std::end(trackRevGains), 1.f);
+
+    // A lock spans the range of the parameter it overrides; tone locks are
+    // normalised like trackTone, so they follow the track's voice type
+    auto rangeOf = [] (const juce::RangedAudioParameter* p) {
+        return LockRange { p->convertFrom0to1(0.f), p->convertFrom0to1(1.f) };
+    };
+    lockRanges[LOCK_VOL]      = rangeOf(trackVolParam[0]);
+    lockRanges[LOCK_DLY_SEND] = rangeOf(trackDlySendParam[0]);
+    lockRanges[LOCK_REV_SEND] = rangeOf(trackRevSendParam[0]);
+    lockRanges[LOCK_CUTOFF]   = rangeOf(filterCutParam);
+    lockRanges[LOCK_DRIVE]    = rangeOf(driveParam);
+    mixBuffer.assign(512, 0.f);
+
+    for (int k = 0; k < (int)transposeRatio.size(); ++k)
+        transposeRatio[k] = std::pow(2.f, (k - 12) / 12.f);
+
+    publishLayout();
+    compileAll();
+    history.reset(patterns, songChain, songChainLength);
+    journalEdits();
+
+    // Swing changes recompile off the audio thread; also frees retired lists
+    startTimerHz(30);
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -91,444 +179,1857 @@ ObstacleProcessor::ObstacleProcessor()
 // ─────────────────────────────────────────────────────────────────────────────
 void ObstacleProcessor::buildDefaultPattern(int patIdx)
 {
-    auto& pat = patterns[patIdx];
-    for (auto& row : pat.steps)     row.fill(false);
-    for (auto& row : pat.stepNotes) row.fill(0);
+    auto& pat = patterns.edit(patIdx);
+    pat.clear();
 
     // KICK — syncopated 4/4
-    for (int s : { 0, 4, 10, 12 }) pat.steps[KICK][s] = true;
+    for (int s : { 0, 4, 10, 12 }) pat.setStep(KICK, s, true);
 
     // SNARE — backbeat
-    pat.steps[SNARE][4]  = true;
-    pat.steps[SNARE][12] = true;
+    pat.setStep(SNARE, 4,  true);
+    pat.setStep(SNARE, 12, true);
 
     // HIHAT — eighth-note groove
-    for (int s : { 1, 3, 5, 7, 9, 11, 13, 15 }) pat.steps[HIHAT][s] = true;
-    pat.steps[HIHAT][0] = true;
+    for (int s : { 1, 3, 5, 7, 9, 11, 13, 15 }) pat.setStep(HIHAT, s, true);
+    pat.setStep(HIHAT, 0, true);
 
     // BASS — Trentemøller style riff in A minor
     const int bassSteps[]  = { 0, 2, 4, 5, 6, 8, 10, 12, 14, 15 };
     const int bassDegrees[]= { 0, 0, 0, 2, 0, 0, 3,  0,  0,  4  };
     for (int i = 0; i < 10; ++i) {
-        pat.steps[BASS][bassSteps[i]]     = true;
-        pat.stepNotes[BASS][bassSteps[i]] = bassDegrees[i];
+        pat.setStep(BASS, bassSteps[i], true);
+        pat.setNote(BASS, bassSteps[i], bassDegrees[i]);
     }
 
     // LEAD — sparse ghost notes
-    pat.steps[LEAD][4]  = true;  pat.stepNotes[LEAD][4]  = 0; // A3
-    pat.steps[LEAD][11] = true;  pat.stepNotes[LEAD][11] = 1; // B3
+    pat.setStep(LEAD, 4,  true);  pat.setNote(LEAD, 4,  0); // A3
+    pat.setStep(LEAD, 11, true);  pat.setNote(LEAD, 11, 1); // B3
 
     // PAD — long attack, beat 0 only
-    pat.steps[PAD][0] = true;  pat.stepNotes[PAD][0] = 0; // A2
+    pat.setStep(PAD, 0, true);  pat.setNote(PAD, 0, 0); // A2
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-void ObstacleProcessor::randomizePattern()
+//  Pattern compilation (message thread)
+// ─────────────────────────────────────────────────────────────────────────────
+//  A pattern whose storage is shared with an already compiled one (same
+//  storage, current generation) reuses that list instead of compiling again.
+void ObstacleProcessor::compileAndPublish(int patIdx)
 {
-    int patIdx = editPatternIdx.load();
-    auto& pat  = patterns[patIdx];
-
-    for (auto& row : pat.steps)     row.fill(false);
-    for (auto& row : pat.stepNotes) row.fill(0);
-
-    // KICK: 4-on-the-floor + random syncopations
-    for (int s : { 0, 4, 8, 12 }) pat.steps[KICK][s] = true;
-    for (int s = 1; s < 16; s += 2)
-        if (rng.nextFloat() > 0.82f) pat.steps[KICK][s] = true;
-
-    // SNARE: bars 4+12 always, occasional ghost
-    pat.steps[SNARE][4] = true; pat.steps[SNARE][12] = true;
-    for (int s = 0; s < 16; ++s)
-        if (s != 4 && s != 12 && rng.nextFloat() > 0.88f) pat.steps[SNARE][s] = true;
-
-    // HIHAT: 8th-note or 16th-note feel
-    bool sixteenth = rng.nextBool();
-    for (int s = 0; s < 16; ++s)
-        pat.steps[HIHAT][s] = sixteenth ? (rng.nextFloat() > 0.3f) : (s % 2 == 0);
-
-    // BASS: sparse melodic line
-    for (int s = 0; s < 16; ++s) {
-        if (rng.nextFloat() > 0.55f) {
-            pat.steps[BASS][s]     = true;
-            pat.stepNotes[BASS][s] = rng.nextInt(7);
-        }
-    }
-
-    // LEAD: very sparse
-    for (int s = 0; s < 16; ++s) {
-        if (rng.nextFloat() > 0.72f) {
-            pat.steps[LEAD][s]     = true;
-            pat.stepNotes[LEAD][s] = rng.nextInt(7);
-        }
-    }
+    const Pattern* src = patterns.storage(patIdx);
+
+    std::shared_ptr<CompiledPattern> cp;
+    for (int q = 0; q < NUM_PATTERNS && cp == nullptr; ++q)
+        if (q != patIdx && compiledFrom[q] == src && compiledGen[q] == compileGen)
+            cp = compiledOwned[q];
+    if (cp == nullptr)
+        cp = compilePattern(patterns[patIdx], layout, compiledSwing, lockRanges);
+
+    compiled[patIdx].store(cp.get(), std::memory_order_release);
+    retired.retire(std::move(compiledOwned[patIdx]), audioEpoch);
+    compiledOwned[patIdx] = std::move(cp);
+    compiledFrom[patIdx]  = src;
+    compiledGen[patIdx]   = compileGen;
+}
 
-    // PAD: every 8 steps
-    for (int s : { 0, 8 }) {
-        pat.steps[PAD][s]     = true;
-        pat.stepNotes[PAD][s] = rng.nextInt(3);
-    }
+void ObstacleProcessor::compileAll()
+{
+    ++compileGen;
+    for (int p = 0; p < NUM_PATTERNS; ++p)
+        compileAndPublish(p);
+    patternLengthsEdited(-1);
 }
 
-// ─────────────────────────────────────────────────────────────────────────────
-void ObstacleProcessor::prepareToPlay (double sampleRate, int /*samplesPerBlock*/)
+void ObstacleProcessor::patternEdited(int patIdx)
 {
-    sr = (float)sampleRate;
+    if (!juce::isPositiveAndBelow(patIdx, NUM_PATTERNS))
+        return;
 
-    kick.prepare(sr);
-    snare.prepare(sr);
-    hihat.prepare(sr);
-    bass.prepare(sr);
-    lead.prepare(sr);
-    pad.prepare(sr);
+    patterns.intern(patIdx);   // identical to another pattern → share it
+    compileAndPublish(patIdx);
+    patternLengthsEdited(patIdx);
+}
 
-    fx.prepare(sr, bpmParam->get());
-    updateStepTiming();
+void ObstacleProcessor::copyPattern(int dst, int src)
+{
+    if (!juce::isPositiveAndBelow(dst, NUM_PATTERNS) || !juce::isPositiveAndBelow(src, NUM_PATTERNS))
+        return;
 
-    sampleCounter = 0.0;
-    seqStep = 0;
+    patterns.copy(dst, src);
+    compileAndPublish(dst);
+    patternLengthsEdited(dst);
 }
 
-void ObstacleProcessor::updateStepTiming()
+void ObstacleProcessor::timerCallback()
 {
-    float currentBpm = bpmParam->get();
-    double stepSecs = 60.0 / currentBpm / 4.0;
-    samplesPerStep = stepSecs * sr;
-    fx.updateDelayTime(currentBpm);
+    const float swing = swingParam->get();
+    if (swing != compiledSwing)
+    {
+        compiledSwing = swing;
+        ++compileGen;
+
+        // The playing pattern and the next slot's pattern are needed first
+        const int playIdx = playPatternIdx.load();
+        const int nextIdx = songChain[(playSongSlot.load() + 1) % songChainLength].patternIndex;
+        compileAndPublish(playIdx);
+        if (nextIdx != playIdx)
+            compileAndPublish(nextIdx);
+        for (int p = 0; p < NUM_PATTERNS; ++p)
+            if (p != playIdx && p != nextIdx)
+                compileAndPublish(p);
+    }
+
+    if (cueEntry != nullptr && cueLatched.load() == cueArmed.load())
+        commitCue();
+
+    journalEdits();
+    retired.collect(audioEpoch);
+    songTimeline.collectGarbage();
+    samples.collectGarbage();
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-void ObstacleProcessor::triggerStep(int step, juce::MidiBuffer& midi, int samplePos, int patIdx)
+//  Library (message thread) — entries are read from the memory-mapped
+//  library and cued; the audio thread only ever sees a compiled pattern
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::saveToLibrary(PatternLibrary::Kind kind, const juce::String& name,
+                                      PatternLibrary::AddedCallback done)
+{
+    SessionState st;
+    st.layout = layout;
+    if (kind == PatternLibrary::Kit)
+    {
+        // Sounds only: tempo, swing and key belong to the song
+        for (int id = 0; id < params.size(); ++id)
+            if (auto* p = params.get(id))
+                if (p != bpmParam && p != swingParam && p != keyParam)
+                    st.params.push_back({ p->getParameterID(), p->convertFrom0to1(p->getValue()) });
+        for (int t = 0; t < MAX_TRACKS; ++t)
+            st.trackOutput[t] = trackOutput[t].load();
+    }
+    else
+    {
+        const int pi = editPatternIdx.load();
+        st.patterns.push_back(patterns.isEmpty(pi) ? nullptr : patterns.share(pi));
+    }
+    library.add(kind, name.trim().isEmpty() ? juce::String("Untitled") : name.trim(), st, std::move(done));
+}
+
+bool ObstacleProcessor::loadFromLibrary(int index)
 {
-    const auto& pat = patterns[patIdx];
-    int key = keyParam ? keyParam->get() : 0;
+    PatternLibrary::Entry info;
+    auto entry = std::make_unique<SessionState>();
+    if (!library.getEntry(index, info) || !library.load(index, *entry))
+        return false;
 
-    static const int midiChan[NUM_TRACKS] = { 1, 2, 3, 4, 5, 6 };
+    // A cue the audio thread already switched to is kept; one still waiting is replaced
+    if (cueEntry != nullptr)
+    {
+        if (cueLatched.load() == cueArmed.load())
+            commitCue();
+        else
+            cancelCue();
+    }
 
-    // ── MIDI output ───────────────────────────────────────────────────────────
-    for (int t = 0; t < NUM_TRACKS; ++t)
+    cueEntry        = std::move(entry);
+    cueKind         = info.kind;
+    cueLibraryIndex = index;
+    if (cueKind == PatternLibrary::PatternEntry)
     {
-        if (!pat.steps[t][step])          continue;
-        if (trackMuteParam[t]->get())     continue;
+        const auto& src = cueEntry->patterns.empty() ? nullptr : cueEntry->patterns.front();
+        cueOwned = compilePattern(src != nullptr ? *src : Pattern(), layout, compiledSwing, lockRanges);
+    }
 
-        int note = 0;
-        if      (t == KICK)  note = 36;
-        else if (t == SNARE) note = 38;
-        else if (t == HIHAT) note = 42;
-        else if (t == BASS)  { int d = juce::jlimit(0,6,pat.stepNotes[BASS][step]); note = kBassBaseMidi[d] + key; }
-        else if (t == LEAD)  { int d = juce::jlimit(0,6,pat.stepNotes[LEAD][step]); note = kLeadBaseMidi[d] + key; }
-        else                 { int d = juce::jlimit(0,6,pat.stepNotes[PAD][step]);  note = kPadBaseMidi[d]  + key; }
+    if (!playing.load())
+    {
+        cueIndex.store(editPatternIdx.load());
+        commitCue();   // nothing playing: no boundary to wait for
+        return true;
+    }
 
-        note = juce::jlimit(0, 127, note);
-        int velocity = juce::jlimit(1, 127, (int)(trackVolParam[t]->get() * 100.f));
+    // Odd while the cue changes: the audio thread neither latches nor plays it
+    cueArmed.fetch_add(1);
+    cueIndex.store(editPatternIdx.load());
+    cuePattern.store(cueOwned.get());
+    cueArmed.fetch_add(1);
+    return true;
+}
 
-        if (midiActiveNote[t] != -1)
-            midi.addEvent(juce::MidiMessage::noteOff(midiChan[t], midiActiveNote[t]), samplePos);
+void ObstacleProcessor::commitCue()
+{
+    if (cueEntry == nullptr)
+        return;
 
-        midi.addEvent(juce::MidiMessage::noteOn(midiChan[t], note, (juce::uint8)velocity), samplePos);
-        midiActiveNote[t] = note;
+    if (cueKind == PatternLibrary::Kit)
+        applyKit(*cueEntry);
+    else
+    {
+        const int idx = cueIndex.load();
+        patterns.assign(idx, cueEntry->patterns.empty() ? nullptr : cueEntry->patterns.front());
+        patterns.intern(idx);
+        compileAndPublish(idx);
+        patternLengthsEdited(idx);
     }
+    cancelCue();   // published first, so the audio thread never falls back to the old pattern
+}
 
-    // ── Audio voices ──────────────────────────────────────────────────────────
-    if (pat.steps[KICK][step])  kick.trigger();
-    if (pat.steps[SNARE][step]) snare.trigger();
-    if (pat.steps[HIHAT][step]) hihat.trigger(false);
+// Drop the pending cue; its compiled list is freed once no block can use it
+void ObstacleProcessor::cancelCue()
+{
+    cuePattern.store(nullptr);
+    retired.retire(std::move(cueOwned), audioEpoch);
+    cueEntry.reset();
+    cueLibraryIndex = -1;
+}
 
-    if (pat.steps[BASS][step]) {
-        int deg  = juce::jlimit(0, 6, pat.stepNotes[BASS][step]);
-        float freq = midiToFreq(kBassBaseMidi[deg] + key);
-        bass.trigger(freq);
+void ObstacleProcessor::applyKit(const SessionState& st)
+{
+    juce::HashMap<juce::String, juce::RangedAudioParameter*> byId;
+    for (int id = 0; id < params.size(); ++id)
+        if (auto* p = params.get(id))
+            byId.set(p->getParameterID(), p);
+    for (const auto& sp : st.params)
+        if (auto* p = byId[sp.id])
+            p->setValueNotifyingHost(p->convertTo0to1(sp.value));
+
+    layout = st.layout;
+    for (int t = 0; t < MAX_TRACKS; ++t) {
+        setTrackOutput(t, t < layout.numTracks ? (int)st.trackOutput[t] : (int)OUT_MAIN);
+        applyTrackSample(t, st.samples[t]);
     }
+    publishLayout();
+    compileAll();
+}
 
-    if (pat.steps[LEAD][step]) {
-        int deg  = juce::jlimit(0, 6, pat.stepNotes[LEAD][step]);
-        float freq = midiToFreq(kLeadBaseMidi[deg] + key);
-        lead.trigger(freq);
+// ─────────────────────────────────────────────────────────────────────────────
+//  Track layout (message thread) — published to the audio thread as atomics,
+//  picked up by syncTrackLayout() at the start of the next block
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::publishLayout()
+{
+    for (int t = 0; t < MAX_TRACKS; ++t) {
+        sharedVoice[t].store(layout.voice[t], std::memory_order_relaxed);
+        sharedMidiInNote[t].store(layout.midiInNote[t], std::memory_order_relaxed);
+        sharedMidiInChannel[t].store(layout.midiInChannel[t], std::memory_order_relaxed);
     }
+    sharedNumTracks.store(layout.numTracks, std::memory_order_release);
+}
 
-    if (pat.steps[PAD][step]) {
-        int deg  = juce::jlimit(0, 6, pat.stepNotes[PAD][step]);
-        float freq = midiToFreq(kPadBaseMidi[deg] + key);
-        pad.trigger(freq);
-    }
+// Fresh track: empty in every pattern, unity volume, voice-type default tone
+void ObstacleProcessor::resetTrack(int t)
+{
+    patterns.editAll([t] (Pattern& pat) {
+        pat.stepBits[t] = 0;
+        pat.stepNotes[t].fill(0);
+        pat.clearTrackLocks(t);
+        pat.setTrackLength(t, DEFAULT_STEPS);
+        pat.trackGroove[t] = 0;
+    });
+
+    *trackVolParam[t]  = 1.f;
+    *trackMuteParam[t] = false;
+    *trackDlySendParam[t] = 1.f;
+    *trackRevSendParam[t] = 1.f;
+    trackDecParam[t]->setValueNotifyingHost(toneDefault01(layout.voice[t]));
+    trackOutput[t].store(OUT_MAIN);
+    setTrackSample(t, {});
+}
+
+int ObstacleProcessor::addTrack(int voiceType)
+{
+    if (layout.numTracks >= MAX_TRACKS)
+        return -1;
+
+    const int t = layout.numTracks++;
+    layout.voice[t] = (uint8_t)juce::jlimit(0, NUM_VOICE_TYPES - 1, voiceType);
+    layout.resetMidiIn(t);
+    resetTrack(t);
+
+    publishLayout();
+    compileAll();
+    return t;
+}
+
+void ObstacleProcessor::removeLastTrack()
+{
+    if (layout.numTracks <= 1)
+        return;
+
+    --layout.numTracks;
+    publishLayout();
+    compileAll();
+}
+
+void ObstacleProcessor::setTrackVoice(int t, int voiceType)
+{
+    if (!juce::isPositiveAndBelow(t, layout.numTracks))
+        return;
+
+    layout.voice[t] = (uint8_t)juce::jlimit(0, NUM_VOICE_TYPES - 1, voiceType);
+    layout.resetMidiIn(t);
+    publishLayout();
+    compileAll();
+}
+
+void ObstacleProcessor::setTrackMidiIn(int t, int note, int channel)
+{
+    if (!juce::isPositiveAndBelow(t, layout.numTracks))
+        return;
+
+    layout.midiInNote[t]    = (int8_t)juce::jlimit(-1, 127, note);
+    layout.midiInChannel[t] = (uint8_t)juce::jlimit(0, 16, channel);
+    publishLayout();
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-void ObstacleProcessor::sendAllNotesOff(juce::MidiBuffer& midi, int samplePos)
+void ObstacleProcessor::songChainEdited(int fromSlot)
 {
-    static const int midiChan[NUM_TRACKS] = { 1, 2, 3, 4, 5, 6 };
+    rebuildTimeline(fromSlot);
+    history.record(patterns, songChain, songChainLength);
+}
+
+// A pattern edit only moves the song when the pattern's length changed, and
+// then only from the first slot that plays it (patIdx -1: any pattern)
+void ObstacleProcessor::patternLengthsEdited(int patIdx)
+{
+    const int sl = firstResizedSlot(patIdx);
+    if (sl >= 0)
+        rebuildTimeline(sl);
+    history.record(patterns, songChain, songChainLength);
+}
 
-    for (int t = 0; t < NUM_TRACKS; ++t)
+// First chain slot whose timeline span no longer matches its pattern, or -1
+int ObstacleProcessor::firstResizedSlot(int patIdx) const
+{
+    for (int sl = 0; sl < songChainLength; ++sl)
     {
-        if (midiActiveNote[t] != -1)
-        {
-            midi.addEvent(juce::MidiMessage::noteOff(midiChan[t], midiActiveNote[t]), samplePos);
-            midiActiveNote[t] = -1;
-        }
-        midi.addEvent(juce::MidiMessage::allNotesOff(midiChan[t]), samplePos);
+        const int p = songChain[sl].patternIndex;
+        if (patIdx >= 0 && p != patIdx)
+            continue;
+        if (songTimeline.loopSteps(sl) != patterns[p].length(layout.numTracks))
+            return sl;
+        if (patIdx >= 0)
+            return -1;   // every slot playing the pattern has the same span
     }
+    return -1;
+}
+
+void ObstacleProcessor::rebuildTimeline(int fromSlot)
+{
+    songTimeline.update(fromSlot, songChainLength, [this] (int sl) {
+        return SongTimeline<NUM_SONG_SLOTS>::SlotSpan { patterns[songChain[sl].patternIndex].length(layout.numTracks),
+                                                        songChain[sl].repeatCount };
+    });
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-void ObstacleProcessor::processBlock (juce::AudioBuffer<float>& buffer,
-                                       juce::MidiBuffer& midiBuffer)
+//  Undo / redo — the two versions share all but what the edit touched, so
+//  only banks and chain pages whose leaves differ are looked at
+// ─────────────────────────────────────────────────────────────────────────────
+bool ObstacleProcessor::undo()
 {
-    juce::ScopedNoDenormals noDenormals;
-    buffer.clear();
-    midiBuffer.clear();
+    if (!history.canUndo())
+        return false;
+    const auto from = history.undo();
+    applyVersion(from, history.current());
+    return true;
+}
 
-    // ── Host transport sync (GarageBand / Logic Pro) ─────────────────────────
-    if (auto* playHead = getPlayHead())
+bool ObstacleProcessor::redo()
+{
+    if (!history.canRedo())
+        return false;
+    const auto from = history.redo();
+    applyVersion(from, history.current());
+    return true;
+}
+
+void ObstacleProcessor::applyVersion(const EditHistory::Version& from, const EditHistory::Version& to)
+{
+    bool chainChanged = songChainLength != to.chainLength;
+    int  firstSlot    = juce::jmin(songChainLength, to.chainLength) - 1;
+    for (int pg = 0; pg < EditHistory::ChainArray::kLeaves; ++pg)
     {
-        const auto pos = playHead->getPosition();
-        if (pos.hasValue())
-        {
-            // Sync BPM from host
-            if (const auto hostBpm = pos->getBpm())
+        if (to.chain.sharesLeaf(from.chain, pg))
+            continue;
+        const auto& page = to.chain.leaf(pg);
+        std::copy(page.begin(), page.end(), songChain.begin() + pg * EditHistory::kChainPage);
+        firstSlot    = juce::jmin(firstSlot, pg * EditHistory::kChainPage);
+        chainChanged = true;
+    }
+    songChainLength = to.chainLength;
+
+    // Patterns after the chain, so a resized one is looked up in the new chain
+    int timelineFrom = chainChanged ? juce::jmax(0, firstSlot) : NUM_SONG_SLOTS;
+    int firstPattern = -1;
+    for (int b = 0; b < EditHistory::PatternArray::kLeaves; ++b)
+    {
+        if (to.patterns.sharesLeaf(from.patterns, b))
+            continue;
+        for (int p = b * PATTERNS_PER_BANK; p < (b + 1) * PATTERNS_PER_BANK; ++p)
+            if (patterns.storage(p) != to.patterns[p].get())
             {
-                const float hbpm = juce::jlimit(60.f, 200.f, (float)*hostBpm);
-                if (std::abs(hbpm - bpm.load()) > 0.05f)
-                {
-                    bpm.store(hbpm);
-                    *bpmParam = hbpm;
-                    updateStepTiming();
-                }
+                patterns.assign(p, to.patterns[p]);
+                compileAndPublish(p);   // published like any edit: one atomic store
+                if (firstPattern < 0) firstPattern = p;
+
+                const int sl = firstResizedSlot(p);
+                if (sl >= 0) timelineFrom = juce::jmin(timelineFrom, sl);
             }
+    }
+
+    if (firstPattern >= 0)
+        editPatternIdx.store(firstPattern);
+
+    if (timelineFrom < NUM_SONG_SLOTS)
+        rebuildTimeline(timelineFrom);
+}
 
-            // Sync play/stop from host
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::randomizePattern()
+{
+    int patIdx = editPatternIdx.load();
+    auto& pat  = patterns.edit(patIdx);
+    pat.clear();
+
+    // Each track is filled up to its own length with the figure of its
+    // voice type; the 16-step figures repeat
+    const bool sixteenth = rng.nextBool();   // hihat feel, shared by all hihat tracks
+
+    for (int t = 0; t < layout.numTracks; ++t)
+    {
+        const int len = pat.trackLength[t];
+
+        switch (layout.voice[t])
+        {
+            case KICK:   // 4-on-the-floor + random syncopations
+                for (int s = 0; s < len; ++s)
+                    if (s % 4 == 0 || (s % 2 == 1 && rng.nextFloat() > 0.82f)) pat.setStep(t, s, true);
+                break;
+
+            case SNARE:  // bars 4+12 always, occasional ghost
+                for (int s = 0; s < len; ++s)
+                    if (s % 16 == 4 || s % 16 == 12 || rng.nextFloat() > 0.88f) pat.setStep(t, s, true);
+                break;
+
+            case HIHAT:  // 8th-note or 16th-note feel
+                for (int s = 0; s < len; ++s)
+                    pat.setStep(t, s, sixteenth ? (rng.nextFloat() > 0.3f) : (s % 2 == 0));
+                break;
+
+            case BASS:   // sparse melodic line
+            case LEAD:   // very sparse
             {
-                const bool hostPlaying = pos->getIsPlaying();
-                if (hostPlaying && !wasHostPlaying)
-                {
-                    // Host just started — align sequencer to PPQ grid
-                    if (const auto ppq = pos->getPpqPosition())
-                    {
-                        const double stepsF = *ppq / 0.25; // 16th notes
-                        seqStep = (int)std::floor(stepsF) % 16;
-                        const double frac = stepsF - std::floor(stepsF);
-                        sampleCounter = samplesPerStep * (1.0 - frac);
-                    }
-                    else
-                    {
-                        seqStep = -1;
-                        sampleCounter = 0.0;
+                const float threshold = layout.voice[t] == BASS ? 0.55f : 0.72f;
+                for (int s = 0; s < len; ++s) {
+                    if (rng.nextFloat() > threshold) {
+                        pat.setStep(t, s, true);
+                        pat.setNote(t, s, rng.nextInt(7));
                     }
                 }
-                // Only let host transport control playing when inside a real DAW,
-                // not in standalone mode (where the UI button drives playing).
-                if (wrapperType != wrapperType_Standalone)
-                    playing.store(hostPlaying);
-                wasHostPlaying = hostPlaying;
+                break;
             }
+
+            case PAD:    // every 8 steps
+                for (int s = 0; s < len; s += 8) {
+                    pat.setStep(t, s, true);
+                    pat.setNote(t, s, rng.nextInt(3));
+                }
+                break;
+
+            case SAMPLE: // once a bar, sometimes on the offbeat too
+                for (int s = 0; s < len; s += 16) {
+                    pat.setStep(t, s, true);
+                    if (s + 10 < len && rng.nextFloat() > 0.6f) pat.setStep(t, s + 10, true);
+                }
+                break;
+
+            default: break;
         }
     }
 
-    // ── Sync BPM ────────────────────────────────────────────────────────────
-    float newBpm = bpmParam->get();
-    if (std::abs(newBpm - bpm.load()) > 0.05f) {
-        bpm.store(newBpm);
-        updateStepTiming();
-    }
+    patternEdited(patIdx);
+}
 
-    // ── Apply voice parameters ───────────────────────────────────────────────
-    kick.setDecay     (trackDecParam[KICK]->get());
-    snare.setDecay    (trackDecParam[SNARE]->get());
-    hihat.setDecay    (trackDecParam[HIHAT]->get());
-    bass.setFilterOpen(trackDecParam[BASS]->get());
-    lead.setAttack    (trackDecParam[LEAD]->get());
-    pad.setAttack     (trackDecParam[PAD]->get());
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    sr = (float)sampleRate;
 
-    // ── Apply FX parameters ──────────────────────────────────────────────────
-    fx.setLPCutoff     (filterCutParam->get());
-    fx.setReverbMix    (reverbParam->get());
-    fx.setDelayMix     (delayMixParam->get());
-    fx.setDelayFeedback(delayFeedParam->get());
-    fx.setDrive        (driveParam->get());
+    voices.prepare(sr);
+    mixBuffer.assign((size_t)juce::jmax(64, samplesPerBlock), 0.f);
 
-    float masterVol = masterVolParam->get();
-    double swingAmt = (double)swingParam->get();
+    // One helper per spare physical core; the audio thread is the last one
+    preparedBlockSize = samplesPerBlock;
+    if (multiCore.load())
+        renderPool.start(juce::SystemStats::getNumPhysicalCpus() - 1, samplesPerBlock, sampleRate);
+    workerMix.assign(mixBuffer.size() * RenderPool::kMaxParticipants, 0.f);
+    trackScratch.assign(mixBuffer.size() * MAX_TRACKS, 0.f);
+    sendBuses.assign(mixBuffer.size() * 3, 0.f);
 
-    // ── Cache per-track gains ────────────────────────────────────────────────
-    float trackGains[NUM_TRACKS];
-    for (int t = 0; t < NUM_TRACKS; ++t)
-        trackGains[t] = trackMuteParam[t]->get() ? 0.f : trackVolParam[t]->get();
+    fx.prepare(sr, bpmParam->get());
+    fxPipeline.prepare(fx, samplesPerBlock, sampleRate);
+    if (pipelineMode.load())
+        fxPipeline.start();
+    setLatencySamples(pipelineMode.load() ? fxPipeline.getLatencySamples() : 0);
 
-    if (!playing.load())
+    // Post-FX aux chains only for the buses the host has enabled
+    for (int t = 0; t < MAX_TRACKS; ++t)
     {
-        if (wasPreviouslyPlaying)
+        if (isAuxBusEnabled(t))
         {
-            sendAllNotesOff(midiBuffer, 0);
-            wasPreviouslyPlaying = false;
+            if (auxFx[t] == nullptr) auxFx[t] = std::make_unique<FXChain>();
+            auxFx[t]->prepare(sr, bpmParam->get());   // settings follow via markAllDirty()
         }
-        return;
+        else
+            auxFx[t].reset();
     }
-    wasPreviouslyPlaying = true;
+    auxDelay.assign((size_t)MAX_TRACKS * fxPipeline.getLatencySamples(), 0.f);
+    auxDelayPos = 0;
+    clock.prepare(sampleRate);
+    setTempo(bpmParam->get(), 0);
 
-    auto* outL = buffer.getWritePointer(0);
-    auto* outR = buffer.getWritePointer(1);
-    int numSamples = buffer.getNumSamples();
+    // A take is one sample rate: a device change ends it
+    if (recorder.isRecording() && recorder.getSampleRate() != sampleRate)
+        recorder.stop();
 
-    // Cache current playing pattern index for this block
-    int curPatIdx = playPatternIdx.load();
+    // Every parameter is re-applied at the start of the next block
+    params.markAllDirty();
+}
 
-    for (int i = 0; i < numSamples; ++i)
-    {
-        // ── Sequencer clock (with swing) ────────────────────────────────────
-        if (sampleCounter <= 0.0)
-        {
-            seqStep = (seqStep + 1) % 16;
-            currentStep.store(seqStep);
+// ─────────────────────────────────────────────────────────────────────────────
+juce::File ObstacleProcessor::startRecording(bool flac)
+{
+    const auto name = "OBSTACLE " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H%M%S");
+    const auto file = DiskRecorder::defaultDirectory().getChildFile(name + (flac ? ".flac" : ".wav"))
+                                                      .getNonexistentSibling();
+    return recorder.start(file, getSampleRate() > 0.0 ? getSampleRate() : (double)sr) ? file : juce::File();
+}
 
-            // ── Song chain advancement (at step 0) ───────────────────────────
-            if (seqStep == 0)
-            {
-                loopCount++;
-                int slot = playSongSlot.load();
-                bool advance = nextRequested.exchange(false) || (loopCount >= songChain[slot].repeatCount);
-                if (advance)
-                {
-                    loopCount     = 0;
-                    int nextSlot  = slot + 1;
-                    if (nextSlot >= songChainLength)
-                    {
-                        if (songLoopMode)
-                            nextSlot = 0;
-                        else
-                        {
-                            playing.store(false);
-                            nextSlot = 0;
-                        }
-                    }
-                    playSongSlot.store(nextSlot);
-                    curPatIdx = songChain[nextSlot].patternIndex;
-                    playPatternIdx.store(curPatIdx);
-                }
-            }
+void ObstacleProcessor::setTempo(double newBpm, int offset)
+{
+    clock.setTempo(newBpm, offset);
+    bpm.store((float)newBpm);
+    fxControl(FxPipeline::DelayTime, (float)newBpm, offset);
+}
 
-            triggerStep(seqStep, midiBuffer, i, curPatIdx);
+void ObstacleProcessor::setMultiCore(bool on)
+{
+    if (on == multiCore.load())
+        return;
 
-            // Swing: alternate step length (even=longer, odd=shorter)
-            double swingFactor = (seqStep % 2 == 0) ? (1.0 + swingAmt) : (1.0 - swingAmt);
-            sampleCounter += samplesPerStep * swingFactor;
-        }
-        --sampleCounter;
+    if (on)
+    {
+        // The audio thread leaves the pool alone until the flag is set
+        if (preparedBlockSize > 0)
+            renderPool.start(juce::SystemStats::getNumPhysicalCpus() - 1, preparedBlockSize, getSampleRate());
+        multiCore.store(true);
+        return;
+    }
 
-        // ── Sum voices with per-track gain ──────────────────────────────────
-        float mono = kick.process()  * trackGains[KICK]
-                   + snare.process() * trackGains[SNARE]
-                   + hihat.process() * trackGains[HIHAT]
-                   + bass.process()  * trackGains[BASS]
-                   + lead.process()  * trackGains[LEAD]
-                   + pad.process()   * trackGains[PAD];
+    // A block that saw the flag set may still be running on the pool
+    multiCore.store(false);
+    const auto stamp = audioEpoch.now();
+    while (!audioEpoch.hasPassed(stamp))
+        std::this_thread::yield();
+    renderPool.stop();
+}
 
-        float wet = fx.process(mono * masterVol);
+void ObstacleProcessor::setPipelineMode(bool on)
+{
+    if (on == pipelineMode.load())
+        return;
 
-        outL[i] = wet;
-        outR[i] = wet;
+    setLatencySamples(on ? fxPipeline.getLatencySamples() : 0);
+    if (on)
+    {
+        // The audio thread leaves the pipeline alone until the flag is set
+        if (preparedBlockSize > 0)
+            fxPipeline.start();
+        pipelineMode.store(true);
+        return;
     }
+
+    // A block that saw the flag set may still be running the pipeline; once
+    // it is done the stage it queued has been joined and the worker is idle
+    pipelineMode.store(false);
+    const auto stamp = audioEpoch.now();
+    while (!audioEpoch.hasPassed(stamp))
+        std::this_thread::yield();
+    fxPipeline.stop();
 }
 
-// ─────────────────────────────────────────────────────────────────────────────
-juce::AudioProcessorEditor* ObstacleProcessor::createEditor()
+void ObstacleProcessor::fxControl(FxPipeline::Control c, float value, int offset)
 {
-    return new ObstacleEditor (*this);
+    if (fxDeferred)
+        fxPipeline.control(c, value, offset);
+    else
+        FxPipeline::apply(fx, c, value);
+
+    // Post-FX aux chains run on this thread, ahead of their latency delay
+    for (auto& chain : auxFx)
+        if (chain != nullptr)
+            FxPipeline::apply(*chain, c, value);
 }
 
-void ObstacleProcessor::getStateInformation (juce::MemoryBlock& dest)
+// ─────────────────────────────────────────────────────────────────────────────
+//  Buses — main out must be stereo; each track out may be stereo, mono or off
+// ─────────────────────────────────────────────────────────────────────────────
+bool ObstacleProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    juce::MemoryOutputStream stream (dest, true);
+    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+        return false;
 
-    // BPM + all float/bool params
-    stream.writeFloat(bpmParam->get());
-    stream.writeFloat(masterVolParam->get());
-    stream.writeFloat(reverbParam->get());
-    stream.writeFloat(delayMixParam->get());
-    stream.writeFloat(delayFeedParam->get());
-    stream.writeFloat(filterCutParam->get());
-    stream.writeFloat(swingParam->get());
-    stream.writeFloat(driveParam->get());
-    stream.writeInt(keyParam->get());
-
-    for (int t = 0; t < NUM_TRACKS; ++t) {
-        stream.writeFloat(trackVolParam[t]->get());
-        stream.writeBool(trackMuteParam[t]->get());
-        stream.writeFloat(trackDecParam[t]->get());
+    for (int b = 1; b < layouts.outputBuses.size(); ++b)
+    {
+        const auto set = layouts.outputBuses[b];
+        if (!set.isDisabled() && set != juce::AudioChannelSet::stereo() && set != juce::AudioChannelSet::mono())
+            return false;
     }
+    return true;
+}
 
-    // 8 patterns × 6 tracks × 16 steps
-    for (int p = 0; p < NUM_PATTERNS; ++p)
-        for (int t = 0; t < NUM_TRACKS; ++t)
-            for (int s = 0; s < 16; ++s)
-                stream.writeBool(patterns[p].steps[t][s]);
+bool ObstacleProcessor::isAuxBusEnabled(int track) const
+{
+    const auto* bus = getBus(false, track + 1);
+    return bus != nullptr && bus->isEnabled() && bus->getNumberOfChannels() > 0;
+}
 
-    for (int p = 0; p < NUM_PATTERNS; ++p)
-        for (int t = 0; t < NUM_TRACKS; ++t)
-            for (int s = 0; s < 16; ++s)
-                stream.writeInt(patterns[p].stepNotes[t][s]);
+void ObstacleProcessor::setTrackOutput(int track, int mode)
+{
+    if (track < 0 || track >= MAX_TRACKS) return;
+    trackOutput[(size_t)track].store((uint8_t)juce::jlimit(0, NUM_TRACK_OUTPUTS - 1, mode));
+}
 
-    // Song chain
-    stream.writeInt(songChainLength);
-    stream.writeBool(songLoopMode);
-    for (int sl = 0; sl < NUM_SONG_SLOTS; ++sl) {
-        stream.writeInt(songChain[sl].patternIndex);
-        stream.writeInt(songChain[sl].repeatCount);
-    }
+juce::String ObstacleProcessor::setTrackSample(int track, const juce::File& file)
+{
+    if (track < 0 || track >= MAX_TRACKS) return {};
+    const auto error = samples.assign(track, file);
+    sampleErrors[(size_t)track] = error;
+    return error;
+}
 
-    stream.writeInt(editPatternIdx.load());
+// A saved path; one this system cannot take (saved on another OS) is dropped
+void ObstacleProcessor::applyTrackSample(int track, const juce::String& path)
+{
+    setTrackSample(track, juce::File::isAbsolutePath(path) ? juce::File(path) : juce::File());
 }
 
-void ObstacleProcessor::setStateInformation (const void* data, int sizeInBytes)
+// Resolve this block's routing: tracks whose bus is live render straight into
+// it, tracks with non-unity sends render alone and go through the send buses
+void ObstacleProcessor::routeTrackOutputs(juce::AudioBuffer<float>& buffer)
 {
-    juce::MemoryInputStream stream (data, (size_t)sizeInBytes, false);
-    if (stream.getNumBytesRemaining() < 4) return;
+    numAuxRouted = numSendTracks = 0;
+    const int numTracks = sharedNumTracks.load(std::memory_order_relaxed);
 
-    *bpmParam       = stream.readFloat();
-    *masterVolParam = stream.readFloat();
-    *reverbParam    = stream.readFloat();
-    *delayMixParam  = stream.readFloat();
-    *delayFeedParam = stream.readFloat();
-    *filterCutParam = stream.readFloat();
-    *swingParam     = stream.readFloat();
-    *driveParam     = stream.readFloat();
-    *keyParam       = stream.readInt();
+    for (int t = 0; t < MAX_TRACKS; ++t)
+    {
+        auxOut[t] = auxOutR[t] = nullptr;
+        if (t >= numTracks)
+            continue;
 
-    for (int t = 0; t < NUM_TRACKS; ++t) {
-        if (stream.getNumBytesRemaining() < 4) break;
-        *trackVolParam[t]  = stream.readFloat();
-        *trackMuteParam[t] = stream.readBool();
-        *trackDecParam[t]  = stream.readFloat();
+        const bool unitySends = trackDlyGains[t] == 1.f && trackRevGains[t] == 1.f;
+        if (trackOutput[t].load(std::memory_order_relaxed) == OUT_MAIN)
+        {
+            if (!unitySends) sendTracks[numSendTracks++] = (uint8_t)t;
+            continue;
+        }
+
+        const auto* bus = getBus(false, t + 1);
+        if (bus != nullptr && bus->isEnabled() && bus->getNumberOfChannels() > 0)
+        {
+            auxOut[t] = buffer.getWritePointer(bus->getChannelIndexInProcessBlockBuffer(0));
+            if (bus->getNumberOfChannels() > 1)
+                auxOutR[t] = buffer.getWritePointer(bus->getChannelIndexInProcessBlockBuffer(1));
+        }
+        if (auxOut[t] != nullptr)
+            ++numAuxRouted;
+        else if (!unitySends)
+            sendTracks[numSendTracks++] = (uint8_t)t;
     }
+}
 
-    // 8 patterns × 6 tracks × 16 steps (bool)
-    for (int p = 0; p < NUM_PATTERNS; ++p)
-        for (int t = 0; t < NUM_TRACKS; ++t)
-            for (int s = 0; s < 16; ++s)
-                if (stream.getNumBytesRemaining() > 0)
-                    patterns[p].steps[t][s] = stream.readBool();
+// Delay the aux buses by the pipeline latency when the main out is pipelined,
+// then copy channel 0 to channel 1
+void ObstacleProcessor::finishAuxOutputs(int numSamples)
+{
+    const int latency = fxPipeline.getLatencySamples();
+    if (!fxDeferred && auxDelayDirty)
+    {
+        std::fill(auxDelay.begin(), auxDelay.end(), 0.f);
+        auxDelayDirty = false;
+    }
 
-    // 8 patterns × 6 tracks × 16 steps (int)
-    for (int p = 0; p < NUM_PATTERNS; ++p)
-        for (int t = 0; t < NUM_TRACKS; ++t)
-            for (int s = 0; s < 16; ++s)
-                if (stream.getNumBytesRemaining() >= 4)
-                    patterns[p].stepNotes[t][s] = stream.readInt();
+    for (int t = 0; t < MAX_TRACKS; ++t)
+    {
+        float* out = auxOut[t];
+        if (out == nullptr) continue;
 
-    // Song chain
-    if (stream.getNumBytesRemaining() >= 4)
-        songChainLength = juce::jlimit(1, NUM_SONG_SLOTS, stream.readInt());
-    if (stream.getNumBytesRemaining() > 0)
-        songLoopMode = stream.readBool();
-    for (int sl = 0; sl < NUM_SONG_SLOTS; ++sl) {
-        if (stream.getNumBytesRemaining() >= 8) {
-            songChain[sl].patternIndex = juce::jlimit(0, NUM_PATTERNS - 1, stream.readInt());
-            songChain[sl].repeatCount  = juce::jlimit(1, 8, stream.readInt());
+        if (fxDeferred)
+        {
+            float* ring = auxDelay.data() + (size_t)t * latency;
+            for (int i = 0, p = auxDelayPos; i < numSamples; ++i)
+            {
+                std::swap(out[i], ring[p]);
+                if (++p == latency) p = 0;
+            }
+            auxDelayDirty = true;
         }
+
+        if (auxOutR[t] != nullptr)
+            std::copy(out, out + numSamples, auxOutR[t]);
     }
 
-    if (stream.getNumBytesRemaining() >= 4) {
-        int ep = juce::jlimit(0, NUM_PATTERNS - 1, stream.readInt());
+    if (fxDeferred)
+        auxDelayPos = (auxDelayPos + numSamples) % latency;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Step trigger — one bit test per track; offset hits are deferred
+//
+//  Hits are timed from the step's exact boundary, `late` samples before the
+//  tick's sample, so swing, grooves and ratchets keep their sub-sample
+//  position; each hit plays on the first sample at or after its time and
+//  tells the voice how far past it that is.
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::triggerStep(int64_t slotStep, juce::MidiBuffer& midi, int samplePos, float late,
+                                    const CompiledPattern& cp)
+{
+    const double  samplesPerStep = clock.getSamplesPerStep();
+    const int64_t tickSample     = clock.getBlockStart() + samplePos;
+    const double  boundary       = (double)tickSample - late;
+
+    // Polymeter: every track runs its own cycle from the start of the slot
+    for (int t = 0; t < cp.numLanes; ++t)
+    {
+        const int len = juce::jmax(1, (int)cp.lanes[(size_t)t].length);
+        const auto* e = cp.find(t, (int)(slotStep % len));
+        if (e == nullptr)
+            continue;
+
+        const float* locks = e->lockMask != 0 ? cp.lockValues.data() + e->firstLock : nullptr;
+        for (int k = 0; k < e->ratchets; ++k)
+        {
+            const double  at     = boundary + (e->offset + (double)k / e->ratchets) * samplesPerStep;
+            const int64_t sample = juce::jmax(tickSample, (int64_t)std::ceil(at - 1e-6));
+            const float   lateBy = (float)juce::jlimit(0.0, 1.0, (double)sample - at);
+
+            if (sample == tickSample)
+            {
+                fireTrigger(*e, locks, midi, samplePos, lateBy);
+                continue;
+            }
+            if (numPending == kMaxPending)
+            {
+                // Queue full: the first hit plays now, the others are dropped
+                if (k == 0)
+                    fireTrigger(*e, locks, midi, samplePos, 0.f);
+                continue;
+            }
+
+            auto& p = pending[numPending++];
+            p.sample = sample;
+            p.late   = lateBy;
+            p.ev     = *e;
+            if (locks != nullptr)
+                std::copy_n(locks, juce::countNumberOfBits((uint32_t)e->lockMask), p.locks.begin());
+        }
+    }
+}
+
+void ObstacleProcessor::fireTrigger(const TriggerEvent& e, const float* locks, juce::MidiBuffer& midi,
+                                    int samplePos, float late)
+{
+    const int t = e.track;
+
+    // A layout change may still be in flight: the track must play this voice type
+    if (trackMuted[t] || trackVoice[t] != e.voice)
+        return;
+
+    // Unlocked steps on a track holding no locks skip this with one test
+    if ((e.lockMask | trackLocked[t]) != 0)
+        applyLocks(t, e.lockMask, locks, samplePos);
+
+    // ── MIDI output ───────────────────────────────────────────────────────────
+    const int note     = e.freq > 0.f ? juce::jlimit(0, 127, e.note + transpose) : e.note;
+    const int velocity = juce::jlimit(1, 127, (int)(e.velocity * trackGains[t]));
+
+    if (midiActiveNote[t] != -1)
+        midi.addEvent(juce::MidiMessage::noteOff(e.channel, midiActiveNote[t]), samplePos);
+
+    midi.addEvent(juce::MidiMessage::noteOn(e.channel, note, (juce::uint8)velocity), samplePos);
+    midiActiveNote[t] = note;
+
+    // ── Audio voice ───────────────────────────────────────────────────────────
+    voices.trigger(e.voice, t, e.freq * transposeRatio[(size_t)(transpose + 12)], late,
+                   clock.getBlockStart() + samplePos);
+    liveNote[t] = -1;   // the voice is the sequencer's now: a key release leaves it be
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  MIDI input — note on / off copied into a fixed list (block order, offsets
+//  clamped to the block); everything else is ignored
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::collectMidiInput(const juce::MidiBuffer& midi, int numSamples)
+{
+    numMidiIn = 0;
+    for (const auto meta : midi)
+    {
+        // Raw bytes: a MidiMessage of a long SysEx would allocate
+        if (meta.numBytes < 3 || numMidiIn == kMaxMidiIn)
+            continue;
+        const int status = meta.data[0] & 0xf0;
+        if (status != 0x80 && status != 0x90)
+            continue;
+
+        auto& m = midiIn[numMidiIn++];
+        m.sampleOffset = juce::jlimit(0, juce::jmax(0, numSamples - 1), meta.samplePosition);
+        m.channel      = (uint8_t)(meta.data[0] & 0x0f);
+        m.note         = (uint8_t)(meta.data[1] & 0x7f);
+        m.velocity     = status == 0x90 ? (uint8_t)(meta.data[2] & 0x7f) : 0;   // velocity 0 is a note-off
+    }
+}
+
+// One note, on the sample it arrived at, for every track mapped to it;
+// `when` seeds the noise as a sequenced hit on that sample would
+void ObstacleProcessor::playMidiInput(const MidiInEvent& m, int64_t when)
+{
+    for (int t = 0; t < MAX_TRACKS; ++t)
+    {
+        const int type = trackVoice[t];
+        if (type < 0)
+            continue;
+
+        const int channel = sharedMidiInChannel[t].load(std::memory_order_relaxed);
+        const int note    = sharedMidiInNote[t].load(std::memory_order_relaxed);
+        if ((channel != 0 && channel != m.channel + 1) || (note >= 0 && note != m.note))
+            continue;
+
+        if (m.velocity == 0)
+        {
+            if (liveNote[t] == (int)m.note)
+            {
+                voices.noteOff(type, t);
+                liveNote[t] = -1;
+            }
+            continue;
+        }
+
+        if (trackMuted[t])
+            continue;
+        const float freq = isMelodicVoice(type) ? midiToFreq(note >= 0 ? note : m.note) : 0.f;
+        voices.trigger(type, t, freq, 0.f, when, (float)m.velocity / 127.f);
+        liveNote[t] = (int8_t)m.note;
+    }
+
+    if (m.velocity > 0)
+        liveTail = (int)(kLiveTailSeconds * getSampleRate());
+}
+
+// Fire pending triggers due before block sample `upTo`; returns the
+// block-relative sample of the earliest one still waiting (or INT_MAX)
+int ObstacleProcessor::firePending(juce::MidiBuffer& midi, int upTo)
+{
+    const int64_t blockStart = clock.getBlockStart();
+    int64_t next = std::numeric_limits<int64_t>::max();
+
+    for (int i = 0; i < numPending;)
+    {
+        const int64_t rel = pending[i].sample - blockStart;
+        if (rel < upTo)
+        {
+            fireTrigger(pending[i].ev, pending[i].locks.data(), midi, (int)juce::jmax((int64_t)0, rel),
+                        pending[i].late);
+            pending[i] = pending[--numPending];
+            continue;
+        }
+        next = juce::jmin(next, rel);
+        ++i;
+    }
+    return (int)juce::jmin(next, (int64_t)std::numeric_limits<int>::max());
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::sendAllNotesOff(juce::MidiBuffer& midi, int samplePos)
+{
+    for (int t = 0; t < MAX_TRACKS; ++t)
+    {
+        if (midiActiveNote[t] != -1)
+        {
+            midi.addEvent(juce::MidiMessage::noteOff(t % 16 + 1, midiActiveNote[t]), samplePos);
+            midiActiveNote[t] = -1;
+        }
+    }
+
+    for (int ch = 1; ch <= 16; ++ch)
+        midi.addEvent(juce::MidiMessage::allNotesOff(ch), samplePos);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Pick up layout changes from the message thread (block start)
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::syncTrackLayout(juce::MidiBuffer& midi)
+{
+    const int n = sharedNumTracks.load(std::memory_order_acquire);
+
+    for (int t = 0; t < MAX_TRACKS; ++t)
+    {
+        const int type = t < n ? (int)sharedVoice[t].load(std::memory_order_relaxed) : -1;
+        if (type == trackVoice[t])
+            continue;
+
+        if (trackVoice[t] >= 0)
+            voices.stop(trackVoice[t], t);
+
+        if (midiActiveNote[t] != -1)
+        {
+            midi.addEvent(juce::MidiMessage::noteOff(t % 16 + 1, midiActiveNote[t]), 0);
+            midiActiveNote[t] = -1;
+        }
+
+        trackVoice[t] = (int8_t)type;
+        if (type >= 0)
+            applyTone(t);
+    }
+
+    // A replaced sample file stops the voice playing it; the old file stays
+    // mapped until this block is over
+    for (int t = 0; t < MAX_TRACKS; ++t)
+        voices.sample.setSource(t, samples.get(t));
+}
+
+void ObstacleProcessor::applyTone(int t)
+{
+    const int type = trackVoice[t];
+    if (type < 0) return;
+
+    const float tone = (trackLocked[t] & (1u << LOCK_TONE)) ? trackLockValue[t][LOCK_TONE] : trackTone[t];
+    const auto* r = kToneRange[type];
+    voices.setTone(type, t, r[0] + tone * (r[1] - r[0]));
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Parameter locks — applied at the trigger's own sample; a track's locks
+//  hold until its next trigger, which either locks again or lets go
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::updateTrackGains(int t)
+{
+    const uint8_t locked = trackLocked[t];
+    const float   vol    = (locked & (1u << LOCK_VOL)) ? trackLockValue[t][LOCK_VOL] : trackVol[t];
+    trackGains[t]    = trackMuted[t] ? 0.f : vol;
+    trackDlyGains[t] = (locked & (1u << LOCK_DLY_SEND)) ? trackLockValue[t][LOCK_DLY_SEND] : trackDlySend[t];
+    trackRevGains[t] = (locked & (1u << LOCK_REV_SEND)) ? trackLockValue[t][LOCK_REV_SEND] : trackRevSend[t];
+}
+
+void ObstacleProcessor::applyLocks(int t, uint8_t mask, const float* values, int samplePos)
+{
+    const uint8_t changed = (uint8_t)(trackLocked[t] | mask);
+
+    for (int p = LOCK_VOL, v = 0; p < NUM_SOUND_LOCKS; ++p)
+        if (mask & (1u << p))
+            trackLockValue[t][p] = values[v++];
+    trackLocked[t] = mask;
+
+    constexpr uint8_t gainLocks = (1u << LOCK_VOL) | (1u << LOCK_DLY_SEND) | (1u << LOCK_REV_SEND);
+    if (changed & gainLocks)
+    {
+        updateTrackGains(t);
+
+        // Sends that leave unity mid-block need the track rendered on its own
+        const bool unitySends = trackDlyGains[t] == 1.f && trackRevGains[t] == 1.f;
+        if (!unitySends && auxOut[t] == nullptr
+            && std::find(sendTracks.begin(), sendTracks.begin() + numSendTracks, (uint8_t)t)
+                   == sendTracks.begin() + numSendTracks)
+            sendTracks[numSendTracks++] = (uint8_t)t;
+    }
+    if (changed & (1u << LOCK_TONE))
+        applyTone(t);
+    if (changed & (1u << LOCK_CUTOFF))
+        applyFxLock(t, LOCK_CUTOFF, (mask & (1u << LOCK_CUTOFF)) != 0, samplePos);
+    if (changed & (1u << LOCK_DRIVE))
+        applyFxLock(t, LOCK_DRIVE, (mask & (1u << LOCK_DRIVE)) != 0, samplePos);
+}
+
+// Global FX locks belong to the last track that locked them; it lets go on
+// its next trigger without the lock
+void ObstacleProcessor::applyFxLock(int t, int param, bool locked, int samplePos)
+{
+    const bool cutoff  = param == LOCK_CUTOFF;
+    int&       owner   = cutoff ? cutoffLockTrack : driveLockTrack;
+    const auto control = cutoff ? FxPipeline::Cutoff : FxPipeline::Drive;
+
+    if (locked)
+    {
+        owner = t;
+        fxControl(control, trackLockValue[t][param], samplePos);
+    }
+    else if (owner == t)
+    {
+        owner = -1;
+        fxControl(control, cutoff ? cutoffBase : driveBase, samplePos);
+    }
+}
+
+// Transport stopped: every parameter goes back to its own value
+void ObstacleProcessor::releaseLocks(int samplePos)
+{
+    for (int t = 0; t < MAX_TRACKS; ++t)
+        if (trackLocked[t] != 0)
+            applyLocks(t, 0, nullptr, samplePos);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::processBlock (juce::AudioBuffer<float>& buffer,
+                                       juce::MidiBuffer& midiBuffer)
+{
+    renderBlock(buffer, midiBuffer);
+    recorder.push(buffer);   // one flag check unless recording
+}
+
+void ObstacleProcessor::renderBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    juce::ScopedNoDenormals noDenormals;
+    AudioEpoch::Scope epochScope (audioEpoch);   // compiled patterns stay alive until we return
+    buffer.clear();
+    collectMidiInput(midiBuffer, buffer.getNumSamples());
+    midiBuffer.clear();
+
+    syncTrackLayout(midiBuffer);
+
+    // ── Host transport sync (GarageBand / Logic Pro) ─────────────────────────
+    //  While the host plays, the clock re-anchors to its PPQ every block.
+    bool hostSynced = false;
+    if (auto* playHead = getPlayHead())
+    {
+        const auto pos = playHead->getPosition();
+        if (pos.hasValue())
+        {
+            const auto hostBpm = pos->getBpm();
+
+            // Reflect host tempo on the BPM parameter (display only — the clock
+            // takes the unquantised host value below)
+            if (hostBpm.hasValue())
+            {
+                const float hbpm = juce::jlimit(60.f, 200.f, (float)*hostBpm);
+                if (std::abs(hbpm - bpmParam->get()) > 0.05f)
+                    *bpmParam = hbpm;
+            }
+
+            // Only let host transport control playing when inside a real DAW,
+            // not in standalone mode (where the UI button drives playing).
+            if (wrapperType != wrapperType_Standalone)
+            {
+                const bool hostPlaying = pos->getIsPlaying();
+                playing.store(hostPlaying);
+
+                const auto ppq = pos->getPpqPosition();
+                if (hostPlaying && ppq.hasValue())
+                {
+                    double loopStart = 0.0, loopEnd = 0.0;
+                    if (pos->getIsLooping())
+                        if (const auto loop = pos->getLoopPoints())
+                        {
+                            loopStart = loop->ppqStart;
+                            loopEnd   = loop->ppqEnd;
+                        }
+
+                    clock.syncToHost(*ppq, hostBpm.hasValue() ? *hostBpm : clock.getBpm(),
+                                     loopStart, loopEnd, buffer.getNumSamples());
+                    hostSynced = true;
+
+                    if ((float)clock.getBpm() != bpm.load()) {
+                        bpm.store((float)clock.getBpm());
+                        fxControl(FxPipeline::DelayTime, (float)clock.getBpm(), 0);
+                    }
+                }
+            }
+        }
+    }
+    if (!hostSynced)
+        clock.releaseHost();
+
+    // FX pipeline on/off takes effect between blocks (the worker is idle here)
+    fxPipeline.setActive(pipelineMode.load());
+
+    // ── Parameter events (only what changed since the last block) ───────────
+    int numSamples = buffer.getNumSamples();
+    const int numEvents = params.collect(paramEvents.data(), kMaxParamEvents, numSamples);
+
+    const bool sequencing = playing.load();
+    if (!sequencing)
+    {
+        // Stopped: only MIDI input plays, and what it played rings out
+        const bool held = std::any_of(liveNote.begin(), liveNote.end(), [] (int8_t n) { return n >= 0; });
+        const bool live = numMidiIn > 0 || liveTail > 0 || held;
+
+        // Leaving the pipeline: FX controls still queued from the last block
+        // it ran go in first, so that this block's changes land on top
+        if (fxPipeline.isActive() && (wasPreviouslyPlaying || !live) && fxPipeline.hasPending())
+        {
+            fxPipeline.flush();
+            std::fill(auxDelay.begin(), auxDelay.end(), 0.f);
+            auxDelayDirty = false;
+        }
+
+        numPending = 0;
+        if (wasPreviouslyPlaying)
+        {
+            sendAllNotesOff(midiBuffer, 0);
+            releaseLocks(0);
+            wasPreviouslyPlaying = false;
+
+            // Sequenced notes end here, so that live input starts from silence
+            for (int t = 0; t < MAX_TRACKS; ++t)
+                if (trackVoice[t] >= 0 && liveNote[t] == -1)
+                    voices.stop(trackVoice[t], t);
+        }
+
+        // Silent: parameters apply at once; live: at their offsets, below
+        if (!live)
+        {
+            for (int e = 0; e < numEvents; ++e)
+                applyParam(paramEvents[e].id, paramEvents[e].value, 0);
+            return;
+        }
+    }
+    else
+        wasPreviouslyPlaying = true;
+
+    auto* outL = buffer.getWritePointer(0);
+    auto* outR = buffer.getWritePointer(1);
+    routeTrackOutputs(buffer);
+
+    // Cache current playing pattern index for this block
+    int curPatIdx = playPatternIdx.load();
+
+    // Pipelined: FX for the previous block runs on the worker while this one
+    // renders. A block over the prepared size restarts the pipeline instead.
+    fxDeferred = fxPipeline.fits(numSamples);
+    if (fxPipeline.isActive() && !fxDeferred)
+        fxPipeline.flush();
+    dryOut = fxDeferred ? fxPipeline.beginBlock() : nullptr;
+
+    // ── Split the block at event offsets: voices + FX see each change, and
+    //    play each incoming note, on the exact sample it was scheduled for ──
+    const int64_t blockStart = sequencing ? clock.getBlockStart() : liveClock;
+    int pos = 0, ev = 0, mi = 0;
+    while (pos < numSamples)
+    {
+        while (ev < numEvents && paramEvents[ev].sampleOffset <= pos)
+        {
+            applyParam(paramEvents[ev].id, paramEvents[ev].value, pos);
+            ++ev;
+        }
+        while (mi < numMidiIn && midiIn[mi].sampleOffset <= pos)
+            playMidiInput(midiIn[mi++], blockStart + pos);
+
+        const int end = juce::jmin(ev < numEvents ? paramEvents[ev].sampleOffset : numSamples,
+                                   mi < numMidiIn ? midiIn[mi].sampleOffset : numSamples);
+        if (sequencing)
+            renderRange(outL, outR, pos, end, midiBuffer, curPatIdx);
+        else
+            renderVoices(outL, outR, pos, end);
+        pos = end;
+    }
+
+    if (numAuxRouted > 0 || auxDelayDirty)
+        finishAuxOutputs(numSamples);
+
+    if (fxDeferred)
+    {
+        fxPipeline.endBlock(numSamples, outL, outR);
+        fxDeferred = false;
+        dryOut     = nullptr;
+    }
+
+    // Where each sample voice got to, for the prefetch thread
+    for (int t = 0; t < MAX_TRACKS; ++t)
+        samples.setCursor(t, voices.sample.getPosition(t));
+
+    if (sequencing)
+        clock.endBlock(numSamples);
+    else
+    {
+        liveClock += numSamples;
+        liveTail  -= numSamples;
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Apply one parameter change — O(1) dispatch on the dense ID
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::applyParam(int id, float v, int offset)
+{
+    switch (id)
+    {
+        case PID_BPM:
+            // Host-synced: tempo comes from the play head, not the quantised param
+            if (!clock.isHostAnchored())
+                setTempo(v, offset);
+            return;
+
+        case PID_MASTER_VOL:    masterVol = v;             return;
+        case PID_FX_REVERB:     fxControl(FxPipeline::ReverbMix,     v, offset); return;
+        case PID_FX_DELAY_MIX:  fxControl(FxPipeline::DelayMix,      v, offset); return;
+        case PID_FX_DELAY_FEED: fxControl(FxPipeline::DelayFeedback, v, offset); return;
+        case PID_FX_CUTOFF:
+            cutoffBase = v;
+            if (cutoffLockTrack < 0) fxControl(FxPipeline::Cutoff, v, offset);
+            return;
+        case PID_FX_SWING:      return;   // compiled into the trigger lists (timerCallback)
+        case PID_FX_DRIVE:
+            driveBase = v;
+            if (driveLockTrack < 0) fxControl(FxPipeline::Drive, v, offset);
+            return;
+        case PID_KEY:           transpose = juce::jlimit(-12, 12, (int)std::lround(v)); return;
+        default: break;
+    }
+
+    const int rel = id - PID_TRACK_BASE;
+    if (rel < 0 || rel >= MAX_TRACKS * NUM_TRACK_PARAMS) return;
+
+    const int t = rel / NUM_TRACK_PARAMS;
+    switch (rel % NUM_TRACK_PARAMS)
+    {
+        case TP_VOL:  trackVol[t]   = v;         break;
+        case TP_MUTE: trackMuted[t] = v >= 0.5f; break;
+        case TP_DEC:
+            // Stored normalised so it follows the track if its voice type changes
+            trackTone[t] = trackDecParam[t]->convertTo0to1(v);
+            applyTone(t);
+            return;
+        case TP_DLY_SEND: trackDlySend[t] = v; break;
+        case TP_REV_SEND: trackRevSend[t] = v; break;
+        default: return;
+    }
+
+    updateTrackGains(t);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Render [start, end) — split at step boundaries and deferred triggers
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::renderRange(float* outL, float* outR, int start, int end,
+                                    juce::MidiBuffer& midiBuffer, int& curPatIdx)
+{
+    int i = start;
+    while (i < end)
+    {
+        const int due  = firePending(midiBuffer, i + 1);
+        const int tick = juce::jmax(i, clock.nextTickOffset());
+        const int stop = juce::jmin(end, tick, due);
+
+        if (stop > i)
+        {
+            renderVoices(outL, outR, i, stop);
+            i = stop;
+            continue;
+        }
+
+        advanceSequencer(clock.consumeTick(), midiBuffer, i, curPatIdx);
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::advanceSequencer(SeqClock::Tick tick, juce::MidiBuffer& midiBuffer,
+                                         int samplePos, int& curPatIdx)
+{
+    if (tick.jumped)
+    {
+        numPending = 0;   // delayed hits from before the relocation are dropped
+        seekSong(tick.step, curPatIdx);
+    }
+    else
+    {
+        ++slotStep;
+        const auto* cur = playingPattern(curPatIdx);
+        if (++patStep >= (cur != nullptr ? cur->length : DEFAULT_STEPS))
+        {
+            patStep = 0;
+
+            // Loop boundary: switch to a cued library entry (not while it is being armed)
+            if (const uint32_t armed = cueArmed.load(); (armed & 1) == 0)
+                cueLatched.store(armed);
+
+            // ── Song chain advancement (pattern wrapped) ─────────────────────
+            loopCount++;
+            int slot = playSongSlot.load();
+            bool advance = nextRequested.exchange(false) || (loopCount >= songChain[slot].repeatCount);
+            if (advance)
+            {
+                loopCount     = 0;
+                slotStep      = 0;
+                int nextSlot  = slot + 1;
+                if (nextSlot >= songChainLength)
+                {
+                    if (songLoopMode)
+                        nextSlot = 0;
+                    else
+                    {
+                        playing.store(false);
+                        nextSlot = 0;
+                        // In a DAW the host keeps playing: stay silent until it relocates
+                        outsideSong = clock.isHostAnchored();
+                    }
+                }
+                playSongSlot.store(nextSlot);
+                curPatIdx = songChain[nextSlot].patternIndex;
+                playPatternIdx.store(curPatIdx);
+            }
+        }
+    }
+
+    if (outsideSong)
+        return;
+
+    currentStep.store((int)slotStep);
+    if (const auto* cp = playingPattern(curPatIdx))
+        triggerStep(slotStep, midiBuffer, samplePos, tick.late, *cp);
+}
+
+// The compiled pattern to play for patIdx: a latched library cue overrides
+// it. cueArmed is a sequence count, so a cue re-armed between the reads of
+// its pattern and index is never mixed up with the one that was latched.
+const CompiledPattern* ObstacleProcessor::playingPattern(int patIdx) const
+{
+    const uint32_t armed = cueArmed.load();
+    if (armed == cueLatched.load())
+    {
+        const auto* cue = cuePattern.load();
+        if (cue != nullptr && patIdx == cueIndex.load() && cueArmed.load() == armed)
+            return cue;
+    }
+    return compiled[patIdx].load(std::memory_order_acquire);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Relocation: host PPQ → song position (slot, loop, step) via the timeline
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::seekSong(int64_t absStep, int& curPatIdx)
+{
+    if (!clock.isHostAnchored())
+    {
+        // Free-running: keep the current slot, align to the step grid only
+        const auto* cp  = playingPattern(curPatIdx);
+        const int   len = cp != nullptr ? cp->length : DEFAULT_STEPS;
+        outsideSong = false;
+        patStep  = (int)(((absStep % len) + len) % len);
+        slotStep = (int64_t)loopCount * len + patStep;
+        return;
+    }
+
+    const auto pos = songTimeline.locate(absStep, songLoopMode);
+    outsideSong = pos.outside;
+    if (pos.outside)
+        return;
+
+    loopCount = pos.loop;
+    patStep   = pos.step;
+    slotStep  = pos.slotStep;
+    playSongSlot.store(pos.slot);
+    curPatIdx = songChain[pos.slot].patternIndex;
+    playPatternIdx.store(curPatIdx);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Offline rendering — start mid-song, engine snapshots
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::startSongAt(int64_t sample)
+{
+    // Step 0 is a jump, as at a normal start; any later tick advances from
+    // the step before it, which is where the song is put
+    const int64_t step = clock.startAt(sample);
+    numPending  = 0;
+    outsideSong = false;
+    loopCount = patStep = 0;
+    slotStep  = 0;
+
+    int slot = 0;
+    if (step > 0)
+    {
+        const auto pos = songTimeline.locate(step - 1, songLoopMode);
+        outsideSong = pos.outside;
+        loopCount   = pos.loop;
+        patStep     = pos.step;
+        slotStep    = pos.slotStep;
+        slot        = pos.slot;
+    }
+    playSongSlot.store(slot);
+    playPatternIdx.store(songChain[slot].patternIndex);
+}
+
+int64_t ObstacleProcessor::getSlotStartSample(int slot) const
+{
+    return clock.sampleOfStep(songTimeline.slotStart(slot));
+}
+
+// Lead and pad notes hold until their track plays again and a sample can
+// ring for a minute, so the last hit before the slot on each such track may
+// still sound at its start. The step boundary is at or before the hit.
+int64_t ObstacleProcessor::getHeldNotesStart(int slot) const
+{
+    slot = juce::jlimit(0, songChainLength, slot);
+    int64_t start = getSlotStartSample(slot);
+
+    for (int t = 0; t < layout.numTracks; ++t)
+    {
+        const int voice = layout.voice[t];
+        if (voice != LEAD && voice != PAD && voice != SAMPLE)
+            continue;
+
+        for (int sl = slot - 1; sl >= 0; --sl)
+        {
+            const auto* cp = compiledOwned[songChain[sl].patternIndex].get();
+            if (cp == nullptr || cp->lanes[(size_t)t].mask == 0)
+                continue;
+
+            // The track cycles from the slot start: its last hit is within one
+            // cycle of the slot's end
+            const auto&   lane  = cp->lanes[(size_t)t];
+            const int     len   = juce::jmax(1, (int)lane.length);
+            const int64_t first = songTimeline.slotStart(sl);
+            const int64_t steps = songTimeline.slotStart(sl + 1) - first;
+            int64_t last = -1;
+            for (int64_t s = steps - 1; s >= juce::jmax((int64_t)0, steps - len) && last < 0; --s)
+                if ((lane.mask >> (s % len)) & 1)
+                    last = s;
+
+            if (last >= 0)
+            {
+                start = juce::jmin(start, clock.sampleOfStep(first + last));
+                break;
+            }
+        }
+    }
+    return start;
+}
+
+template <typename T>
+static void copyState(T& dst, const T& src)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::memcpy(&dst, &src, sizeof(T));
+}
+
+void ObstacleProcessor::saveEngine(EngineState& st) const
+{
+    jassert(!fxPipeline.isActive());   // the pipeline holds a block of FX state of its own
+
+    st.voices = voices;
+    st.fx     = fx;
+    for (int t = 0; t < MAX_TRACKS; ++t)
+        st.auxFx[t] = auxFx[t] != nullptr ? std::make_unique<FXChain>(*auxFx[t]) : nullptr;
+    st.auxDelay      = auxDelay;
+    st.auxDelayPos   = auxDelayPos;
+    st.auxDelayDirty = auxDelayDirty;
+
+    st.clock          = clock;
+    st.loopCount      = loopCount;
+    st.patStep        = patStep;
+    st.slotStep       = slotStep;
+    st.outsideSong    = outsideSong;
+    st.wasPlaying     = wasPreviouslyPlaying;
+    st.playSongSlot   = playSongSlot.load();
+    st.playPatternIdx = playPatternIdx.load();
+
+    std::copy(pending.begin(), pending.begin() + numPending, st.pending.begin());
+    st.numPending = numPending;
+
+    st.trackLocked = trackLocked;
+    copyState(st.trackLockValue, trackLockValue);
+    copyState(st.trackGains, trackGains);
+    copyState(st.trackDlyGains, trackDlyGains);
+    copyState(st.trackRevGains, trackRevGains);
+    st.cutoffLockTrack = cutoffLockTrack;
+    st.driveLockTrack  = driveLockTrack;
+    st.trackVoice      = trackVoice;
+    copyState(st.midiActiveNote, midiActiveNote);
+    st.liveNote  = liveNote;
+    st.liveTail  = liveTail;
+    st.liveClock = liveClock;
+}
+
+void ObstacleProcessor::restoreEngine(const EngineState& st)
+{
+    jassert(!fxPipeline.isActive());
+
+    voices = st.voices;
+    fx     = st.fx;
+    for (int t = 0; t < MAX_TRACKS; ++t)
+        if (auxFx[t] != nullptr && st.auxFx[t] != nullptr)   // buses enabled since keep their fresh chain
+            *auxFx[t] = *st.auxFx[t];
+    if (auxDelay.size() == st.auxDelay.size())
+        auxDelay = st.auxDelay;
+    auxDelayPos   = st.auxDelayPos;
+    auxDelayDirty = st.auxDelayDirty;
+
+    clock                = st.clock;
+    loopCount            = st.loopCount;
+    patStep              = st.patStep;
+    slotStep             = st.slotStep;
+    outsideSong          = st.outsideSong;
+    wasPreviouslyPlaying = st.wasPlaying;
+    playSongSlot.store(st.playSongSlot);
+    playPatternIdx.store(st.playPatternIdx);
+
+    std::copy(st.pending.begin(), st.pending.begin() + st.numPending, pending.begin());
+    numPending = st.numPending;
+
+    trackLocked = st.trackLocked;
+    copyState(trackLockValue, st.trackLockValue);
+    copyState(trackGains, st.trackGains);
+    copyState(trackDlyGains, st.trackDlyGains);
+    copyState(trackRevGains, st.trackRevGains);
+    cutoffLockTrack = st.cutoffLockTrack;
+    driveLockTrack  = st.driveLockTrack;
+    trackVoice      = st.trackVoice;
+    copyState(midiActiveNote, st.midiActiveNote);
+    liveNote  = st.liveNote;
+    liveTail  = st.liveTail;
+    liveClock = st.liveClock;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::renderVoices(float* outL, float* outR, int start, int end)
+{
+    float* mix = mixBuffer.data();
+    const size_t stride = mixBuffer.size();
+
+    for (int pos = start; pos < end;)
+    {
+        const int n = juce::jmin(end - pos, (int)stride);
+
+        // ── Sum sounding voices with per-track gain (voice-major) ───────────
+        //    Aux-routed tracks render directly into their own bus, tracks
+        //    with their own send levels into a scratch buffer each
+        std::fill(mix, mix + n, 0.f);
+        for (int t = 0; t < MAX_TRACKS; ++t)
+            voiceDest[t] = auxOut[t] != nullptr ? auxOut[t] + pos : mix;
+        for (int k = 0; k < numSendTracks; ++k)
+        {
+            float* scratch = trackScratch.data() + sendTracks[k] * stride;
+            std::fill(scratch, scratch + n, 0.f);
+            voiceDest[sendTracks[k]] = scratch;
+        }
+
+        const int numActive = voices.getNumActive();
+        if (multiCore.load(std::memory_order_acquire) && renderPool.getNumParticipants() > 1
+            && numActive > 1 && n >= kMinParallelSamples && n * numActive >= kMinParallelVoiceSamples)
+            renderVoicesParallel(mix, n, voices.collectActive(renderJobs.data()));
+        else
+            voices.render(voiceDest.data(), n, trackGains);
+
+        if (numAuxRouted > 0)
+        {
+            for (int t = 0; t < MAX_TRACKS; ++t)
+            {
+                float* aux = auxOut[t];
+                if (aux == nullptr) continue;
+
+                auto* chain = trackOutput[t].load(std::memory_order_relaxed) == OUT_AUX_POST ? auxFx[t].get() : nullptr;
+                const float ds = trackDlyGains[t], rs = trackRevGains[t];
+                for (int i = pos; i < pos + n; ++i)
+                {
+                    const float x = aux[i] * masterVol;
+                    aux[i] = chain != nullptr ? chain->process(x, x * ds, x * rs) : x;
+                }
+            }
+        }
+
+        // ── Direct / delay send / reverb send — unity tracks feed all three ─
+        float* direct = mix;
+        float* dlySend = mix;
+        float* revSend = mix;
+        if (numSendTracks > 0)
+        {
+            direct  = sendBuses.data();
+            dlySend = direct + stride;
+            revSend = dlySend + stride;
+            std::copy(mix, mix + n, direct);
+            std::copy(mix, mix + n, dlySend);
+            std::copy(mix, mix + n, revSend);
+
+            for (int k = 0; k < numSendTracks; ++k)
+            {
+                const int t = sendTracks[k];
+                const float* scratch = trackScratch.data() + t * stride;
+                const float ds = trackDlyGains[t], rs = trackRevGains[t];
+                for (int i = 0; i < n; ++i)
+                {
+                    direct[i]  += scratch[i];
+                    dlySend[i] += scratch[i] * ds;
+                    revSend[i] += scratch[i] * rs;
+                }
+            }
+        }
+
+        if (dryOut != nullptr)
+        {
+            // FX run on the pipeline worker
+            const int latency = fxPipeline.getLatencySamples();
+            for (int i = 0; i < n; ++i)
+            {
+                dryOut[pos + i]               = direct[i]  * masterVol;
+                dryOut[latency + pos + i]     = dlySend[i] * masterVol;
+                dryOut[2 * latency + pos + i] = revSend[i] * masterVol;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                float wet = dryMaster ? direct[i] * masterVol
+                                      : fx.process(direct[i] * masterVol, dlySend[i] * masterVol, revSend[i] * masterVol);
+                outL[pos + i] = wet;
+                outR[pos + i] = wet;
+            }
+        }
+        pos += n;
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Parallel voices — each participant sums its jobs into its own buffer; the
+//  audio thread adds the buffers up and retires voices that went silent
+// ─────────────────────────────────────────────────────────────────────────────
+void ObstacleProcessor::renderVoicesParallel(float* mix, int n, int numJobs)
+{
+    const int    np     = renderPool.getNumParticipants();
+    const size_t stride = mixBuffer.size();
+
+    for (int p = 0; p < np; ++p)
+        std::fill_n(workerMix.data() + p * stride, n, 0.f);
+
+    renderLength = n;
+    renderPool.run([] (void* ctx, int job, int participant) {
+                       static_cast<ObstacleProcessor*>(ctx)->renderJob(job, participant);
+                   },
+                   this, numJobs);
+
+    for (int p = 0; p < np; ++p)
+    {
+        const float* src = workerMix.data() + p * stride;
+        for (int i = 0; i < n; ++i)
+            mix[i] += src[i];
+    }
+
+    for (int j = 0; j < numJobs; ++j)
+        if (!renderAlive[j])
+            voices.stop(renderJobs[j].type, renderJobs[j].voice);
+}
+
+void ObstacleProcessor::renderJob(int job, int participant)
+{
+    const auto& r = renderJobs[job];
+    float* dst = voiceDest[r.voice] != mixBuffer.data()
+                     ? voiceDest[r.voice]   // aux bus: only this track's voice writes here
+                     : workerMix.data() + participant * mixBuffer.size();
+    renderAlive[job] = voices.renderVoice(r.type, r.voice, dst, renderLength, trackGains[r.voice]) ? 1 : 0;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+juce::AudioProcessorEditor* ObstacleProcessor::createEditor()
+{
+   #if OBSTACLE_HEADLESS
+    return nullptr;
+   #else
+    return new ObstacleEditor (*this);
+   #endif
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  State: the chunked StateFormat. Saving captures a SessionState (values +
+//  shared pattern storage) and encodes it; nothing here touches the audio
+//  thread. Hosts that save repeatedly for undo / autosave get the previous
+//  block back when nothing changed: the last capture holds its patterns, so
+//  any later edit unshares them and shows up as a different pointer.
+// ─────────────────────────────────────────────────────────────────────────────
+SessionState ObstacleProcessor::captureSession() const
+{
+    SessionState st;
+    st.params.reserve((size_t)params.size());
+    for (int id = 0; id < params.size(); ++id)
+        if (auto* p = params.get(id))
+            st.params.push_back({ p->getParameterID(), p->convertFrom0to1(p->getValue()) });
+
+    st.layout = layout;
+    for (int t = 0; t < MAX_TRACKS; ++t) {
+        st.trackOutput[t] = trackOutput[t].load();
+        st.samples[t]     = samples.getFile(t).getFullPathName();
+    }
+
+    st.patterns.resize(NUM_PATTERNS);
+    for (int p = 0; p < NUM_PATTERNS; ++p)
+        if (!patterns.isEmpty(p))
+            st.patterns[p] = patterns.share(p);
+
+    st.chain.resize((size_t)songChainLength);
+    for (int sl = 0; sl < songChainLength; ++sl)
+        st.chain[sl] = { songChain[sl].patternIndex, songChain[sl].repeatCount };
+    st.loopMode    = songLoopMode;
+    st.editPattern = editPatternIdx.load();
+    return st;
+}
+
+// Hand the state to the journal if anything changed since the last call
+void ObstacleProcessor::journalEdits()
+{
+    auto st = captureSession();
+    if (journaled != nullptr && *journaled == st)
+        return;
+    journaled = std::make_shared<const SessionState>(std::move(st));
+    journal.append(journaled);
+}
+
+void ObstacleProcessor::getStateInformation (juce::MemoryBlock& dest)
+{
+    // Saved with the journal record it matches; later records are unsaved edits
+    journalEdits();
+    auto st = *journaled;
+    st.journalId  = journal.getId();
+    st.journalSeq = journal.getSeq();
+    if (savedSession == nullptr || *savedSession != st)
+    {
+        StateFormat::write(st, savedState);
+        savedSession = std::make_unique<SessionState>(std::move(st));
+    }
+    dest = savedState;
+}
+
+void ObstacleProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes <= 0)
+        return;
+
+    SessionState st;
+    if (StateFormat::read(data, (size_t)sizeInBytes, st))
+    {
+        // Edits journaled after this state was saved (the host went down
+        // before saving again) are replayed on top of it
+        journal.open(st.journalId, st.journalSeq, &st);
+        applySession(st);
+    }
+    else if (!StateFormat::isStateFormat(data, (size_t)sizeInBytes))
+    {
+        journal.open({}, 0, nullptr);
+        readLegacyState(data, sizeInBytes);
+    }
+    else
+        return;   // damaged or from a newer, incompatible build: keep the current state
+
+    stateLoaded();
+}
+
+void ObstacleProcessor::applySession(const SessionState& st)
+{
+    // Parameters by host ID; any the state does not mention go back to default
+    juce::HashMap<juce::String, juce::RangedAudioParameter*> byId;
+    for (int id = 0; id < params.size(); ++id)
+        if (auto* p = params.get(id)) {
+            byId.set(p->getParameterID(), p);
+            p->setValueNotifyingHost(p->getDefaultValue());
+        }
+    for (const auto& sp : st.params)
+        if (auto* p = byId[sp.id])
+            p->setValueNotifyingHost(p->convertTo0to1(sp.value));
+
+    layout = st.layout;
+    for (int t = 0; t < MAX_TRACKS; ++t) {
+        setTrackOutput(t, t < layout.numTracks ? (int)st.trackOutput[t] : (int)OUT_MAIN);
+        applyTrackSample(t, st.samples[t]);
+    }
+
+    patterns.clearAll();
+    for (int p = 0; p < juce::jmin(NUM_PATTERNS, (int)st.patterns.size()); ++p)
+        patterns.assign(p, st.patterns[p]);
+
+    songChain.fill(SongSlot());
+    songChainLength = juce::jlimit(1, NUM_SONG_SLOTS, (int)st.chain.size());
+    for (int sl = 0; sl < juce::jmin(NUM_SONG_SLOTS, (int)st.chain.size()); ++sl) {
+        songChain[sl].patternIndex = (uint8_t)juce::jlimit(0, NUM_PATTERNS - 1, (int)st.chain[sl].pattern);
+        songChain[sl].repeatCount  = (uint8_t)juce::jlimit(1, MAX_REPEATS, (int)st.chain[sl].repeats);
+    }
+    songLoopMode = st.loopMode;
+    editPatternIdx.store(juce::jlimit(0, NUM_PATTERNS - 1, st.editPattern));
+}
+
+// Pre-StateFormat states: the baseline fixed field order only
+void ObstacleProcessor::readLegacyState(const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream stream (data, (size_t)sizeInBytes, false);
+    if (stream.getNumBytesRemaining() < 4) return;
+
+    *bpmParam       = stream.readFloat();
+    *masterVolParam = stream.readFloat();
+    *reverbParam    = stream.readFloat();
+    *delayMixParam  = stream.readFloat();
+    *delayFeedParam = stream.readFloat();
+    *filterCutParam = stream.readFloat();
+    *swingParam     = stream.readFloat();
+    *driveParam     = stream.readFloat();
+    *keyParam       = stream.readInt();
+
+    for (int t = 0; t < DEFAULT_NUM_TRACKS; ++t) {
+        if (stream.getNumBytesRemaining() < 4) break;
+        *trackVolParam[t]  = stream.readFloat();
+        *trackMuteParam[t] = stream.readBool();
+        *trackDecParam[t]  = stream.readFloat();
+    }
+
+    // Bank 1: 8 patterns × 6 tracks × 16 steps (bool)
+    patterns.clearAll();
+    songChain.fill(SongSlot());
+
+    for (int p = 0; p < LEGACY_NUM_PATTERNS; ++p)
+        for (int t = 0; t < DEFAULT_NUM_TRACKS; ++t)
+            for (int s = 0; s < 16; ++s)
+                if (stream.getNumBytesRemaining() > 0)
+                    patterns.edit(p).setStep(t, s, stream.readBool());
+
+    // 8 patterns × 6 tracks × 16 steps (int)
+    for (int p = 0; p < LEGACY_NUM_PATTERNS; ++p)
+        for (int t = 0; t < DEFAULT_NUM_TRACKS; ++t)
+            for (int s = 0; s < 16; ++s)
+                if (stream.getNumBytesRemaining() >= 4)
+                    patterns.edit(p).setNote(t, s, stream.readInt());
+
+    // First 16 song slots
+    if (stream.getNumBytesRemaining() >= 4)
+        songChainLength = juce::jlimit(1, LEGACY_NUM_SONG_SLOTS, stream.readInt());
+    if (stream.getNumBytesRemaining() > 0)
+        songLoopMode = stream.readBool();
+    for (int sl = 0; sl < LEGACY_NUM_SONG_SLOTS; ++sl) {
+        if (stream.getNumBytesRemaining() >= 8) {
+            songChain[sl].patternIndex = (uint8_t)juce::jlimit(0, LEGACY_NUM_PATTERNS - 1, stream.readInt());
+            songChain[sl].repeatCount  = (uint8_t)juce::jlimit(1, LEGACY_MAX_REPEATS, stream.readInt());
+        }
+    }
+
+    if (stream.getNumBytesRemaining() >= 4) {
+        int ep = juce::jlimit(0, LEGACY_NUM_PATTERNS - 1, stream.readInt());
         editPatternIdx.store(ep);
     }
 
+    // The classic six tracks on the main outputs, full sends
+    layout = TrackLayout();
+    for (int t = 0; t < MAX_TRACKS; ++t) {
+        trackOutput[t].store(OUT_MAIN);
+        *trackDlySendParam[t] = 1.f;
+        *trackRevSendParam[t] = 1.f;
+    }
+}
+
+void ObstacleProcessor::stateLoaded()
+{
+    cancelCue();
+    patterns.dedupe();
+    publishLayout();
+    rebuildTimeline(0);   // a new chain: compileAll() then finds no pattern resized
+    compileAll();
+    history.reset(patterns, songChain, songChainLength);   // no undo across a loaded state
+    journaled = nullptr;
+    journalEdits();                                        // the journal's new base
+
     // Re-init play state from slot 0
     int startSlot = 0;
     playSongSlot.store(startSlot);
@@ -538,7 +2039,9 @@ void ObstacleProcessor::setStateInformation (const void* data, int sizeInBytes)
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
+#if ! OBSTACLE_HEADLESS
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new ObstacleProcessor();
 }
+#endif
@@ -1,60 +1,48 @@
 #pragma once
 #include <JuceHeader.h>
 #include "SynthEngine.h"
+#include "Pattern.h"
+#include "PatternBank.h"
+#include "EditHistory.h"
+#include "EditJournal.h"
+#include "PatternCompiler.h"
+#include "LockFree.h"
+#include "ParamRegistry.h"
+#include "SeqClock.h"
+#include "SongTimeline.h"
+#include "StateFormat.h"
+#include "PatternLibrary.h"
+#include "RenderPool.h"
+#include "FxPipeline.h"
+#include "DiskRecorder.h"
+#include "SamplePool.h"
 
-// ─────────────────────────────────────────────────────────────────────────────
-//  Track indices
-// ─────────────────────────────────────────────────────────────────────────────
-enum TrackID { KICK = 0, SNARE, HIHAT, BASS, LEAD, PAD, NUM_TRACKS };
-
-// A-natural minor scale, per voice type — MIDI base notes
-// stepNotes[track][step] = 0..6 → index into these arrays
-static constexpr std::array<int, 7> kBassBaseMidi = { 33, 35, 36, 38, 40, 41, 43 }; // A1 to G2
-static constexpr std::array<int, 7> kLeadBaseMidi = { 57, 59, 60, 62, 64, 65, 67 }; // A3 to G4
-static constexpr std::array<int, 7> kPadBaseMidi  = { 45, 47, 48, 50, 52, 53, 55 }; // A2 to G3
-
-static const char* kNoteNames[] = { "A", "B", "C", "D", "E", "F", "G" };
+// Console targets (obstacle_render) build the processor without its editor
+#ifndef OBSTACLE_HEADLESS
+ #define OBSTACLE_HEADLESS 0
+#endif
 
-inline float midiToFreq(int midi) {
-    return 440.f * std::pow(2.f, (midi - 69) / 12.f);
-}
+static constexpr int NUM_PARAMS = PID_TRACK_BASE + MAX_TRACKS * NUM_TRACK_PARAMS;
+static_assert(NUM_PARAMS <= ParamRegistry::kMaxParams, "raise ParamRegistry::kMaxParams");
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  Song Mode structures
-// ─────────────────────────────────────────────────────────────────────────────
-static constexpr int NUM_PATTERNS   = 8;
-static constexpr int NUM_SONG_SLOTS = 16;
-
-struct Pattern {
-    std::array<std::array<bool, 16>, NUM_TRACKS> steps;
-    std::array<std::array<int,  16>, NUM_TRACKS> stepNotes;
-    Pattern() {
-        for (auto& r : steps)     r.fill(false);
-        for (auto& r : stepNotes) r.fill(0);
-    }
-};
-
-struct SongSlot {
-    int patternIndex = 0;  // 0-7 (A-H)
-    int repeatCount  = 1;  // 1-8 loops before advancing
-};
-
-// ─────────────────────────────────────────────────────────────────────────────
-class ObstacleProcessor  : public juce::AudioProcessor
+class ObstacleProcessor  : public juce::AudioProcessor,
+                           private juce::Timer
 {
 public:
     ObstacleProcessor();
-    ~ObstacleProcessor() override = default;
+    ~ObstacleProcessor() override { stopTimer(); }
 
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override {}
+    void releaseResources() override { renderPool.stop(); fxPipeline.release(); }
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    bool isBusesLayoutSupported (const BusesLayout&) const override;
 
     juce::AudioProcessorEditor* createEditor() override;
-    bool hasEditor() const override { return true; }
+    bool hasEditor() const override { return ! OBSTACLE_HEADLESS; }
 
     const juce::String getName() const override { return "OBSTACLE"; }
-    bool acceptsMidi()  const override { return false; }
+    bool acceptsMidi()  const override { return true; }
     bool producesMidi() const override { return true; }
     bool isMidiEffect() const override { return false; }
     double getTailLengthSeconds() const override { return 4.0; }
@@ -69,9 +57,11 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     // ── Patterns & Song Chain ─────────────────────────────────────────────────
-    std::array<Pattern, NUM_PATTERNS>    patterns;            // A-H
+    //  Patterns are read through patterns[i] and written through
+    //  patterns.edit(i), which unshares copy-on-write storage first.
+    PatternBank                          patterns;            // 16 banks of A-H
     std::array<SongSlot, NUM_SONG_SLOTS> songChain;
-    int                                  songChainLength = 1; // 1-16 active slots
+    int                                  songChainLength = 1; // 1-NUM_SONG_SLOTS active slots
     bool                                 songLoopMode    = true;
 
     std::atomic<int>  editPatternIdx  { 0 };  // pattern shown in editor
@@ -79,21 +69,128 @@ public:
     std::atomic<int>  playSongSlot    { 0 };  // current slot in chain
     std::atomic<bool> nextRequested   { false }; // force-advance on next step 0
 
+    // Recompile + publish pattern `patIdx` after an edit (message thread)
+    void patternEdited(int patIdx);
+
+    // Pattern dst becomes a shared copy of src (message thread)
+    void copyPattern(int dst, int src);
+
+    // ── Track layout (message thread) ─────────────────────────────────────────
+    //  Tracks beyond the layout keep their parameters but are never played.
+    TrackLayout layout;
+
+    int  addTrack(int voiceType);             // new track index, or -1 when full
+    void removeLastTrack();
+    void setTrackVoice(int track, int voiceType);   // also resets its MIDI input map
+
+    // MIDI input map: the note the track plays on (-1 = any) and the channel
+    // it listens to (1-16, 0 = any); see TrackLayout
+    void setTrackMidiIn(int track, int note, int channel);
+
+    // ── Per-track outputs (message thread) ────────────────────────────────────
+    //  Bus 0 is the main mix; bus t+1 belongs to track t. A track routed to
+    //  its bus leaves the main mix: PRE = dry, POST = through its own copy of
+    //  the master FX chain. Routing applies once the host enables the bus.
+    enum TrackOutput : uint8_t { OUT_MAIN = 0, OUT_AUX_PRE, OUT_AUX_POST, NUM_TRACK_OUTPUTS };
+
+    void setTrackOutput(int track, int mode);
+    int  getTrackOutput(int track) const { return trackOutput[(size_t)track].load(); }
+    bool isAuxBusEnabled(int track) const;
+
+    // ── Sample tracks (message thread) ────────────────────────────────────────
+    //  A SAMPLE track plays the file set here (an empty File: none); the path
+    //  is saved with the session even while the file cannot be found.
+    juce::String setTrackSample(int track, const juce::File& file);   // why it failed, or empty
+    const juce::File& getTrackSample(int track) const { return samples.getFile(track); }
+    std::shared_ptr<const SampleSource> getTrackSampleSource(int track) const { return samples.getSource(track); }
+    const juce::String& getTrackSampleError(int track) const { return sampleErrors[(size_t)track]; }
+
+    // Rebuild the song timeline from `fromSlot` after a chain edit and record
+    // it for undo (message thread). Pattern edits record themselves and only
+    // rebuild the timeline when the pattern's length changed.
+    void songChainEdited(int fromSlot = 0);
+
+    // ── Undo / redo (message thread) ──────────────────────────────────────────
+    //  Patterns and song chain; false when there is nothing to undo / redo.
+    //  The first pattern that changed becomes the edit pattern.
+    bool undo();
+    bool redo();
+    bool canUndo() const { return history.canUndo(); }
+    bool canRedo() const { return history.canRedo(); }
+
+    // ── Library (message thread) ──────────────────────────────────────────────
+    //  A pattern entry loads into the edit pattern, a kit brings its sounds
+    //  (layout, outputs, mix and FX parameters). While playing, a load waits
+    //  for the next loop boundary of the playing pattern.
+    PatternLibrary library { PatternLibrary::defaultFile() };
+
+    void saveToLibrary(PatternLibrary::Kind kind, const juce::String& name,
+                       PatternLibrary::AddedCallback done);   // new index or -1, on the library thread
+    bool loadFromLibrary(int index);
+    int  getCuedLibraryEntry() const { return cueEntry != nullptr ? cueLibraryIndex : -1; }
+
     // ── Sequencer state ───────────────────────────────────────────────────────
-    std::atomic<int>   currentStep { -1 };
+    std::atomic<int>   currentStep { -1 };  // steps since the slot started (track step = % length)
     std::atomic<float> bpm { 128.f };
     std::atomic<bool>  playing { false };
 
     // Randomize the current edit pattern (called from editor Rand button)
     void randomizePattern();
 
+    // Host-sync instrumentation (drift, relocations)
+    const SeqClock& getClock() const { return clock; }
+
+    // ── Multi-core rendering ──────────────────────────────────────────────────
+    //  Voices render on the worker pool when enabled; small chunks stay serial.
+    //  The pool's threads only exist while it is enabled (message thread).
+    void setMultiCore(bool on);
+    bool getMultiCore() const { return multiCore.load(); }
+    int  getNumRenderThreads() const { return renderPool.getNumParticipants(); }
+
+    // FX on its own thread, one block behind the voices (adds one block of latency)
+    void setPipelineMode(bool on);
+    bool getPipelineMode() const { return pipelineMode.load(); }
+
+    // ── Disk recorder (Standalone) ────────────────────────────────────────────
+    //  The main output, as heard, to a new file in DiskRecorder::defaultDirectory()
+    //  named after the date and time. Returns the file, or an empty File if it
+    //  could not be created (message thread).
+    DiskRecorder recorder;
+
+    juce::File startRecording(bool flac);
+    void       stopRecording() { recorder.stop(); }
+
+    // ── Offline rendering (message thread, while processBlock is not running) ──
+    //  Without a host the song plays from sample 0 on the free-running clock.
+    //  startSongAt() begins later, as if it had played up to there: the song
+    //  position and the clock are set, the sound is not (warm it up with a
+    //  pre-roll). getHeldNotesStart() is where a pre-roll must reach back to
+    //  for the notes that hold across a slot start. A snapshot is the whole engine: voices, FX chains, clock,
+    //  song position, pending hits and held locks; restoring one continues
+    //  the render sample for sample. Not while the FX pipeline is on.
+    struct EngineState;
+
+    void    startSongAt(int64_t sample);
+    int64_t getSlotStartSample(int slot) const;   // songChainLength: the end of the song
+    int64_t getHeldNotesStart(int slot) const;    // earliest hit still sounding when `slot` starts
+    void    saveEngine(EngineState& state) const;
+    void    restoreEngine(const EngineState& state);
+
+    // Dry master: the main output skips the shared FX chain (delay, reverb,
+    // filter, drive, compressor) and carries the direct bus alone, which the
+    // dry stems add up to. A reference for checking them; not while the FX
+    // pipeline is on.
+    void setDryMaster(bool on) { dryMaster = on; }
+
     // ── Parameters ────────────────────────────────────────────────────────────
     juce::AudioParameterFloat* bpmParam    = nullptr;
 
-    // Per-track
-    juce::AudioParameterFloat* trackVolParam  [NUM_TRACKS] = {};
-    juce::AudioParameterBool*  trackMuteParam [NUM_TRACKS] = {};
-    juce::AudioParameterFloat* trackDecParam  [NUM_TRACKS] = {}; // decay / env / filter
+    // Per-track (all MAX_TRACKS exist so the host parameter list never changes)
+    juce::AudioParameterFloat* trackVolParam  [MAX_TRACKS] = {};
+    juce::AudioParameterBool*  trackMuteParam [MAX_TRACKS] = {};
+    juce::AudioParameterFloat* trackDecParam  [MAX_TRACKS] = {}; // tone: decay / env / filter
+    juce::AudioParameterFloat* trackDlySendParam [MAX_TRACKS] = {}; // send into the shared delay
+    juce::AudioParameterFloat* trackRevSendParam [MAX_TRACKS] = {}; // send into the shared reverb
 
     // Global mix + FX
     juce::AudioParameterFloat* masterVolParam = nullptr;
@@ -105,37 +202,282 @@ public:
     juce::AudioParameterFloat* driveParam     = nullptr;
     juce::AudioParameterInt*   keyParam       = nullptr; // semitone transpose -12..12
 
+    // Dense-ID view of all parameters above (host + UI bridge + audio events)
+    ParamRegistry params;
+
 private:
     float sr = 44100.f;
 
-    KickVoice  kick;
-    SnareVoice snare;
-    HihatVoice hihat;
-    BassVoice  bass;
-    LeadVoice  lead;
-    PadVoice   pad;
+    void renderBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi);
+
+    VoiceEngine voices;
+    std::vector<float> mixBuffer;   // voice sum before FX, one chunk of a block
+
+    // Parallel voice rendering: one job per sounding voice, one mix buffer per
+    // participant (audio thread + helpers), summed before the FX chain
+    static constexpr int kMinParallelSamples      = 32;
+    static constexpr int kMinParallelVoiceSamples = 4096;   // below this dispatch costs more than it saves
+    static constexpr int kMaxRenderJobs           = NUM_VOICE_TYPES * kVoicesPerBank;
+
+    RenderPool renderPool;
+    std::vector<float> workerMix;   // kMaxParticipants × mixBuffer.size()
+    std::array<VoiceEngine::VoiceRef, kMaxRenderJobs> renderJobs {};
+    std::array<uint8_t, kMaxRenderJobs>               renderAlive {};
+    int renderLength = 0;
 
     FXChain fx;
 
-    double samplesPerStep = 0.0;
-    double sampleCounter  = 0.0;
-    int    seqStep        = 0;
+    // While a block is pipelined the worker owns `fx`: FX changes are queued
+    // and the voices render into the pipeline's dry buffer
+    FxPipeline        fxPipeline;
+    std::atomic<bool> pipelineMode { false };
+    std::atomic<bool> multiCore    { false };   // set after the pool has started, cleared before it stops
+    int               preparedBlockSize = 0;
+    bool              fxDeferred = false;
+    float*            dryOut     = nullptr;
+    bool              dryMaster  = false;   // offline reference: no FX on the main out
+
+    SeqClock clock;
 
     // Song chain tracking (audio thread only)
-    int  loopCount = 0;
+    int  loopCount   = 0;
+    int  patStep     = 0;      // step inside the playing pattern
+    int64_t slotStep = 0;      // steps since the slot started — track step = slotStep % length
+    bool outsideSong = false;  // host is before the song / past its end (loop off)
 
     juce::Random rng;
 
-    bool wasHostPlaying      = false;
+    // ── Compiled trigger lists ────────────────────────────────────────────────
+    //  Built on the message thread, published with one atomic store. The audio
+    //  thread only dereferences them inside an AudioEpoch scope; replaced lists
+    //  are freed by the timer once that block has finished. Patterns sharing
+    //  storage share one compiled list; compiledFrom/compiledGen identify what
+    //  each list was built from, and compileGen bumps on swing/layout changes.
+    std::array<std::atomic<const CompiledPattern*>, NUM_PATTERNS> compiled {};
+    std::array<std::shared_ptr<CompiledPattern>, NUM_PATTERNS>    compiledOwned;
+    std::array<const Pattern*, NUM_PATTERNS>                      compiledFrom {};
+    std::array<uint32_t, NUM_PATTERNS>                            compiledGen {};
+    uint32_t                    compileGen    = 1;
+    float                       compiledSwing = 0.f;
+    RetireList<CompiledPattern, std::shared_ptr<CompiledPattern>> retired;
+    AudioEpoch                  audioEpoch;
+
+    // songChain as prefix-summed steps: host PPQ → (slot, loop, step)
+    SongTimeline<NUM_SONG_SLOTS> songTimeline { audioEpoch };
+
+    // Sample track files; voices pick up a replaced one at the next block
+    SamplePool                  samples { audioEpoch };
+    std::array<juce::String, MAX_TRACKS> sampleErrors;   // why each file did not load
+
+    // ── Library cue ───────────────────────────────────────────────────────────
+    //  The message thread compiles a loaded pattern and arms it: cueArmed is
+    //  odd while cueIndex / cuePattern change and even once they are set. At
+    //  the next loop boundary the audio thread latches the arm count and from
+    //  then on plays cuePattern in place of compiled[cueIndex]; the timer sees
+    //  the latch and commits the entry to the bank, which ends the cue. A kit
+    //  cue has no pattern and is applied by the timer the same way.
+    std::atomic<const CompiledPattern*> cuePattern { nullptr };
+    std::atomic<int>                    cueIndex   { 0 };
+    std::atomic<uint32_t>               cueArmed   { 0 };
+    std::atomic<uint32_t>               cueLatched { 0 };   // written by the audio thread only
+    std::unique_ptr<SessionState>       cueEntry;           // pending entry (message thread)
+    PatternLibrary::Kind                cueKind = PatternLibrary::PatternEntry;
+    int                                 cueLibraryIndex = -1;
+    std::shared_ptr<CompiledPattern>    cueOwned;
+
+    // Hits with a timing offset (swing, groove, nudge, ratchets) wait here
+    // until their sample, with a copy of their lock values (the compiled
+    // list may be retired). Hits are timed in fractional samples: each plays
+    // on the first sample at or after its exact time, `late` past it.
+    struct PendingTrigger
+    {
+        int64_t      sample = 0;   // absolute, clock time
+        float        late   = 0.f;
+        TriggerEvent ev;
+        std::array<float, NUM_SOUND_LOCKS - 1> locks {};
+    };
+    static constexpr int kMaxPending = 256;
+    std::array<PendingTrigger, kMaxPending> pending;
+    int numPending = 0;
+
+    // ── MIDI input (audio thread) ─────────────────────────────────────────────
+    //  Notes from the host or a controller, copied out of the block's buffer
+    //  before it is reused for the output. A note plays every track whose
+    //  MIDI input map takes its note and channel (TrackLayout), at a gain of
+    //  its velocity; melodic voices mapped to any note take its pitch. Lead
+    //  and pad release on their note-off. While the transport is stopped the
+    //  voices and FX keep running for kLiveTailSeconds after the last note
+    //  so they can ring out.
+    struct MidiInEvent
+    {
+        int     sampleOffset = 0;
+        uint8_t channel      = 0;   // 0-15
+        uint8_t note         = 0;
+        uint8_t velocity     = 0;   // 1-127 on, 0 off
+    };
+    static constexpr int    kMaxMidiIn       = 512;   // per block; later events are dropped
+    static constexpr double kLiveTailSeconds = 8.0;
+    std::array<MidiInEvent, kMaxMidiIn> midiIn;
+    int numMidiIn = 0;
+
+    std::array<int8_t, MAX_TRACKS> liveNote {};   // note held from MIDI input, -1 = none
+    int     liveTail  = 0;   // stopped: samples left to render
+    int64_t liveClock = 0;   // stopped: stands in for the clock when seeding noise
+
+    // ── Parameter cache (audio thread, updated only by registry events) ───────
+    static constexpr int kMaxParamEvents = 512;
+    std::array<ParamRegistry::Event, kMaxParamEvents> paramEvents;
+
+    float masterVol = 1.f;
+    int   transpose = 0;
+    std::array<float, 25> transposeRatio {};   // -12..+12 semitones → pitch ratio
+    float trackVol   [MAX_TRACKS] = {};
+    bool  trackMuted [MAX_TRACKS] = {};
+    float trackGains [MAX_TRACKS] = {};
+    float trackTone  [MAX_TRACKS] = {};   // normalised 0-1, mapped per voice type
+    float trackDlySend [MAX_TRACKS] = {};
+    float trackRevSend [MAX_TRACKS] = {};
+    float cutoffBase = 8000.f, driveBase = 1.4f;
+
+    // ── Parameter locks (audio thread) ────────────────────────────────────────
+    //  A trigger's locks override the values above until the track triggers
+    //  again; trackLocked[t] = the LockParam bits track t holds. Rendering
+    //  reads the results: trackGains (volume) and the two send gains.
+    std::array<uint8_t, MAX_TRACKS> trackLocked {};
+    float trackLockValue [MAX_TRACKS][NUM_SOUND_LOCKS] = {};
+    float trackDlyGains  [MAX_TRACKS] = {};
+    float trackRevGains  [MAX_TRACKS] = {};
+    int   cutoffLockTrack = -1, driveLockTrack = -1;   // track holding a global FX lock
+    LockRanges lockRanges;   // lock value → plain value (message thread, compiler)
+
+    // ── Aux outputs ───────────────────────────────────────────────────────────
+    std::array<std::atomic<uint8_t>, MAX_TRACKS>      trackOutput {};
+    std::array<std::unique_ptr<FXChain>, MAX_TRACKS>  auxFx;       // enabled buses only (prepareToPlay)
+    std::array<float*, MAX_TRACKS>  auxOut  {};   // this block: bus channel 0, nullptr = main mix
+    std::array<float*, MAX_TRACKS>  auxOutR {};   // bus channel 1 (filled from channel 0), if any
+    std::array<float*, MAX_TRACKS>  voiceDest {}; // this chunk: where each track's voice renders
+    int  numAuxRouted = 0;
+
+    // ── Send buses ────────────────────────────────────────────────────────────
+    //  Tracks with both sends at unity sum straight into mixBuffer, which feeds
+    //  all three FX inputs. The others render alone into trackScratch and are
+    //  spread over sendBuses (direct, delay, reverb) on top of that.
+    std::vector<float> trackScratch;   // MAX_TRACKS × mixBuffer.size()
+    std::vector<float> sendBuses;      // 3 × mixBuffer.size()
+    std::array<uint8_t, MAX_TRACKS> sendTracks {};
+    int  numSendTracks = 0;
+
+    // Aux buses wait out the FX pipeline latency too (MAX_TRACKS × latency)
+    std::vector<float> auxDelay;
+    int  auxDelayPos   = 0;
+    bool auxDelayDirty = false;
+
+    // ── Track layout as seen by the audio thread ─────────────────────────────
+    std::array<std::atomic<uint8_t>, MAX_TRACKS> sharedVoice {};
+    std::array<std::atomic<int8_t>, MAX_TRACKS>  sharedMidiInNote {};
+    std::array<std::atomic<uint8_t>, MAX_TRACKS> sharedMidiInChannel {};
+    std::atomic<int>                             sharedNumTracks { DEFAULT_NUM_TRACKS };
+    std::array<int8_t, MAX_TRACKS>               trackVoice {};   // -1 = track not in use
+
     bool wasPreviouslyPlaying = false;
 
-    int midiActiveNote[NUM_TRACKS]; // -1 = no active note
+    int midiActiveNote[MAX_TRACKS]; // -1 = no active note
+
+    EditHistory history;
+
+    // Crash recovery: the state after each edit goes to the journal (message
+    // thread, from the timer); the journal thread diffs and writes it.
+    // Headless builds keep theirs apart: a render must neither replay nor
+    // remove the journal of a session that is open (or crashed) elsewhere.
+    EditJournal journal { OBSTACLE_HEADLESS ? juce::File::getSpecialLocation (juce::File::tempDirectory)
+                                                  .getChildFile ("OBSTACLE-render-journal")
+                                            : EditJournal::defaultDirectory() };
+    std::shared_ptr<const SessionState> journaled;   // last state handed over
+
+    // Last saved state, returned as-is while nothing has changed
+    std::unique_ptr<SessionState> savedSession;
+    juce::MemoryBlock             savedState;
+
+    SessionState captureSession() const;
+    void applySession(const SessionState& st);
+    void applyKit(const SessionState& st);
+    void applyTrackSample(int track, const juce::String& path);
+    void applyVersion(const EditHistory::Version& from, const EditHistory::Version& to);
+    void commitCue();
+    void cancelCue();
+    void journalEdits();
+    void readLegacyState(const void* data, int sizeInBytes);
+    void stateLoaded();
 
     void buildDefaultPattern(int patIdx = 0);
-    void triggerStep(int step, juce::MidiBuffer& midi, int samplePos, int patIdx);
+    void compileAndPublish(int patIdx);
+    void compileAll();
+    void patternLengthsEdited(int patIdx);
+    int  firstResizedSlot(int patIdx) const;
+    void rebuildTimeline(int fromSlot);
+    void publishLayout();
+    void resetTrack(int track);
+    void syncTrackLayout(juce::MidiBuffer& midi);
+    void applyTone(int track);
+    void updateTrackGains(int track);
+    void applyLocks(int track, uint8_t mask, const float* values, int samplePos);
+    void applyFxLock(int track, int param, bool locked, int samplePos);
+    void releaseLocks(int samplePos);
+    void timerCallback() override;
+    void triggerStep(int64_t slotStep, juce::MidiBuffer& midi, int samplePos, float late,
+                     const CompiledPattern& cp);
+    void fireTrigger(const TriggerEvent& e, const float* locks, juce::MidiBuffer& midi, int samplePos,
+                     float late);
+    int  firePending(juce::MidiBuffer& midi, int upTo);
+    void collectMidiInput(const juce::MidiBuffer& midi, int numSamples);
+    void playMidiInput(const MidiInEvent& m, int64_t when);
     void nextSongSlot();
-    void updateStepTiming();
+    const CompiledPattern* playingPattern(int patIdx) const;
+    void setTempo(double newBpm, int offset);
+    void applyParam(int id, float value, int offset);
+    void fxControl(FxPipeline::Control c, float value, int offset);
+    void renderRange(float* outL, float* outR, int start, int end,
+                     juce::MidiBuffer& midi, int& curPatIdx);
+    void renderVoices(float* outL, float* outR, int start, int end);
+    void renderVoicesParallel(float* mix, int n, int numJobs);
+    void routeTrackOutputs(juce::AudioBuffer<float>& buffer);
+    void finishAuxOutputs(int numSamples);
+    void renderJob(int job, int participant);
+    void advanceSequencer(SeqClock::Tick tick, juce::MidiBuffer& midi, int samplePos, int& curPatIdx);
+    void seekSong(int64_t absStep, int& curPatIdx);
     void sendAllNotesOff(juce::MidiBuffer& midi, int samplePos);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ObstacleProcessor)
 };
+
+// Everything the audio thread carries from one block to the next, bar the
+// parameter values themselves (see saveEngine / restoreEngine)
+struct ObstacleProcessor::EngineState
+{
+    VoiceEngine                                      voices;
+    FXChain                                          fx;
+    std::array<std::unique_ptr<FXChain>, MAX_TRACKS> auxFx;
+    std::vector<float>                               auxDelay;
+    int                                              auxDelayPos   = 0;
+    bool                                             auxDelayDirty = false;
+
+    SeqClock clock;
+    int      loopCount = 0, patStep = 0, playSongSlot = 0, playPatternIdx = 0;
+    int64_t  slotStep    = 0;
+    bool     outsideSong = false, wasPlaying = false;
+
+    std::array<PendingTrigger, kMaxPending> pending;
+    int numPending = 0;
+
+    std::array<uint8_t, MAX_TRACKS> trackLocked {};
+    float trackLockValue [MAX_TRACKS][NUM_SOUND_LOCKS] = {};
+    float trackGains     [MAX_TRACKS] = {};
+    float trackDlyGains  [MAX_TRACKS] = {};
+    float trackRevGains  [MAX_TRACKS] = {};
+    int   cutoffLockTrack = -1, driveLockTrack = -1;
+    std::array<int8_t, MAX_TRACKS> trackVoice {};
+    int   midiActiveNote [MAX_TRACKS] = {};
+    std::array<int8_t, MAX_TRACKS> liveNote {};
+    int     liveTail  = 0;
+    int64_t liveClock = 0;
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "LockFree.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — realtime worker pool for parallel voice rendering
+// ─────────────────────────────────────────────────────────────────────────────
+//  The audio thread is participant 0 and always works; up to kMaxWorkers
+//  helper threads join it. run() splits jobs [0, n) into one contiguous range
+//  per participant. Each participant drains its own range, then steals from
+//  the others. Claiming a job is one CAS on that range's cursor, so dispatch
+//  never locks or allocates.
+//
+//  Every cursor carries the run's generation. A helper that wakes late finds
+//  stale cursors and does nothing. The audio thread never waits for a helper
+//  to wake, because it simply steals that helper's range. It only waits for
+//  jobs that have already been claimed. A sleeping helper is woken through a
+//  WakeSignal, which takes no lock, so run() stays lock-free.
+class RenderPool
+{
+public:
+    static constexpr int kMaxWorkers      = 7;                // helpers
+    static constexpr int kMaxParticipants = kMaxWorkers + 1;  // + audio thread
+    static constexpr int kMaxJobs         = 0xFFFF;
+
+    // job in [0, numJobs); participant in [0, getNumParticipants())
+    using JobFn = void (*) (void* ctx, int job, int participant);
+
+    RenderPool() = default;
+    ~RenderPool() { stop(); }
+
+    // ── Message thread, only while the audio thread cannot call run() ───────
+    void start (int numWorkers, int blockSize, double sampleRate)
+    {
+        stop();
+        numWorkers = juce::jlimit (0, kMaxWorkers, numWorkers);
+
+        const auto options = juce::Thread::RealtimeOptions{}
+                                 .withPriority (9)
+                                 .withApproximateAudioProcessingTime (juce::jmax (1, blockSize), sampleRate);
+
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            auto w = std::make_unique<Worker> (*this, i + 1);
+            if (! w->startRealtimeThread (options) && ! w->startThread (juce::Thread::Priority::highest))
+                break;
+            workers[(size_t)i] = std::move (w);
+            numParticipants.store (i + 2);
+        }
+    }
+
+    void stop()
+    {
+        for (auto& w : workers)
+        {
+            if (w != nullptr)
+            {
+                w->signalThreadShouldExit();
+                w->wake.post();
+            }
+        }
+
+        for (auto& w : workers)
+        {
+            if (w != nullptr)
+                w->stopThread (1000);
+            w.reset();
+        }
+
+        numParticipants.store (1);
+    }
+
+    int getNumParticipants() const { return numParticipants.load (std::memory_order_relaxed); }
+
+    // ── Audio thread: returns once every job has run ────────────────────────
+    void run (JobFn fn, void* ctx, int numJobs)
+    {
+        numJobs = juce::jmin (numJobs, kMaxJobs);
+        if (numJobs <= 0) return;
+
+        const int np = getNumParticipants();
+        if (np == 1)
+        {
+            for (int j = 0; j < numJobs; ++j)
+                fn (ctx, j, 0);
+            return;
+        }
+
+        job    = fn;
+        jobCtx = ctx;
+        remaining.store (numJobs, std::memory_order_relaxed);
+
+        const uint32_t gen = generation.load (std::memory_order_relaxed) + 1;
+        for (int p = 0; p < np; ++p)
+        {
+            const uint64_t begin = (uint64_t)(numJobs * p / np);
+            const uint64_t end   = (uint64_t)(numJobs * (p + 1) / np);
+            cursors[(size_t)p].value.store (((uint64_t)gen << 32) | (end << 16) | begin,
+                                            std::memory_order_release);
+        }
+        generation.store (gen, std::memory_order_seq_cst);
+
+        for (int i = 0; i < np - 1; ++i)
+            if (workers[(size_t)i]->asleep.exchange (false, std::memory_order_seq_cst))
+                workers[(size_t)i]->wake.post();   // once per sleep
+
+        work (0, gen);
+
+        while (remaining.load (std::memory_order_acquire) > 0)
+            std::this_thread::yield();
+    }
+
+private:
+    struct Worker : juce::Thread
+    {
+        Worker (RenderPool& p, int index)
+            : juce::Thread ("OBSTACLE render " + juce::String (index)), pool (p), participant (index) {}
+
+        void run() override
+        {
+            using Clock = std::chrono::steady_clock;
+            uint32_t seen = pool.generation.load();
+            auto idleSince = Clock::now();
+
+            while (! threadShouldExit())
+            {
+                const uint32_t gen = pool.generation.load (std::memory_order_acquire);
+                if (gen != seen)
+                {
+                    seen = gen;
+                    pool.work (participant, gen);
+                    idleSince = Clock::now();
+                }
+                else if (Clock::now() - idleSince < std::chrono::microseconds (kSpinMicros))
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    // Sleep until the next run() (or exit). The flag is set before
+                    // re-checking, so a run() published in between always posts.
+                    asleep.store (true, std::memory_order_seq_cst);
+                    if (pool.generation.load (std::memory_order_seq_cst) == seen)
+                        wake.wait (100);
+                    asleep.store (false, std::memory_order_relaxed);
+                    idleSince = Clock::now();
+                }
+            }
+        }
+
+        RenderPool&       pool;
+        const int         participant;
+        std::atomic<bool> asleep { false };
+        WakeSignal        wake;
+    };
+
+    // Helpers spin this long after a run before sleeping, so that the splits
+    // of one block find them awake
+    static constexpr int kSpinMicros = 300;
+
+    void work (int participant, uint32_t gen)
+    {
+        const int np = getNumParticipants();
+        for (int k = 0; k < np; ++k)
+        {
+            auto& cursor = cursors[(size_t)((participant + k) % np)].value;
+            uint64_t c = cursor.load (std::memory_order_acquire);
+
+            for (;;)
+            {
+                const int next = (int)(c & 0xFFFF);
+                const int end  = (int)((c >> 16) & 0xFFFF);
+                if ((uint32_t)(c >> 32) != gen || next >= end)
+                    break;
+
+                if (cursor.compare_exchange_weak (c, c + 1, std::memory_order_acq_rel,
+                                                  std::memory_order_acquire))
+                {
+                    job (jobCtx, next, participant);
+                    remaining.fetch_sub (1, std::memory_order_release);
+                    c = cursor.load (std::memory_order_acquire);
+                }
+            }
+        }
+    }
+
+    struct alignas (64) Cursor
+    {
+        std::atomic<uint64_t> value { 0 };   // generation:32 | end:16 | next:16
+    };
+
+    std::array<Cursor, kMaxParticipants>                 cursors;
+    std::array<std::unique_ptr<Worker>, kMaxWorkers>     workers;
+    std::atomic<int>                                     numParticipants { 1 };
+
+    JobFn job    = nullptr;
+    void* jobCtx = nullptr;
+    alignas (64) std::atomic<uint32_t> generation { 0 };
+    alignas (64) std::atomic<int>      remaining  { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (RenderPool)
+};
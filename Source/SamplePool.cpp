@@ -0,0 +1,220 @@
+#include "SamplePool.h"
+#include <cstdint>
+#include <utility>
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <sys/mman.h>
+#endif
+
+namespace
+{
+    // Keep whole pages in RAM. Refused past RLIMIT_MEMLOCK on POSIX and past
+    // the working set's minimum on Windows, in which case they are re-touched.
+    bool lockPages (const void* p, size_t bytes)
+    {
+       #if JUCE_WINDOWS
+        return VirtualLock (const_cast<void*> (p), bytes) != 0;
+       #else
+        return mlock (p, bytes) == 0;
+       #endif
+    }
+
+    void unlockPages (const void* p, size_t bytes)
+    {
+       #if JUCE_WINDOWS
+        VirtualUnlock (const_cast<void*> (p), bytes);
+       #else
+        munlock (p, bytes);
+       #endif
+    }
+}
+
+SampleSource::~SampleSource()
+{
+    if (pinned)
+        unlockPages (head, headBytes);
+}
+
+SamplePool::SamplePool (const AudioEpoch& e)
+    : juce::Thread ("OBSTACLE samples"), epoch (e)
+{
+    formats.registerBasicFormats();
+    for (auto& c : cursors)
+        c.store (-1);
+    startThread (juce::Thread::Priority::high);
+}
+
+SamplePool::~SamplePool()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (2000);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Message thread
+// ─────────────────────────────────────────────────────────────────────────────
+juce::String SamplePool::assign (int track, const juce::File& file)
+{
+    if (!juce::isPositiveAndBelow (track, MAX_TRACKS))
+        return {};
+    if (file == files[(size_t)track] && (owned[(size_t)track] != nullptr || file == juce::File()))
+        return {};   // a missing file is looked for again
+
+    files[(size_t)track] = file;
+    juce::String error;
+    auto source = file == juce::File() ? nullptr : load (file, error);
+
+    published[(size_t)track].store (source.get(), std::memory_order_release);
+    std::shared_ptr<const SampleSource> old;
+    {
+        const juce::ScopedLock sl (lock);
+        old = std::exchange (owned[(size_t)track], std::move (source));
+    }
+    retired.retire (std::move (old), epoch);
+    notify();   // the prefetch thread sleeps while no track has a file
+    return error;
+}
+
+std::shared_ptr<const SampleSource> SamplePool::load (const juce::File& file, juce::String& error)
+{
+    // A file another track plays already is shared, not mapped again
+    juce::int64 residentBytes = 0;
+    for (const auto& s : owned)
+        if (s != nullptr)
+        {
+            if (s->file == file)
+                return s;
+            if (s->resident)
+                residentBytes += (juce::int64)s->headBytes;
+        }
+
+    if (!file.existsAsFile())
+    {
+        error = "not found";
+        return nullptr;
+    }
+
+    auto* format = formats.findFormatForFileExtension (file.getFileExtension());
+    auto  s      = std::make_shared<SampleSource>();
+    s->reader.reset (format != nullptr ? format->createMemoryMappedReader (file) : nullptr);
+    if (s->reader == nullptr)
+    {
+        error = "only uncompressed WAV and AIFF files can be played";
+        return nullptr;
+    }
+    if (s->reader->numChannels < 1 || s->reader->numChannels > 2 || !s->reader->mapEntireFile())
+    {
+        error = s->reader->numChannels > 2 ? "only mono and stereo files can be played" : "cannot map the file";
+        return nullptr;
+    }
+
+    s->file          = file;
+    s->sampleRate    = s->reader->sampleRate;
+    s->length        = s->reader->lengthInSamples;
+    s->numChannels   = (int)s->reader->numChannels;
+    s->bytesPerFrame = juce::jmax (1, s->numChannels * (int)s->reader->bitsPerSample / 8);
+
+    const auto bytes = s->length * (juce::int64)sizeof (float);
+    s->resident   = s->length <= (juce::int64)(kResidentSeconds * s->sampleRate)
+                 && residentBytes + bytes <= kResidentBudgetBytes;
+    s->headFrames = s->resident ? s->length : juce::jmin (s->length, (juce::int64)(kHeadSeconds * s->sampleRate));
+
+    // The head on whole pages of its own: locking them pins nothing else
+    const size_t page       = (size_t)juce::jmax (1, juce::SystemStats::getPageSize());
+    const size_t pageFloats = juce::jmax ((size_t)1, page / sizeof (float));
+    const size_t numFloats  = ((size_t)s->headFrames + pageFloats - 1) / pageFloats * pageFloats;
+    s->headStorage.assign (numFloats + pageFloats, 0.f);
+    const auto at = (reinterpret_cast<uintptr_t> (s->headStorage.data()) + page - 1) & ~(uintptr_t)(page - 1);
+    auto* head    = reinterpret_cast<float*> (at);
+    for (juce::int64 i = 0; i < s->headFrames; ++i)
+        head[i] = s->mapped (i);
+
+    s->head      = head;
+    s->headBytes = numFloats * sizeof (float);
+    s->pinned    = s->headBytes > 0 && lockPages (head, s->headBytes);
+    return s;
+}
+
+// Reads one sample per page of [from, to) so the system pages it in
+void SamplePool::touch (const SampleSource& s, juce::int64 from, juce::int64 to)
+{
+    const auto framesPerPage = juce::jmax ((juce::int64)1, (juce::int64)juce::SystemStats::getPageSize() / s.bytesPerFrame);
+    to = juce::jmin (to, s.length);
+    for (auto i = juce::jmax ((juce::int64)0, from); i < to; i += framesPerPage)
+        s.reader->touchSample (i);
+    if (to > from)
+        s.reader->touchSample (to - 1);
+}
+
+// Reads one sample per page of a head that could not be locked
+void SamplePool::touchHead (const SampleSource& s)
+{
+    const size_t pageFloats = juce::jmax ((size_t)1, (size_t)juce::SystemStats::getPageSize() / sizeof (float));
+    volatile float sink = 0.f;
+    for (size_t i = 0; i < (size_t)s.headFrames; i += pageFloats)
+        sink = sink + s.head[i];
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Prefetch thread
+// ─────────────────────────────────────────────────────────────────────────────
+void SamplePool::run()
+{
+    std::array<std::shared_ptr<const SampleSource>, MAX_TRACKS> sources;
+    std::array<const SampleSource*, MAX_TRACKS> seen {};
+    std::array<juce::int64, MAX_TRACKS> fetchedTo {};   // pages read up to here
+    std::array<juce::int64, MAX_TRACKS> lastCursor {};
+    auto lastRetouch = juce::Time::getMillisecondCounter();
+
+    while (!threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl (lock);
+            sources = owned;
+        }
+
+        const bool retouch = juce::Time::getMillisecondCounter() - lastRetouch >= (juce::uint32)kRetouchIntervalMs;
+        if (retouch)
+            lastRetouch = juce::Time::getMillisecondCounter();
+
+        bool streaming = false, unpinned = false;
+        for (size_t t = 0; t < sources.size(); ++t)
+        {
+            const auto* s = sources[t].get();
+            if (s == nullptr)
+                continue;
+            streaming = streaming || !s->resident;
+            unpinned  = unpinned || !s->pinned;
+
+            if (retouch && !s->pinned)
+                touchHead (*s);
+
+            // A new source, or a new trigger (back to the start): the head
+            // covers it while the window catches up
+            const auto cursor = cursors[t].load (std::memory_order_relaxed);
+            if (s != seen[t] || cursor < lastCursor[t])
+                fetchedTo[t] = s->headFrames;
+            seen[t]       = s;
+            lastCursor[t] = cursor;
+
+            if (s->resident || cursor < 0)
+                continue;
+
+            const auto ahead = cursor + (juce::int64)(kPrefetchSeconds * s->sampleRate);
+            if (ahead > fetchedTo[t])
+            {
+                touch (*s, juce::jmax (fetchedTo[t], cursor), ahead);
+                fetchedTo[t] = ahead;
+            }
+        }
+
+        // assign() wakes the thread early
+        wait (streaming ? kPrefetchIntervalMs : unpinned ? kRetouchIntervalMs : -1);
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "LockFree.h"
+#include "Pattern.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SampleSource — one audio file (WAV / AIFF), memory-mapped
+//  The head (all of a resident file) is copied out of the mapping once, as
+//  mono floats, into whole pages of its own that are locked in memory where
+//  the system allows it, so a trigger never waits on a page fault. The rest
+//  is read in place from the mapping, behind the prefetch thread. Immutable
+//  once loaded, so any thread may read it.
+// ─────────────────────────────────────────────────────────────────────────────
+struct SampleSource
+{
+    ~SampleSource();
+
+    juce::File                                           file;
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader;
+    double      sampleRate    = 44100.0;
+    juce::int64 length        = 0;       // frames
+    int         numChannels   = 1;       // 1 or 2
+    int         bytesPerFrame = 2;
+    bool        resident      = false;   // all of it kept in memory, else streamed
+    juce::int64 headFrames    = 0;       // kept in memory from the start (all if resident)
+
+    std::vector<float> headStorage;      // the head's pages, and one to align them
+    const float* head      = nullptr;    // headFrames mono frames, page aligned
+    size_t       headBytes = 0;          // whole pages
+    bool         pinned    = false;      // head locked in memory; else re-touched now and then
+
+    // Frame i as mono; silence past the end (audio thread)
+    float mono (juce::int64 i) const noexcept
+    {
+        if (i < 0 || i >= length) return 0.f;
+        if (i < headFrames) return head[i];
+        return mapped (i);
+    }
+
+    // Frame i as mono, from the mapping
+    float mapped (juce::int64 i) const noexcept
+    {
+        float frame[2];
+        reader->getSample (i, frame);
+        return numChannels == 1 ? frame[0] : 0.5f * (frame[0] + frame[1]);
+    }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SamplePool — the file each sample track plays, and the pages under it
+//
+//  Files shorter than kResidentSeconds are copied into memory whole while
+//  their heads fit in kResidentBudgetBytes; longer ones keep only a head of
+//  kHeadSeconds in memory. Their pages are read just ahead of the play
+//  position by the prefetch thread, which follows the position each track
+//  reports after every block and stays kPrefetchSeconds ahead of it. Heads
+//  the system would not lock (a lock limit, a small working set) are
+//  re-touched by the thread now and then instead, in case they were paged
+//  out. The thread sleeps until a track has a file, and wakes only to
+//  re-touch while nothing streams. What stays in memory is bounded by the
+//  budget, one head per track and one prefetch window per sounding track,
+//  however long the files are; pages already played are clean file pages
+//  the system reclaims at will.
+//
+//  The audio thread reads each track's source through an atomic pointer; a
+//  replaced source is freed once no block that could see it is running.
+// ─────────────────────────────────────────────────────────────────────────────
+class SamplePool : private juce::Thread
+{
+public:
+    static constexpr double      kResidentSeconds     = 8.0;
+    static constexpr juce::int64 kResidentBudgetBytes = 64ll << 20;
+    static constexpr double      kHeadSeconds         = 0.5;
+    static constexpr double      kPrefetchSeconds     = 2.0;
+
+    explicit SamplePool (const AudioEpoch& epoch);
+    ~SamplePool() override;
+
+    // ── Message thread ──────────────────────────────────────────────────────
+    // Play `file` on track t (an empty File: none). The path is kept even if
+    // the file cannot be loaded, so a session on another machine keeps it;
+    // returns why it could not be, or an empty string.
+    juce::String assign (int track, const juce::File& file);
+
+    const juce::File& getFile (int track) const { return files[(size_t)track]; }
+    std::shared_ptr<const SampleSource> getSource (int track) const { return owned[(size_t)track]; }
+
+    // Frees sources the audio thread can no longer see (from the timer)
+    void collectGarbage() { retired.collect (epoch); }
+
+    // ── Audio thread ────────────────────────────────────────────────────────
+    const SampleSource* get (int track) const noexcept { return published[(size_t)track].load (std::memory_order_acquire); }
+
+    // Where track t is playing its source, in frames (-1: silent), after a block
+    void setCursor (int track, juce::int64 frame) noexcept { cursors[(size_t)track].store (frame, std::memory_order_relaxed); }
+
+private:
+    static constexpr int kPrefetchIntervalMs = 10;
+    static constexpr int kRetouchIntervalMs  = 1000;
+
+    std::shared_ptr<const SampleSource> load (const juce::File& file, juce::String& error);
+    static void touch (const SampleSource& s, juce::int64 from, juce::int64 to);
+    static void touchHead (const SampleSource& s);
+
+    void run() override;
+
+    const AudioEpoch& epoch;
+    juce::AudioFormatManager formats;
+
+    // Message thread
+    std::array<juce::File, MAX_TRACKS> files;
+    RetireList<const SampleSource, std::shared_ptr<const SampleSource>> retired;
+
+    // Message thread writes, prefetch thread copies (under lock)
+    juce::CriticalSection lock;
+    std::array<std::shared_ptr<const SampleSource>, MAX_TRACKS> owned;
+
+    std::array<std::atomic<const SampleSource*>, MAX_TRACKS> published {};
+    std::array<std::atomic<juce::int64>, MAX_TRACKS>         cursors {};
+
+    JUCE_DECLARE_NON_COPYABLE (SamplePool)
+};
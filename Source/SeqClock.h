@@ -0,0 +1,260 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SeqClock — drift-free 16th-note clock
+//
+//  Time is an int64 sample counter. Musical position is never accumulated
+//  per sample: it is derived from the last anchor as
+//      pos(s) = anchorPos + (s - anchorSample) * stepsPerSample
+//  so rounding error cannot build up. With a host, every block re-anchors
+//  to the host PPQ (tempo ramps are followed block by block, loop-region
+//  wraps are applied on the exact sample); without one the clock free-runs
+//  and re-anchors only on tempo changes.
+//
+//  Ticks are on the straight 16th grid, each on the first sample at or
+//  after its boundary and carrying how far after it that sample is; swing
+//  and other per-event timing are compiled into the trigger lists (see
+//  PatternCompiler.h).
+// ─────────────────────────────────────────────────────────────────────────────
+class SeqClock
+{
+public:
+    struct Tick
+    {
+        int64_t step   = 0;      // absolute 16th-note index
+        bool    jumped = false;  // first tick after start / loop wrap / scrub
+        float   late   = 0.f;    // samples from the exact boundary to the tick's sample, 0-1
+    };
+
+    SeqClock() = default;
+
+    // Copies are snapshots (offline rendering); the statistics come along
+    SeqClock (const SeqClock& other) { *this = other; }
+
+    SeqClock& operator= (const SeqClock& other)
+    {
+        sr = other.sr;  bpm = other.bpm;  rate = other.rate;
+        blockStart     = other.blockStart;
+        blockLength    = other.blockLength;
+        anchorSample   = other.anchorSample;
+        anchorPos      = other.anchorPos;
+        nextStep       = other.nextStep;
+        nextStepSample = other.nextStepSample;
+        pendingJump    = other.pendingJump;
+        hostAnchored   = other.hostAnchored;
+        hasLoop        = other.hasLoop;
+        loopStart      = other.loopStart;
+        loopEnd        = other.loopEnd;
+        lastDrift.store (other.lastDrift.load());
+        maxDrift.store (other.maxDrift.load());
+        resyncs.store (other.resyncs.load());
+        return *this;
+    }
+
+    void prepare (double sampleRate)
+    {
+        sr = juce::jmax (1.0, sampleRate);
+        rate = stepsPerSampleFor (bpm);
+        blockStart = 0;
+        relocate (0.0);
+    }
+
+    // ── Tempo (apply at a block-relative sample offset) ─────────────────────
+    void setTempo (double newBpm, int offset = 0)
+    {
+        newBpm = juce::jmax (1.0, newBpm);
+        if (newBpm == bpm) return;
+
+        reanchor (blockStart + offset);
+        bpm  = newBpm;
+        rate = stepsPerSampleFor (bpm);
+        schedule();
+    }
+
+    double getBpm() const { return bpm; }
+
+    // Current step length, for converting step-relative event offsets
+    double getSamplesPerStep() const { return 1.0 / rate; }
+
+    // Absolute sample index of the current block's first sample
+    int64_t getBlockStart() const { return blockStart; }
+
+    // ── Host sync — call once per block before consuming ticks ───────────────
+    //  loopStartPpq/loopEndPpq: active host loop region, or loopEnd <= loopStart.
+    void syncToHost (double ppq, double hostBpm, double loopStartPpq, double loopEndPpq,
+                     int numSamples)
+    {
+        blockLength = numSamples;
+
+        const double hostPos = ppq * 4.0;
+        const double newRate = stepsPerSampleFor (juce::jmax (1.0, hostBpm));
+        bool jump = !hostAnchored;
+
+        if (hostAnchored)
+        {
+            const double driftSamples = (hostPos - positionAt (blockStart)) / newRate;
+            const double absDrift     = std::abs (driftSamples);
+
+            // More than a quarter step off the prediction is a relocation, not drift
+            if (absDrift * newRate > 0.25)
+                jump = true;
+            else
+            {
+                lastDrift.store ((float)driftSamples, std::memory_order_relaxed);
+                if (absDrift > maxDrift.load (std::memory_order_relaxed))
+                    maxDrift.store ((float)absDrift, std::memory_order_relaxed);
+            }
+        }
+
+        bpm          = juce::jmax (1.0, hostBpm);
+        rate         = newRate;
+        anchorSample = blockStart;
+        anchorPos    = hostPos;
+        hostAnchored = true;
+
+        loopStart = loopStartPpq * 4.0;
+        loopEnd   = loopEndPpq   * 4.0;
+        hasLoop   = loopEnd > loopStart && hostPos < loopEnd;
+
+        if (jump)
+        {
+            resyncs.fetch_add (1, std::memory_order_relaxed);
+            nextStep    = firstStepAtOrAfter (hostPos);
+            pendingJump = true;
+        }
+        schedule();
+    }
+
+    // Host stopped / not providing PPQ: next syncToHost counts as a jump
+    void releaseHost() { hostAnchored = false; hasLoop = false; }
+    bool isHostAnchored() const { return hostAnchored; }
+
+    // Free-running relocation (prepare, standalone start)
+    void relocate (double stepPos)
+    {
+        anchorSample = blockStart;
+        anchorPos    = stepPos;
+        nextStep     = firstStepAtOrAfter (stepPos);
+        pendingJump  = true;
+        hasLoop      = false;
+        schedule();
+    }
+
+    // Offline: the free-running clock as if it had run from step 0 at sample
+    // 0, with the next block starting at `sample`. Returns the step of the
+    // next tick, the first on or after that sample; it is a jump only when
+    // it is step 0, like a start from the top.
+    int64_t startAt (int64_t sample)
+    {
+        hostAnchored = hasLoop = false;
+        blockStart   = sample;
+        anchorSample = 0;
+        anchorPos    = 0.0;
+
+        nextStep = juce::jmax ((int64_t)0, (int64_t)std::floor ((double)sample * rate) - 1);
+        while (sampleOfStep (nextStep) < sample) ++nextStep;
+        pendingJump = nextStep == 0;
+        schedule();
+        return nextStep;
+    }
+
+    // Sample the tick of `step` falls on, at the current tempo and anchor
+    int64_t sampleOfStep (int64_t step) const
+    {
+        return anchorSample + (int64_t)std::ceil (((double)step - anchorPos) / rate - 1e-6);
+    }
+
+    // ── Tick consumption ─────────────────────────────────────────────────────
+    // Block-relative offset of the next step boundary (may be ≥ block size)
+    int nextTickOffset()
+    {
+        applyLoopWrap();
+        const int64_t rel = juce::jmax ((int64_t)0, nextStepSample - blockStart);
+        return (int)juce::jmin (rel, (int64_t)std::numeric_limits<int>::max());
+    }
+
+    Tick consumeTick()
+    {
+        const double exact = (double)anchorSample + ((double)nextStep - anchorPos) / rate;
+        Tick t { nextStep, pendingJump, (float)juce::jlimit (0.0, 1.0, (double)nextStepSample - exact) };
+        pendingJump = false;
+        ++nextStep;
+        schedule();
+        return t;
+    }
+
+    void endBlock (int numSamples) { blockStart += numSamples; }
+
+    // ── Instrumentation (read from any thread) ───────────────────────────────
+    float getLastDriftSamples() const { return lastDrift.load (std::memory_order_relaxed); }
+    float getMaxDriftSamples()  const { return maxDrift.load  (std::memory_order_relaxed); }
+    int   getResyncCount()      const { return resyncs.load   (std::memory_order_relaxed); }
+    void  resetStats() { lastDrift.store (0.f); maxDrift.store (0.f); resyncs.store (0); }
+
+private:
+    double stepsPerSampleFor (double b) const { return b * 4.0 / (60.0 * sr); }
+
+    double positionAt (int64_t sample) const
+    {
+        return anchorPos + (double)(sample - anchorSample) * rate;
+    }
+
+    int64_t firstStepAtOrAfter (double pos) const
+    {
+        const double tol = rate * 0.5;   // within half a sample counts as "on" the boundary
+        int64_t k = (int64_t)std::floor (pos) - 1;
+        while ((double)k < pos - tol) ++k;
+        return k;
+    }
+
+    void reanchor (int64_t sample)
+    {
+        anchorPos    = positionAt (sample);
+        anchorSample = sample;
+    }
+
+    void schedule() { nextStepSample = sampleOfStep (nextStep); }
+
+    // Host loop region: when the position reaches loopEnd before the next
+    // boundary, continue from loopStart on that exact sample.
+    void applyLoopWrap()
+    {
+        if (!hasLoop) return;
+
+        // Wraps past this block are left to the next syncToHost
+        const int64_t wrapSample = anchorSample + (int64_t)std::ceil ((loopEnd - anchorPos) / rate - 1e-6);
+        if (wrapSample > nextStepSample || wrapSample >= blockStart + blockLength) return;
+
+        anchorSample = wrapSample;
+        anchorPos    = loopStart;
+        nextStep     = firstStepAtOrAfter (loopStart);
+        pendingJump  = true;
+        resyncs.fetch_add (1, std::memory_order_relaxed);
+        schedule();
+    }
+
+    double  sr    = 44100.0;
+    double  bpm   = 128.0;
+    double  rate  = 0.0;      // steps per sample
+
+    int64_t blockStart     = 0;
+    int     blockLength    = 0;
+    int64_t anchorSample   = 0;
+    double  anchorPos      = 0.0;
+    int64_t nextStep       = 0;
+    int64_t nextStepSample = 0;
+    bool    pendingJump    = true;
+
+    bool    hostAnchored = false;
+    bool    hasLoop      = false;
+    double  loopStart = 0.0, loopEnd = 0.0;
+
+    std::atomic<float> lastDrift { 0.f };
+    std::atomic<float> maxDrift  { 0.f };
+    std::atomic<int>   resyncs   { 0 };
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Pattern.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SimilarityIndex — nearest patterns by rhythm
+//
+//  A fingerprint is the steps each track actually plays, one 64-bit mask per
+//  track; unused tracks are zero. The distance between two patterns is the
+//  number of steps that differ (Hamming distance over the masks). A scan
+//  walks fingerprints stored back to back, so a library can keep them as one
+//  flat array and scan it in place. The bit count is a branch-free SWAR sum
+//  that compilers vectorise (SSE2 / NEON) without per-CPU builds, and long
+//  scans are split across threads.
+// ─────────────────────────────────────────────────────────────────────────────
+namespace SimilarityIndex
+{
+    static constexpr int kWords = MAX_TRACKS;   // one 64-step mask per track
+
+    using Fingerprint = std::array<uint64_t, kWords>;
+
+    struct Match
+    {
+        int index;
+        int distance;   // steps that differ
+    };
+
+    inline Fingerprint fingerprint (const Pattern& p, int numTracks)
+    {
+        Fingerprint f {};
+        for (int t = 0; t < juce::jlimit (0, kWords, numTracks); ++t)
+            f[(size_t)t] = p.activeSteps (t);
+        return f;
+    }
+
+    // Per-byte bit counts are widened to 16-bit lanes every word, so a lane
+    // gains at most 16 per word and the sum over kWords cannot overflow
+    inline int distance (const uint64_t* a, const uint64_t* b)
+    {
+        uint64_t lanes = 0;
+        for (int w = 0; w < kWords; ++w)
+        {
+            uint64_t x = a[w] ^ b[w];
+            x = x - ((x >> 1) & 0x5555555555555555ull);
+            x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+            x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+            lanes += (x & 0x00FF00FF00FF00FFull) + ((x >> 8) & 0x00FF00FF00FF00FFull);
+        }
+        return (int)((lanes * 0x0001000100010001ull) >> 48);
+    }
+
+    // Best k so far, closest first (ties: lower index first)
+    class TopK
+    {
+    public:
+        explicit TopK (int k) : k (juce::jmax (1, k)) { best.reserve ((size_t)this->k + 1); }
+
+        int worst() const { return (int)best.size() < k ? kWords * 64 + 1 : best.back().distance; }
+
+        void add (Match m)
+        {
+            const auto at = std::upper_bound (best.begin(), best.end(), m, closer);
+            best.insert (at, m);
+            if ((int)best.size() > k)
+                best.pop_back();
+        }
+
+        void merge (const TopK& o)
+        {
+            for (const auto& m : o.best)
+                add (m);
+        }
+
+        std::vector<Match> best;
+
+    private:
+        static bool closer (const Match& a, const Match& b)
+        {
+            return a.distance != b.distance ? a.distance < b.distance : a.index < b.index;
+        }
+
+        int k;
+    };
+
+    // The k fingerprints in prints[0, count) nearest to `query`. `accept`
+    // filters entries (e.g. kits, which have no rhythm); it only runs for
+    // entries close enough to make the list, and may run on several threads.
+    template <typename Accept>
+    std::vector<Match> nearest (const uint64_t* prints, int count, const Fingerprint& query,
+                                int k, Accept&& accept)
+    {
+        static constexpr int kMinPerThread = 16384;
+
+        auto scan = [&] (int begin, int end, TopK& top)
+        {
+            for (int i = begin; i < end; ++i)
+            {
+                const int d = distance (prints + (size_t)i * kWords, query.data());
+                if (d < top.worst() && accept (i))
+                    top.add ({ i, d });
+            }
+        };
+
+        const int numThreads = juce::jlimit (1, 8, juce::jmin ((int)std::thread::hardware_concurrency(),
+                                                               count / kMinPerThread));
+        std::vector<TopK> tops ((size_t)numThreads, TopK (k));
+        std::vector<std::thread> helpers;
+        const int chunk = (count + numThreads - 1) / numThreads;
+        for (int t = 1; t < numThreads; ++t)
+            helpers.emplace_back (scan, t * chunk, juce::jmin (count, (t + 1) * chunk), std::ref (tops[(size_t)t]));
+        scan (0, juce::jmin (count, chunk), tops[0]);
+        for (auto& h : helpers)
+            h.join();
+
+        for (int t = 1; t < numThreads; ++t)
+            tops[0].merge (tops[(size_t)t]);
+        return tops[0].best;
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include "LockFree.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SongTimeline — the song chain as a prefix sum of 16th-note steps
+//
+//  prefix[i] = first absolute step of slot i, so any host position maps to
+//  (slot, loop, step) with one binary search. Single writer (message
+//  thread): an edit copies the current table, rebuilds the slots from the
+//  edited one onwards and publishes the copy through an atomic pointer.
+//  The audio thread reads whichever table is current, in one load and
+//  without retrying; a replaced table is freed once no block can see it.
+// ─────────────────────────────────────────────────────────────────────────────
+template <int MaxSlots>
+class SongTimeline
+{
+public:
+    struct SlotSpan
+    {
+        int loopSteps = 16;  // length of one pass of the slot's pattern
+        int repeats   = 1;
+    };
+
+    struct Position
+    {
+        int     slot     = 0;
+        int     loop     = 0;     // 0 .. repeats-1
+        int     step     = 0;     // step inside the pattern
+        int64_t slotStep = 0;     // steps since the slot started
+        bool    outside  = false; // before the song, or past its end with loop off
+    };
+
+    explicit SongTimeline (const AudioEpoch& e) : epoch (e)
+    {
+        publish (std::make_unique<Table>());
+    }
+
+    // ── Message thread ───────────────────────────────────────────────────────
+    //  spanOf(slot) → SlotSpan. Rebuilds slots [fromSlot, numSlots).
+    template <typename SpanOf>
+    void update (int fromSlot, int numSlots, SpanOf&& spanOf)
+    {
+        numSlots = juce::jlimit (1, MaxSlots, numSlots);
+        fromSlot = juce::jlimit (0, numSlots - 1, fromSlot);
+
+        auto next = std::make_unique<Table> (*owned);   // slots before fromSlot stay as they are
+        int64_t pos = next->prefix[(size_t)fromSlot];
+        for (int sl = fromSlot; sl < numSlots; ++sl)
+        {
+            const SlotSpan span = spanOf (sl);
+            const int loopSteps = juce::jmax (1, span.loopSteps);
+            const int repeats   = juce::jmax (1, span.repeats);
+
+            next->loopLength[(size_t)sl] = loopSteps;
+            pos += (int64_t)loopSteps * repeats;
+            next->prefix[(size_t)sl + 1] = pos;
+        }
+        next->length = numSlots;
+        publish (std::move (next));
+    }
+
+    // Loop length the current table holds for `slot`; 0 past its end
+    int loopSteps (int slot) const
+    {
+        return slot < owned->length ? owned->loopLength[(size_t)slot] : 0;
+    }
+
+    // Frees tables the audio thread can no longer see (from the timer)
+    void collectGarbage() { retired.collect (epoch); }
+
+    // ── Audio thread (inside an AudioEpoch::Scope) ───────────────────────────
+    Position locate (int64_t absStep, bool loopMode) const
+    {
+        return read (*current.load (std::memory_order_acquire), absStep, loopMode);
+    }
+
+    // First absolute step of `slot` (numSlots: the end of the song)
+    int64_t slotStart (int slot) const
+    {
+        const auto& t = *current.load (std::memory_order_acquire);
+        return t.prefix[(size_t)juce::jlimit (0, t.length, slot)];
+    }
+
+    int64_t totalSteps() const
+    {
+        const auto& t = *current.load (std::memory_order_acquire);
+        return t.prefix[(size_t)t.length];
+    }
+
+private:
+    struct Table
+    {
+        std::array<int64_t, MaxSlots + 1> prefix {};
+        std::array<int,     MaxSlots>     loopLength {};
+        int length = 1;
+    };
+
+    void publish (std::unique_ptr<Table> table)
+    {
+        current.store (table.get(), std::memory_order_release);
+        retired.retire (std::exchange (owned, std::move (table)), epoch);
+    }
+
+    static Position read (const Table& t, int64_t absStep, bool loopMode)
+    {
+        Position p;
+        const int     n     = t.length;
+        const int64_t total = t.prefix[(size_t)n];
+
+        if (absStep < 0 || total <= 0 || (absStep >= total && !loopMode))
+        {
+            p.outside = true;
+            return p;
+        }
+        absStep %= total;
+
+        // last slot whose start is ≤ absStep
+        int lo = 0, hi = n - 1;
+        while (lo < hi)
+        {
+            const int mid = (lo + hi + 1) / 2;
+            if (t.prefix[(size_t)mid] <= absStep) lo = mid;
+            else                                  hi = mid - 1;
+        }
+
+        const int64_t rel  = absStep - t.prefix[(size_t)lo];
+        const int     loop = juce::jmax (1, t.loopLength[(size_t)lo]);
+
+        p.slot     = lo;
+        p.loop     = (int)(rel / loop);
+        p.step     = (int)(rel % loop);
+        p.slotStep = rel;
+        return p;
+    }
+
+    const AudioEpoch&           epoch;
+    std::unique_ptr<Table>      owned;   // message thread
+    std::atomic<const Table*>   current { nullptr };
+    RetireList<Table>           retired;
+
+    JUCE_DECLARE_NON_COPYABLE (SongTimeline)
+};
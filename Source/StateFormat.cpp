@@ -0,0 +1,909 @@
+#include "StateFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+// ─────────────────────────────────────────────────────────────────────────────
+bool SessionState::operator== (const SessionState& o) const
+{
+    if (params.size() != o.params.size() || layout.numTracks != o.layout.numTracks
+        || patterns != o.patterns || chain != o.chain
+        || loopMode != o.loopMode || editPattern != o.editPattern
+        || journalId != o.journalId || journalSeq != o.journalSeq
+        || samples != o.samples)
+        return false;
+
+    for (size_t i = 0; i < params.size(); ++i)
+        if (params[i].value != o.params[i].value || params[i].id != o.params[i].id)
+            return false;
+
+    for (int t = 0; t < layout.numTracks; ++t)
+        if (layout.voice[(size_t)t] != o.layout.voice[(size_t)t] || trackOutput[(size_t)t] != o.trackOutput[(size_t)t]
+            || layout.midiInNote[(size_t)t] != o.layout.midiInNote[(size_t)t]
+            || layout.midiInChannel[(size_t)t] != o.layout.midiInChannel[(size_t)t])
+            return false;
+
+    return true;
+}
+
+namespace StateFormat
+{
+namespace
+{
+    // Chunk IDs
+    constexpr uint32_t kChunkParams   = 0x5041524D;   // 'PARM'
+    constexpr uint32_t kChunkLayout   = 0x4C594F54;   // 'LYOT'
+    constexpr uint32_t kChunkPatterns = 0x50415453;   // 'PATS'
+    constexpr uint32_t kChunkArrange  = 0x41524E47;   // 'ARNG'
+    constexpr uint32_t kChunkEdit     = 0x45444954;   // 'EDIT'
+    constexpr uint32_t kChunkJournal  = 0x4A524E4C;   // 'JRNL'
+    constexpr uint32_t kChunkLocks    = 0x4C4F434B;   // 'LOCK'
+    constexpr uint32_t kChunkGrooves  = 0x47524F56;   // 'GROV'
+    constexpr uint32_t kChunkSamples  = 0x534D504C;   // 'SMPL'
+
+    // Change blocks only
+    constexpr uint32_t kChunkPatternSet = 0x50534554; // 'PSET'
+    constexpr uint32_t kChunkChainSet   = 0x43534554; // 'CSET'
+
+    constexpr size_t kHeaderBytes      = 16;
+    constexpr size_t kChunkHeaderBytes = 10;
+
+    // ── Byte / bit streams ───────────────────────────────────────────────────
+    struct ByteWriter
+    {
+        std::vector<uint8_t> bytes;
+
+        void u8  (uint32_t v) { bytes.push_back ((uint8_t)v); }
+        void u16 (uint32_t v) { u8 (v); u8 (v >> 8); }
+        void u32 (uint32_t v) { u16 (v); u16 (v >> 16); }
+
+        void f32 (float v)
+        {
+            uint32_t bits;
+            std::memcpy (&bits, &v, sizeof (bits));
+            u32 (bits);
+        }
+
+        void varint (uint32_t v)
+        {
+            while (v >= 0x80)
+            {
+                u8 ((v & 0x7F) | 0x80);
+                v >>= 7;
+            }
+            u8 (v);
+        }
+
+        // Chunks are written in place; the size is patched once the body is done
+        size_t beginChunk (uint32_t id, int version)
+        {
+            u32 (id);
+            u16 ((uint32_t)version);
+            u32 (0);
+            return bytes.size();
+        }
+
+        void endChunk (size_t bodyStart)
+        {
+            const uint32_t size = (uint32_t)(bytes.size() - bodyStart);
+            for (int i = 0; i < 4; ++i)
+                bytes[bodyStart - 4 + (size_t)i] = (uint8_t)(size >> (8 * i));
+        }
+    };
+
+    // Overruns set ok = false and read zeros, so callers check once at the end
+    struct ByteReader
+    {
+        const uint8_t* p   = nullptr;
+        const uint8_t* end = nullptr;
+        bool ok = true;
+
+        size_t remaining() const { return (size_t)(end - p); }
+
+        uint32_t u8()
+        {
+            if (p >= end) { ok = false; return 0; }
+            return *p++;
+        }
+
+        uint32_t u16() { const uint32_t lo = u8(); return lo | (u8() << 8); }
+        uint32_t u32() { const uint32_t lo = u16(); return lo | (u16() << 16); }
+
+        float f32()
+        {
+            const uint32_t bits = u32();
+            float v;
+            std::memcpy (&v, &bits, sizeof (v));
+            return v;
+        }
+
+        uint32_t varint()
+        {
+            uint32_t v = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                const uint32_t b = u8();
+                v |= (b & 0x7F) << shift;
+                if ((b & 0x80) == 0) return v;
+            }
+            ok = false;
+            return 0;
+        }
+    };
+
+    struct BitWriter
+    {
+        explicit BitWriter (ByteWriter& w) : out (w) {}
+        ~BitWriter() { flush(); }
+
+        void write (uint64_t v, int bits)
+        {
+            while (bits > 0)
+            {
+                const int n = juce::jmin (bits, 32);
+                acc  |= (v & ((uint64_t (1) << n) - 1)) << fill;
+                fill += n;
+                v   >>= n;
+                bits -= n;
+                for (; fill >= 8; fill -= 8, acc >>= 8)
+                    out.u8 ((uint32_t)(acc & 0xFF));
+            }
+        }
+
+        void flush()
+        {
+            if (fill > 0) out.u8 ((uint32_t)acc);
+            acc  = 0;
+            fill = 0;
+        }
+
+        ByteWriter& out;
+        uint64_t    acc  = 0;
+        int         fill = 0;
+    };
+
+    struct BitReader
+    {
+        explicit BitReader (ByteReader& r) : in (r) {}
+
+        uint64_t read (int bits)
+        {
+            uint64_t v = 0;
+            for (int got = 0; got < bits;)
+            {
+                if (fill == 0)
+                {
+                    acc  = in.u8();
+                    fill = 8;
+                }
+                const int n = juce::jmin (bits - got, fill);
+                v    |= (uint64_t)(acc & ((1u << n) - 1)) << got;
+                acc >>= n;
+                fill -= n;
+                got  += n;
+            }
+            return v;
+        }
+
+        ByteReader& in;
+        uint32_t    acc  = 0;
+        int         fill = 0;
+    };
+
+    int significantBits (uint64_t v)
+    {
+        int n = 0;
+        for (; v != 0; v >>= 1) ++n;
+        return n;
+    }
+
+    // ── Pattern: per track length-1 (6 bits), step count + steps up to the
+    //    highest set one (7 + n bits), note count + 3-bit notes up to the last
+    //    non-zero one (7 + 3n bits). Byte-aligned per pattern. ───────────────
+    void writePattern (ByteWriter& w, const Pattern& pat, int numTracks)
+    {
+        BitWriter bits (w);
+        for (int t = 0; t < numTracks; ++t)
+        {
+            bits.write ((uint64_t)(pat.trackLength[(size_t)t] - 1), 6);
+
+            const uint64_t steps = pat.stepBits[(size_t)t];
+            const int numSteps = significantBits (steps);
+            bits.write ((uint64_t)numSteps, 7);
+            bits.write (steps, numSteps);
+
+            const auto& notes = pat.stepNotes[(size_t)t];
+            int numNotes = MAX_STEPS;
+            while (numNotes > 0 && notes[(size_t)(numNotes - 1)] == 0) --numNotes;
+            bits.write ((uint64_t)numNotes, 7);
+            for (int s = 0; s < numNotes; ++s)
+                bits.write (notes[(size_t)s], 3);
+        }
+    }
+
+    void readPattern (ByteReader& r, Pattern& pat, int numTracks)
+    {
+        BitReader bits (r);
+        for (int t = 0; t < numTracks; ++t)
+        {
+            pat.setTrackLength (t, (int)bits.read (6) + 1);
+
+            const int numSteps = juce::jmin ((int)bits.read (7), MAX_STEPS);
+            pat.stepBits[(size_t)t] = bits.read (numSteps);
+
+            const int numNotes = juce::jmin ((int)bits.read (7), MAX_STEPS);
+            for (int s = 0; s < numNotes; ++s)
+                pat.setNote (t, s, (int)bits.read (3));
+        }
+    }
+
+    // ── Chunks ───────────────────────────────────────────────────────────────
+    void writeParams (ByteWriter& w, const SessionState& st)
+    {
+        const auto body = w.beginChunk (kChunkParams, 1);
+        w.varint ((uint32_t)st.params.size());
+        for (const auto& p : st.params)
+        {
+            const auto utf8 = p.id.toRawUTF8();
+            const auto len  = juce::jmin ((size_t)255, std::strlen (utf8));
+            w.u8 ((uint32_t)len);
+            w.bytes.insert (w.bytes.end(), utf8, utf8 + len);
+            w.f32 (p.value);
+        }
+        w.endChunk (body);
+    }
+
+    void readParams (ByteReader& r, SessionState& st)
+    {
+        const uint32_t n = r.varint();
+        for (uint32_t i = 0; i < n && r.ok; ++i)
+        {
+            const size_t len = r.u8();
+            if (r.remaining() < len + 4) { r.ok = false; break; }
+            const auto id = juce::String::fromUTF8 ((const char*)r.p, (int)len);
+            r.p += len;
+            st.params.push_back ({ id, r.f32() });
+        }
+    }
+
+    // v2 appends the MIDI input map: per track the note + 1 (0 = any) and
+    // the channel (0 = any)
+    void writeLayout (ByteWriter& w, const SessionState& st)
+    {
+        const auto body = w.beginChunk (kChunkLayout, 2);
+        w.u8 ((uint32_t)st.layout.numTracks);
+        for (int t = 0; t < st.layout.numTracks; ++t)
+        {
+            w.u8 (st.layout.voice[(size_t)t]);
+            w.u8 (st.trackOutput[(size_t)t]);
+        }
+        for (int t = 0; t < st.layout.numTracks; ++t)
+        {
+            w.u8 ((uint32_t)(st.layout.midiInNote[(size_t)t] + 1));
+            w.u8 (st.layout.midiInChannel[(size_t)t]);
+        }
+        w.endChunk (body);
+    }
+
+    void readLayout (ByteReader& r, SessionState& st)
+    {
+        st.layout.numTracks = juce::jlimit (1, MAX_TRACKS, (int)r.u8());
+        for (int t = 0; t < st.layout.numTracks; ++t)
+        {
+            st.layout.voice[(size_t)t] = (uint8_t)juce::jlimit (0, NUM_VOICE_TYPES - 1, (int)r.u8());
+            st.trackOutput[(size_t)t]  = (uint8_t)r.u8();
+        }
+
+        // v1: the defaults for each voice
+        const bool hasMidiIn = r.remaining() >= (size_t)st.layout.numTracks * 2;
+        for (int t = 0; t < st.layout.numTracks; ++t)
+        {
+            if (!hasMidiIn)
+            {
+                st.layout.resetMidiIn (t);
+                continue;
+            }
+            st.layout.midiInNote[(size_t)t]    = (int8_t)((int)juce::jmin (128u, r.u8()) - 1);
+            st.layout.midiInChannel[(size_t)t] = (uint8_t)juce::jmin (16u, r.u8());
+        }
+    }
+
+    // Each distinct stored pattern once, then per pattern the 1-based index of
+    // its copy (0 = empty)
+    void writePatterns (ByteWriter& w, const SessionState& st)
+    {
+        const int numTracks = st.layout.numTracks;
+
+        std::unordered_map<const Pattern*, uint32_t> index;
+        std::vector<uint32_t> ref (st.patterns.size(), 0);
+        std::vector<const Pattern*> distinct;
+        for (size_t i = 0; i < st.patterns.size(); ++i)
+        {
+            const Pattern* p = st.patterns[i].get();
+            if (p == nullptr) continue;
+            auto it = index.find (p);
+            if (it == index.end())
+            {
+                distinct.push_back (p);
+                it = index.emplace (p, (uint32_t)distinct.size()).first;
+            }
+            ref[i] = it->second;
+        }
+
+        const auto body = w.beginChunk (kChunkPatterns, 1);
+        w.varint ((uint32_t)numTracks);
+        w.varint ((uint32_t)distinct.size());
+        for (const auto* p : distinct)
+            writePattern (w, *p, numTracks);
+        w.varint ((uint32_t)st.patterns.size());
+        for (auto r : ref)
+            w.varint (r);
+        w.endChunk (body);
+    }
+
+    void readPatterns (ByteReader& r, SessionState& st)
+    {
+        const int numTracks   = juce::jlimit (0, MAX_TRACKS, (int)r.varint());
+        const uint32_t numDistinct = r.varint();
+
+        std::vector<std::shared_ptr<const Pattern>> distinct;
+        for (uint32_t d = 0; d < numDistinct && r.ok && r.remaining() > 0; ++d)
+        {
+            auto pat = std::make_shared<Pattern>();
+            readPattern (r, *pat, numTracks);
+            distinct.push_back (std::move (pat));
+        }
+
+        const uint32_t numPatterns = r.varint();
+        st.patterns.clear();
+        st.patterns.reserve (juce::jmin ((size_t)numPatterns, r.remaining()));
+        for (uint32_t i = 0; i < numPatterns && r.ok; ++i)
+        {
+            const uint32_t ref = r.varint();
+            st.patterns.push_back (ref > 0 && ref <= distinct.size() ? distinct[ref - 1] : nullptr);
+        }
+    }
+
+    // Parameter locks of the listed patterns (PATS / PSET leave them out, so
+    // older readers load the patterns without them): per pattern its index,
+    // lock count and track | step | param | value bytes
+    void writeLocks (ByteWriter& w, const SessionState& st, const std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> locked;
+        for (auto i : indices)
+            if (st.patterns[i] != nullptr && st.patterns[i]->locks[0].param != LOCK_NONE)
+                locked.push_back (i);
+        if (locked.empty())
+            return;
+
+        const auto body = w.beginChunk (kChunkLocks, 1);
+        w.varint ((uint32_t)locked.size());
+        for (auto i : locked)
+        {
+            const auto& pat = *st.patterns[i];
+            const int n = pat.numLocks();
+            w.varint (i);
+            w.varint ((uint32_t)n);
+            for (int k = 0; k < n; ++k)
+            {
+                const auto& l = pat.locks[(size_t)k];
+                w.u8 (l.track);
+                w.u8 (l.step);
+                w.u8 (l.param);
+                w.u8 (l.value);
+            }
+        }
+        w.endChunk (body);
+    }
+
+    std::vector<uint32_t> allPatterns (const SessionState& st)
+    {
+        std::vector<uint32_t> all (st.patterns.size());
+        for (size_t i = 0; i < all.size(); ++i)
+            all[i] = (uint32_t)i;
+        return all;
+    }
+
+    // Read after the patterns they belong to; each locked pattern becomes its
+    // own copy (stateLoaded() shares equal patterns again)
+    void readLocks (ByteReader& r, SessionState& st)
+    {
+        const uint32_t n = r.varint();
+        for (uint32_t k = 0; k < n && r.ok; ++k)
+        {
+            const uint32_t i     = r.varint();
+            const uint32_t count = r.varint();
+            if (count > (uint32_t)MAX_PARAM_LOCKS || r.remaining() < count * 4) { r.ok = false; break; }
+
+            auto pat = std::make_shared<Pattern> (i < st.patterns.size() && st.patterns[i] != nullptr
+                                                      ? *st.patterns[i] : Pattern());
+            for (uint32_t c = 0; c < count; ++c)
+            {
+                const int t = (int)r.u8(), s = (int)r.u8(), param = (int)r.u8(), value = (int)r.u8();
+                if (t < MAX_TRACKS && s < MAX_STEPS && param > LOCK_NONE && param < NUM_LOCK_PARAMS)
+                    pat->setLock (t, s, param, value);
+            }
+            if (i < st.patterns.size())
+                st.patterns[i] = std::move (pat);
+        }
+    }
+
+    // Groove templates of the listed patterns that use any: per pattern its
+    // index, track count and one template index per track
+    void writeGrooves (ByteWriter& w, const SessionState& st, const std::vector<uint32_t>& indices)
+    {
+        static const std::array<uint8_t, MAX_TRACKS> straight {};
+        std::vector<uint32_t> grooved;
+        for (auto i : indices)
+            if (st.patterns[i] != nullptr && st.patterns[i]->trackGroove != straight)
+                grooved.push_back (i);
+        if (grooved.empty())
+            return;
+
+        const int numTracks = st.layout.numTracks;
+        const auto body = w.beginChunk (kChunkGrooves, 1);
+        w.varint ((uint32_t)grooved.size());
+        for (auto i : grooved)
+        {
+            w.varint (i);
+            w.varint ((uint32_t)numTracks);
+            for (int t = 0; t < numTracks; ++t)
+                w.u8 (st.patterns[i]->trackGroove[(size_t)t]);
+        }
+        w.endChunk (body);
+    }
+
+    void readGrooves (ByteReader& r, SessionState& st)
+    {
+        const uint32_t n = r.varint();
+        for (uint32_t k = 0; k < n && r.ok; ++k)
+        {
+            const uint32_t i         = r.varint();
+            const uint32_t numTracks = r.varint();
+            if (numTracks > (uint32_t)MAX_TRACKS || r.remaining() < numTracks) { r.ok = false; break; }
+
+            auto pat = std::make_shared<Pattern> (i < st.patterns.size() && st.patterns[i] != nullptr
+                                                      ? *st.patterns[i] : Pattern());
+            for (uint32_t t = 0; t < numTracks; ++t)
+                pat->trackGroove[t] = r.u8();   // unknown templates play straight
+            if (i < st.patterns.size())
+                st.patterns[i] = std::move (pat);
+        }
+    }
+
+    void writeArrangement (ByteWriter& w, const SessionState& st)
+    {
+        const auto body = w.beginChunk (kChunkArrange, 1);
+        w.varint ((uint32_t)st.chain.size());
+        w.u8 (st.loopMode ? 1 : 0);
+        for (const auto& slot : st.chain)
+        {
+            w.varint (slot.pattern);
+            w.varint (slot.repeats);
+        }
+        w.endChunk (body);
+    }
+
+    void readArrangement (ByteReader& r, SessionState& st)
+    {
+        const uint32_t n = r.varint();
+        st.loopMode = r.u8() != 0;
+        st.chain.clear();
+        st.chain.reserve (juce::jmin ((size_t)n, r.remaining() / 2));
+        for (uint32_t i = 0; i < n && r.ok; ++i)
+        {
+            SessionState::Slot slot;
+            slot.pattern = r.varint();
+            slot.repeats = juce::jmax (1u, r.varint());
+            st.chain.push_back (slot);
+        }
+    }
+
+    void writeEdit (ByteWriter& w, const SessionState& st)
+    {
+        const auto body = w.beginChunk (kChunkEdit, 1);
+        w.varint ((uint32_t)juce::jmax (0, st.editPattern));
+        w.endChunk (body);
+    }
+
+    void readEdit (ByteReader& r, SessionState& st)
+    {
+        st.editPattern = (int)r.varint();
+    }
+
+    void writeJournal (ByteWriter& w, const SessionState& st)
+    {
+        if (st.journalId.isEmpty())
+            return;
+
+        const auto body = w.beginChunk (kChunkJournal, 1);
+        const auto utf8 = st.journalId.toRawUTF8();
+        const auto len  = juce::jmin ((size_t)255, std::strlen (utf8));
+        w.u8 ((uint32_t)len);
+        w.bytes.insert (w.bytes.end(), utf8, utf8 + len);
+        w.varint (st.journalSeq);
+        w.endChunk (body);
+    }
+
+    void readJournal (ByteReader& r, SessionState& st)
+    {
+        const size_t len = r.u8();
+        if (r.remaining() < len) { r.ok = false; return; }
+        st.journalId = juce::String::fromUTF8 ((const char*)r.p, (int)len);
+        r.p += len;
+        st.journalSeq = r.varint();
+    }
+
+    bool hasSamples (const SessionState& st)
+    {
+        return std::any_of (st.samples.begin(), st.samples.end(), [] (const juce::String& s) { return s.isNotEmpty(); });
+    }
+
+    // Sample file paths: count, then u8 track | varint length | UTF-8 path.
+    // Tracks not listed have none, so this chunk also serves as a change.
+    void writeSamples (ByteWriter& w, const SessionState& st)
+    {
+        const auto body = w.beginChunk (kChunkSamples, 1);
+        w.varint ((uint32_t)std::count_if (st.samples.begin(), st.samples.end(),
+                                           [] (const juce::String& s) { return s.isNotEmpty(); }));
+        for (int t = 0; t < MAX_TRACKS; ++t)
+        {
+            if (st.samples[(size_t)t].isEmpty())
+                continue;
+            const auto utf8 = st.samples[(size_t)t].toRawUTF8();
+            const auto len  = std::strlen (utf8);
+            w.u8 ((uint32_t)t);
+            w.varint ((uint32_t)len);
+            w.bytes.insert (w.bytes.end(), utf8, utf8 + len);
+        }
+        w.endChunk (body);
+    }
+
+    void readSamples (ByteReader& r, SessionState& st)
+    {
+        st.samples.fill ({});
+        const uint32_t n = r.varint();
+        for (uint32_t i = 0; i < n && r.ok; ++i)
+        {
+            const int    t   = (int)r.u8();
+            const size_t len = r.varint();
+            if (r.remaining() < len) { r.ok = false; return; }
+            if (t < MAX_TRACKS)
+                st.samples[(size_t)t] = juce::String::fromUTF8 ((const char*)r.p, (int)len);
+            r.p += len;
+        }
+    }
+
+    // ── Change chunks ────────────────────────────────────────────────────────
+    bool samePattern (const std::shared_ptr<const Pattern>& a, const std::shared_ptr<const Pattern>& b)
+    {
+        static const Pattern empty;
+        return a == b || *(a != nullptr ? a.get() : &empty) == *(b != nullptr ? b.get() : &empty);
+    }
+
+    // Parameters that changed or are new, as a 'PARM' chunk
+    void writeParamChanges (ByteWriter& w, const SessionState& from, const SessionState& to)
+    {
+        SessionState changed;
+        for (size_t i = 0; i < to.params.size(); ++i)
+        {
+            const auto& p = to.params[i];
+            if (i >= from.params.size() || from.params[i].id != p.id || from.params[i].value != p.value)
+                changed.params.push_back (p);
+        }
+        if (!changed.params.empty())
+            writeParams (w, changed);
+    }
+
+    void applyParamChanges (ByteReader& r, SessionState& st)
+    {
+        SessionState changed;
+        readParams (r, changed);
+        for (const auto& p : changed.params)
+        {
+            auto it = std::find_if (st.params.begin(), st.params.end(),
+                                    [&] (const SessionState::Param& q) { return q.id == p.id; });
+            if (it != st.params.end()) it->value = p.value;
+            else                      st.params.push_back (p);
+        }
+    }
+
+    // Patterns by index, each whole: u8 1 + pattern, or u8 0 for empty; then
+    // their locks and grooves
+    void writePatternChanges (ByteWriter& w, const SessionState& from, const SessionState& to)
+    {
+        std::vector<uint32_t> changed;
+        for (size_t i = 0; i < to.patterns.size(); ++i)
+            if (!samePattern (i < from.patterns.size() ? from.patterns[i] : nullptr, to.patterns[i]))
+                changed.push_back ((uint32_t)i);
+        if (changed.empty())
+            return;
+
+        const int numTracks = to.layout.numTracks;
+        const auto body = w.beginChunk (kChunkPatternSet, 1);
+        w.varint ((uint32_t)numTracks);
+        w.varint ((uint32_t)changed.size());
+        for (auto i : changed)
+        {
+            const auto& p = to.patterns[i];
+            w.varint (i);
+            w.u8 (p != nullptr ? 1 : 0);
+            if (p != nullptr)
+                writePattern (w, *p, numTracks);
+        }
+        w.endChunk (body);
+        writeLocks   (w, to, changed);
+        writeGrooves (w, to, changed);
+    }
+
+    void applyPatternChanges (ByteReader& r, SessionState& st)
+    {
+        const int numTracks = juce::jlimit (0, MAX_TRACKS, (int)r.varint());
+        const uint32_t n = r.varint();
+        for (uint32_t k = 0; k < n && r.ok; ++k)
+        {
+            const uint32_t i = r.varint();
+            std::shared_ptr<Pattern> pat;
+            if (r.u8() != 0)
+            {
+                pat = std::make_shared<Pattern>();
+                readPattern (r, *pat, numTracks);
+            }
+            if (i >= (uint32_t)NUM_PATTERNS) { r.ok = false; break; }
+            if (st.patterns.size() <= i) st.patterns.resize (i + 1);
+            st.patterns[i] = std::move (pat);
+        }
+    }
+
+    // Chain length, loop mode and the span of slots that differ
+    void writeChainChanges (ByteWriter& w, const SessionState& from, const SessionState& to)
+    {
+        size_t first = to.chain.size(), last = 0;
+        for (size_t i = 0; i < to.chain.size(); ++i)
+            if (i >= from.chain.size() || !(from.chain[i] == to.chain[i]))
+            {
+                first = juce::jmin (first, i);
+                last  = i + 1;
+            }
+        if (first >= last && from.chain.size() == to.chain.size() && from.loopMode == to.loopMode)
+            return;
+        if (first >= last)
+            first = last = 0;
+
+        const auto body = w.beginChunk (kChunkChainSet, 1);
+        w.varint ((uint32_t)to.chain.size());
+        w.u8 (to.loopMode ? 1 : 0);
+        w.varint ((uint32_t)first);
+        w.varint ((uint32_t)(last - first));
+        for (size_t i = first; i < last; ++i)
+        {
+            w.varint (to.chain[i].pattern);
+            w.varint (to.chain[i].repeats);
+        }
+        w.endChunk (body);
+    }
+
+    void applyChainChanges (ByteReader& r, SessionState& st)
+    {
+        const uint32_t length = r.varint();
+        st.loopMode = r.u8() != 0;
+        const uint32_t first = r.varint();
+        const uint32_t count = r.varint();
+        if (length > (uint32_t)NUM_SONG_SLOTS || first > length || count > length - first)
+        {
+            r.ok = false;
+            return;
+        }
+
+        st.chain.resize (length);
+        for (uint32_t i = first; i < first + count && r.ok; ++i)
+        {
+            st.chain[i].pattern = r.varint();
+            st.chain[i].repeats = juce::jmax (1u, r.varint());
+        }
+    }
+
+    // ── Blocks: header, chunks, checksum ─────────────────────────────────────
+    void beginBlock (ByteWriter& w)
+    {
+        w.u32 (kMagic);
+        w.u16 ((uint32_t)kVersion);
+        w.u16 (1);                      // oldest reader that understands this payload
+        w.u32 (0);                      // payload size  ┐ patched by finishBlock()
+        w.u32 (0);                      // CRC-32        ┘
+    }
+
+    // Calls chunk (id, reader) for each chunk; false if one overruns
+    template <typename Chunk>
+    bool forEachChunk (ByteReader& r, Chunk&& chunk)
+    {
+        while (r.ok && r.remaining() >= kChunkHeaderBytes)
+        {
+            const uint32_t id   = r.u32();
+            r.u16();                            // chunk version: newer ones only append fields
+            const uint32_t size = r.u32();
+            if (size > r.remaining())
+                return false;
+
+            ByteReader body { r.p, r.p + size };
+            chunk (id, body);                   // unknown chunks are skipped
+            if (!body.ok)
+                return false;
+            r.p += size;
+        }
+        return r.ok;
+    }
+
+    // Reflected CRC-32 (zlib polynomial)
+    struct CrcTable
+    {
+        std::array<uint32_t, 256> t {};
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    };
+}
+
+uint32_t crc32 (const uint8_t* data, size_t size)
+{
+    static const CrcTable table;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i)
+        c = table.t[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+bool isStateFormat (const void* data, size_t size)
+{
+    ByteReader r { (const uint8_t*)data, (const uint8_t*)data + size };
+    return size >= kHeaderBytes && r.u32() == kMagic;
+}
+
+namespace
+{
+    void finishBlock (ByteWriter& w, juce::MemoryBlock& dest)
+    {
+        const size_t payload = w.bytes.size() - kHeaderBytes;
+        const uint32_t crc   = crc32 (w.bytes.data() + kHeaderBytes, payload);
+        for (int i = 0; i < 4; ++i)
+        {
+            w.bytes[8  + (size_t)i] = (uint8_t)((uint32_t)payload >> (8 * i));
+            w.bytes[12 + (size_t)i] = (uint8_t)(crc >> (8 * i));
+        }
+
+        dest.replaceAll (w.bytes.data(), w.bytes.size());
+    }
+
+    // The payload of a checked block, or false if it is not one this build reads
+    bool openBlock (const void* data, size_t size, ByteReader& r)
+    {
+        r = { (const uint8_t*)data, (const uint8_t*)data + size };
+        if (size < kHeaderBytes || r.u32() != kMagic)
+            return false;
+
+        r.u16();                                // writer version (informational)
+        const int oldestReader = (int)r.u16();
+        const uint32_t payload = r.u32();
+        const uint32_t crc     = r.u32();
+
+        if (oldestReader > kVersion || payload > r.remaining()
+            || crc32 (r.p, payload) != crc)
+            return false;
+
+        r.end = r.p + payload;
+        return true;
+    }
+}
+
+void write (const SessionState& state, juce::MemoryBlock& dest)
+{
+    ByteWriter w;
+    w.bytes.reserve (4096 + state.chain.size() * 2 + state.patterns.size() * 64);
+
+    beginBlock       (w);
+    writeParams      (w, state);
+    writeLayout      (w, state);
+    writePatterns    (w, state);
+    writeArrangement (w, state);
+    writeEdit        (w, state);
+    writeJournal     (w, state);
+    writeLocks       (w, state, allPatterns (state));
+    writeGrooves     (w, state, allPatterns (state));
+    if (hasSamples (state))
+        writeSamples (w, state);
+    finishBlock      (w, dest);
+}
+
+bool read (const void* data, size_t size, SessionState& state)
+{
+    ByteReader r;
+    return openBlock (data, size, r)
+        && forEachChunk (r, [&] (uint32_t id, ByteReader& chunk)
+           {
+               switch (id)
+               {
+                   case kChunkParams:   readParams      (chunk, state); break;
+                   case kChunkLayout:   readLayout      (chunk, state); break;
+                   case kChunkPatterns: readPatterns    (chunk, state); break;
+                   case kChunkArrange:  readArrangement (chunk, state); break;
+                   case kChunkEdit:     readEdit        (chunk, state); break;
+                   case kChunkJournal:  readJournal     (chunk, state); break;
+                   case kChunkLocks:    readLocks       (chunk, state); break;
+                   case kChunkGrooves:  readGrooves     (chunk, state); break;
+                   case kChunkSamples:  readSamples     (chunk, state); break;
+                   default: break;
+               }
+           });
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+bool writeChanges (const SessionState& from, const SessionState& to, juce::MemoryBlock& dest)
+{
+    ByteWriter w;
+    beginBlock (w);
+    writeParamChanges (w, from, to);
+
+    bool layoutChanged = from.layout.numTracks != to.layout.numTracks;
+    for (int t = 0; t < to.layout.numTracks && !layoutChanged; ++t)
+        layoutChanged = from.layout.voice[(size_t)t] != to.layout.voice[(size_t)t]
+                     || from.trackOutput[(size_t)t] != to.trackOutput[(size_t)t]
+                     || from.layout.midiInNote[(size_t)t] != to.layout.midiInNote[(size_t)t]
+                     || from.layout.midiInChannel[(size_t)t] != to.layout.midiInChannel[(size_t)t];
+    if (layoutChanged)
+        writeLayout (w, to);
+    if (from.samples != to.samples)
+        writeSamples (w, to);
+
+    writePatternChanges (w, from, to);
+    writeChainChanges   (w, from, to);
+    if (from.editPattern != to.editPattern)
+        writeEdit (w, to);
+
+    if (w.bytes.size() == kHeaderBytes)
+        return false;
+    finishBlock (w, dest);
+    return true;
+}
+
+bool applyChanges (const void* data, size_t size, SessionState& state)
+{
+    SessionState next = state;
+    ByteReader r;
+    const bool ok = openBlock (data, size, r)
+        && forEachChunk (r, [&] (uint32_t id, ByteReader& chunk)
+           {
+               switch (id)
+               {
+                   case kChunkParams:     applyParamChanges   (chunk, next); break;
+                   case kChunkLayout:     readLayout          (chunk, next); break;
+                   case kChunkPatternSet: applyPatternChanges (chunk, next); break;
+                   case kChunkChainSet:   applyChainChanges   (chunk, next); break;
+                   case kChunkEdit:       readEdit            (chunk, next); break;
+                   case kChunkLocks:      readLocks           (chunk, next); break;
+                   case kChunkGrooves:    readGrooves         (chunk, next); break;
+                   case kChunkSamples:    readSamples         (chunk, next); break;
+                   default: break;
+               }
+           });
+    if (ok)
+        state = std::move (next);
+    return ok;
+}
+
+size_t blockSize (const void* data, size_t size)
+{
+    ByteReader r { (const uint8_t*)data, (const uint8_t*)data + size };
+    if (size < kHeaderBytes || r.u32() != kMagic)
+        return 0;
+    r.u32();
+    const size_t payload = r.u32();
+    return payload <= size - kHeaderBytes ? kHeaderBytes + payload : 0;
+}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Pattern.h"
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SessionState — everything the plug-in saves, as plain values
+//  Captured on the message thread. Pattern storage is shared with the
+//  PatternBank, not copied, so a capture costs a few hundred pointer copies;
+//  equal pointers mean equal patterns (nullptr = empty pattern).
+// ─────────────────────────────────────────────────────────────────────────────
+struct SessionState
+{
+    struct Param
+    {
+        juce::String id;      // host parameter ID, stable across versions
+        float        value;   // plain (denormalised) value
+    };
+
+    struct Slot
+    {
+        uint32_t pattern = 0;
+        uint32_t repeats = 1;
+        bool operator== (const Slot& o) const { return pattern == o.pattern && repeats == o.repeats; }
+    };
+
+    std::vector<Param>                          params;
+    TrackLayout                                 layout;
+    std::array<uint8_t, MAX_TRACKS>             trackOutput {};
+    std::array<juce::String, MAX_TRACKS>        samples;    // sample file path per track ("" = none)
+    std::vector<std::shared_ptr<const Pattern>> patterns;
+    std::vector<Slot>                           chain;      // active slots only
+    bool                                        loopMode    = true;
+    int                                         editPattern = 0;
+
+    // Edit journal this state was saved from, and its last record then
+    juce::String                                journalId;
+    uint32_t                                    journalSeq  = 0;
+
+    bool operator== (const SessionState& o) const;
+    bool operator!= (const SessionState& o) const { return !(*this == o); }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  StateFormat — versioned, chunked, checksummed binary state
+//
+//    header  'OBS2' | u16 version | u16 oldest reader version | u32 payload
+//            bytes | u32 CRC-32 of the payload
+//    payload chunks: u32 id | u16 chunk version | u32 size | size bytes
+//
+//  Readers skip chunks they do not know, and read the fields they know from
+//  a newer version of a chunk they do (chunks only ever grow at the end), so
+//  old and new builds load each other's states. A format change that old
+//  readers must not attempt raises the "oldest reader" field instead.
+//  Little-endian throughout; counts and indices are varints; steps are
+//  bit-packed up to the highest set step and notes take 3 bits each.
+// ─────────────────────────────────────────────────────────────────────────────
+namespace StateFormat
+{
+    static constexpr uint32_t kMagic   = 0x3253424F;   // "OBS2"
+    static constexpr int      kVersion = 1;
+
+    // Does the block start with this format's header?
+    bool isStateFormat (const void* data, size_t size);
+
+    void write (const SessionState& state, juce::MemoryBlock& dest);
+
+    // False if the block is not this format, fails its checksum or needs a
+    // newer reader; `state` is only complete when this returns true
+    bool read (const void* data, size_t size, SessionState& state);
+
+    // A block in this format holding only what differs from `from` to `to`
+    // (parameters, layout, sample files, patterns, a span of the chain, edit
+    // pattern);
+    // false, and nothing written, if they are equal
+    bool writeChanges (const SessionState& from, const SessionState& to, juce::MemoryBlock& dest);
+
+    // Apply a writeChanges() block over a complete state; false, and the
+    // state untouched, if the block is damaged
+    bool applyChanges (const void* data, size_t size, SessionState& state);
+
+    // Bytes taken by the block starting at data, header included, or 0 if
+    // no complete block starts there
+    size_t blockSize (const void* data, size_t size);
+
+    uint32_t crc32 (const uint8_t* data, size_t size);
+}
@@ -4,11 +4,15 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include "Pattern.h"
+#include "SamplePool.h"
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  OBSTACLE — Sound Engine
-//  6 voice types: Kick, Snare, Hihat, Bass, Lead, Pad
-//  FX chain: LP filter → soft clip → dotted-8th delay → 4s reverb → compressor
+//  7 voice types: Kick, Snare, Hihat, Bass, Lead, Pad, Sample — one bank of
+//  up to MAX_TRACKS voices each
+//  FX chain: LP filter → soft clip → dotted-8th delay and 4s reverb sends
+//  → compressor
 // ─────────────────────────────────────────────────────────────────────────────
 
 static constexpr float kTwoPi = 6.283185307179586f;
@@ -53,7 +57,10 @@ struct Env
     void release()  { if (phase != Idle) phase = Release; }
     bool isActive() const { return phase != Idle; }
 
-    float tick()
+    float tick() { return tick(phase, val, a, d, su, r, sr); }
+
+    // Stateless form, for envelopes stored as separate arrays (voice banks)
+    static float tick(Phase& phase, float& val, float a, float d, float su, float r, float sr)
     {
         switch (phase)
         {
@@ -78,428 +85,735 @@ struct Env
 };
 
 // ═════════════════════════════════════════════════════════════════════════════
-//  KICK VOICE
-//  click transient 1200 Hz + sub sine sweep 180→28 Hz + noise thump
+//  VOICE BANKS
+//  One bank per voice type, state stored as struct-of-arrays. Slot v of every
+//  bank belongs to track v, so a track can change voice type without moving
+//  any state. Each bank keeps a dense list of sounding slots and renders
+//  voice-major over the block (state in registers, one pass per voice):
+//  per-sample cost follows the voices that are sounding, not the track count.
+//
+//  trigger() takes how late its first sample is after the trigger's exact
+//  time (0-1 samples) and starts the voice as it is by then: oscillator
+//  phases, envelopes and pitch / filter sweeps are all advanced by that
+//  much, so notes keep their sub-sample position. A trigger resets every
+//  part of the voice, so its sound depends on nothing before it. Banks, like
+//  the FX chain, are plain values: a copy is a snapshot of their state.
 // ═════════════════════════════════════════════════════════════════════════════
-struct KickVoice
+static constexpr int kVoicesPerBank = MAX_TRACKS;
+static_assert(kVoicesPerBank <= 32, "active mask is 32 bits");
+
+template <typename Derived>
+class VoiceBank
 {
-    float sr = 44100.f;
-    float subPhase = 0.f;
-    float clickPhase = 0.f;
-    float envSub = 0.f;
-    float envClick = 0.f;
-    float envNoise = 0.f;
-    float noiseLP = 0.f;
-    bool active = false;
-    float t = 0.f;
+public:
+    VoiceBank() { level.fill(1.f); }
 
-    // Settable
-    float subDecayTime = 0.40f;
-    void setDecay(float d) { subDecayTime = juce::jlimit(0.10f, 1.50f, d); }
+    void prepare(float sampleRate) { sr = sampleRate; numActive = 0; activeMask = 0; }
 
-    juce::Random rng;
+    void stop(int v)
+    {
+        for (int k = 0; k < numActive; ++k)
+            if (active[k] == v) { removeAt(k); return; }
+    }
+
+    bool isActive(int v) const { return (activeMask >> v) & 1u; }
+    int  getNumActive() const  { return numActive; }
+    int  getActiveVoice(int k) const { return active[k]; }
 
-    void prepare(float sampleRate) { sr = sampleRate; }
+    // Gain of the note slot v plays (a played note's velocity), until its next trigger
+    void  setLevel(int v, float g) { level[v] = g; }
+    float getLevel(int v) const    { return level[v]; }
 
-    void trigger()
+    // Adds every sounding voice × gains[v] × its level into dest[v][0, n)
+    void render(float* const* dest, int n, const float* gains)
     {
-        active = true;
-        t = 0.f;
-        subPhase = 0.f;
-        clickPhase = 0.f;
-        envSub = 1.f;
-        envClick = 1.f;
-        envNoise = 1.f;
-        noiseLP = 0.f;
+        for (int k = 0; k < numActive;)
+        {
+            const int v = active[k];
+            if (static_cast<Derived*>(this)->renderVoice(v, dest[v], n, gains[v] * level[v])) ++k;
+            else removeAt(k);
+        }
     }
 
-    float process()
-    {
-        if (!active) return 0.f;
+protected:
+    // Phase an oscillator at `freq` has advanced `late` samples after its start
+    float phaseAt(float freq, float late) const { return kTwoPi * freq * late / sr; }
 
-        float dt = 1.f / sr;
+    // Level of a linear decay from 1 / attack from 0 over `seconds`, `late` samples in
+    float decayAt(float seconds, float late)  const { return 1.f - late / (seconds * sr); }
+    float attackAt(float seconds, float late) const { return late / (seconds * sr); }
 
-        // sub sine sweep 180 → 28 Hz over 300ms
-        float sweepTime = 0.30f;
-        float freq = lerp(180.f, 28.f, juce::jlimit(0.f, 1.f, t / sweepTime));
-        subPhase += kTwoPi * freq * dt;
-        if (subPhase > kTwoPi) subPhase -= kTwoPi;
-        float subOut = std::sin(subPhase) * envSub;
+    void start(int v)
+    {
+        if (isActive(v)) return;
+        activeMask |= 1u << v;
+        active[numActive++] = (uint8_t)v;
+    }
 
-        // click transient 1200 Hz, decay 8ms
-        clickPhase += kTwoPi * 1200.f * dt;
-        if (clickPhase > kTwoPi) clickPhase -= kTwoPi;
-        float clickOut = std::sin(clickPhase) * envClick * 0.7f;
+    float sr = 44100.f;
 
-        // noise thump through one-pole LP, decay 40ms
-        float noise = rng.nextFloat() * 2.f - 1.f;
-        noiseLP += 0.15f * (noise - noiseLP);
-        float noiseOut = noiseLP * envNoise * 0.4f;
+private:
+    void removeAt(int k)
+    {
+        activeMask &= ~(1u << active[k]);
+        active[k] = active[--numActive];
+    }
 
-        // envelopes
-        envSub   -= dt / subDecayTime;
-        envClick -= dt / 0.008f;
-        envNoise -= dt / 0.04f;
+    std::array<uint8_t, kVoicesPerBank> active {};
+    int      numActive  = 0;
+    uint32_t activeMask = 0;
 
-        envSub   = juce::jmax(0.f, envSub);
-        envClick = juce::jmax(0.f, envClick);
-        envNoise = juce::jmax(0.f, envNoise);
+    std::array<float, kVoicesPerBank> level;
+};
 
-        t += dt;
-        if (envSub <= 0.f) active = false;
+template <typename T> using VoiceArray = std::array<T, kVoicesPerBank>;
 
-        return (subOut + clickOut + noiseOut) * 0.6f;
-    }
-};
+// Noise restarts at every trigger from a seed made of the voice type, the
+// slot and the trigger's clock sample: a voice depends only on its last
+// trigger, so a render repeats sample for sample whichever other tracks play
+// alongside (offline stems) and wherever it started (offline segments)
+inline juce::int64 noiseSeed(int voiceType, int v, int64_t when)
+{
+    uint64_t z = (uint64_t)when * 0x9E3779B97F4A7C15ull + (uint64_t)(voiceType * kVoicesPerBank + v + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;   // splitmix64: nearby seeds, unrelated noise
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (juce::int64)(z ^ (z >> 31));
+}
 
 // ═════════════════════════════════════════════════════════════════════════════
-//  SNARE VOICE
-//  noise HPF/bandpass + tone with pitch drop
+//  KICK
+//  click transient 1200 Hz + sub sine sweep 180→28 Hz + noise thump
 // ═════════════════════════════════════════════════════════════════════════════
-struct SnareVoice
+class KickBank : public VoiceBank<KickBank>
 {
-    float sr = 44100.f;
-    float tonePhase = 0.f;
-    float envTone = 0.f;
-    float envNoise = 0.f;
-    bool active = false;
-    float t = 0.f;
+public:
+    KickBank() { subDecayTime.fill(0.40f); }
 
-    // simple 2-pole HPF state
-    float hp1 = 0.f, hp2 = 0.f;
-    float bp1 = 0.f, bp2 = 0.f;
+    void setDecay(int v, float d) { subDecayTime[v] = juce::jlimit(0.10f, 1.50f, d); }
 
-    // Settable
-    float noiseDecayTime = 0.18f;
-    void setDecay(float d) { noiseDecayTime = juce::jlimit(0.05f, 0.50f, d); }
+    void trigger(int v, float late = 0.f, juce::int64 seed = 0)
+    {
+        rng[v].setSeed(seed);
+        t[v] = late / sr;   // position on the pitch sweep
+        subPhase[v]   = phaseAt(180.f, late);
+        clickPhase[v] = phaseAt(1200.f, late);
+        envSub[v]   = decayAt(subDecayTime[v], late);
+        envClick[v] = decayAt(0.008f, late);
+        envNoise[v] = decayAt(0.04f, late);
+        noiseLP[v] = 0.f;
+        start(v);
+    }
 
-    juce::Random rng;
+    bool renderVoice(int v, float* mix, int n, float gain)
+    {
+        const float dt = 1.f / sr;
+        const float subDecay = subDecayTime[v];
+        float sp = subPhase[v], cp = clickPhase[v], lp = noiseLP[v], tt = t[v];
+        float es = envSub[v], ec = envClick[v], en = envNoise[v];
+        bool alive = true;
 
-    void prepare(float sampleRate) { sr = sampleRate; }
+        for (int i = 0; i < n; ++i)
+        {
+            // sub sine sweep 180 → 28 Hz over 300ms
+            float freq = lerp(180.f, 28.f, juce::jlimit(0.f, 1.f, tt / 0.30f));
+            sp += kTwoPi * freq * dt;
+            if (sp > kTwoPi) sp -= kTwoPi;
+            float subOut = std::sin(sp) * es;
+
+            // click transient 1200 Hz, decay 8ms
+            cp += kTwoPi * 1200.f * dt;
+            if (cp > kTwoPi) cp -= kTwoPi;
+            float clickOut = std::sin(cp) * ec * 0.7f;
+
+            // noise thump through one-pole LP, decay 40ms
+            float noise = rng[v].nextFloat() * 2.f - 1.f;
+            lp += 0.15f * (noise - lp);
+            float noiseOut = lp * en * 0.4f;
+
+            es = juce::jmax(0.f, es - dt / subDecay);
+            ec = juce::jmax(0.f, ec - dt / 0.008f);
+            en = juce::jmax(0.f, en - dt / 0.04f);
+            tt += dt;
+
+            mix[i] += (subOut + clickOut + noiseOut) * 0.6f * gain;
+            if (es <= 0.f) { alive = false; break; }
+        }
 
-    void trigger()
-    {
-        active = true;
-        t = 0.f;
-        tonePhase = 0.f;
-        envTone = 1.f;
-        envNoise = 1.f;
-        hp1 = hp2 = bp1 = bp2 = 0.f;
+        subPhase[v] = sp; clickPhase[v] = cp; noiseLP[v] = lp; t[v] = tt;
+        envSub[v] = es; envClick[v] = ec; envNoise[v] = en;
+        return alive;
     }
 
-    // Simple 2-pole HPF (Chamberlin state variable)
-    float hpf(float in, float cutHz)
+private:
+    VoiceArray<float> subPhase {}, clickPhase {}, envSub {}, envClick {}, envNoise {}, noiseLP {}, t {};
+    VoiceArray<float> subDecayTime;
+    VoiceArray<juce::Random> rng;   // per slot: slots may render on different threads
+};
+
+// ═════════════════════════════════════════════════════════════════════════════
+//  SNARE
+//  noise HPF/bandpass + tone with pitch drop
+// ═════════════════════════════════════════════════════════════════════════════
+class SnareBank : public VoiceBank<SnareBank>
+{
+public:
+    SnareBank() { noiseDecayTime.fill(0.18f); }
+
+    void setDecay(int v, float d) { noiseDecayTime[v] = juce::jlimit(0.05f, 0.50f, d); }
+
+    void trigger(int v, float late = 0.f, juce::int64 seed = 0)
     {
-        float f = 2.f * std::sin(juce::MathConstants<float>::pi * cutHz / sr);
-        float q = 1.4f;
-        float lp = bp2 + f * hp2;
-        float high = in - lp - q * bp2;
-        float band = f * high + bp2;
-        bp2 = band; hp2 = high;
-        return high;
+        rng[v].setSeed(seed);
+        t[v] = late / sr;   // position on the pitch drop
+        tonePhase[v] = phaseAt(220.f, late);
+        envTone[v]  = decayAt(0.12f, late);
+        envNoise[v] = decayAt(noiseDecayTime[v], late);
+        hp[v] = bp[v] = 0.f;
+        start(v);
     }
 
-    float process()
+    bool renderVoice(int v, float* mix, int n, float gain)
     {
-        if (!active) return 0.f;
-
-        float dt = 1.f / sr;
-
-        // tone: starts at 220 Hz drops to 80 Hz over 60ms
-        float freq = lerp(220.f, 80.f, juce::jlimit(0.f, 1.f, t / 0.06f));
-        tonePhase += kTwoPi * freq * dt;
-        if (tonePhase > kTwoPi) tonePhase -= kTwoPi;
-        float toneOut = std::sin(tonePhase) * envTone * 0.5f;
+        const float dt = 1.f / sr;
+        const float noiseDecay = noiseDecayTime[v];
 
-        // noise through HPF at 1200 Hz
-        float noise = rng.nextFloat() * 2.f - 1.f;
-        float noiseHP = hpf(noise, 1200.f);
-        float noiseOut = noiseHP * envNoise * 0.6f;
+        // 2-pole HPF at 1200 Hz (Chamberlin state variable)
+        const float f = 2.f * std::sin(juce::MathConstants<float>::pi * 1200.f / sr);
+        const float q = 1.4f;
 
-        envTone  -= dt / 0.12f;
-        envNoise -= dt / noiseDecayTime;
-        envTone  = juce::jmax(0.f, envTone);
-        envNoise = juce::jmax(0.f, envNoise);
+        float ph = tonePhase[v], et = envTone[v], enz = envNoise[v], tt = t[v];
+        float hp2 = hp[v], bp2 = bp[v];
+        bool alive = true;
 
-        t += dt;
-        if (envNoise <= 0.f) active = false;
+        for (int i = 0; i < n; ++i)
+        {
+            // tone: starts at 220 Hz drops to 80 Hz over 60ms
+            float freq = lerp(220.f, 80.f, juce::jlimit(0.f, 1.f, tt / 0.06f));
+            ph += kTwoPi * freq * dt;
+            if (ph > kTwoPi) ph -= kTwoPi;
+            float toneOut = std::sin(ph) * et * 0.5f;
+
+            float noise = rng[v].nextFloat() * 2.f - 1.f;
+            float low  = bp2 + f * hp2;
+            float high = noise - low - q * bp2;
+            bp2 = f * high + bp2;
+            hp2 = high;
+            float noiseOut = high * enz * 0.6f;
+
+            et  = juce::jmax(0.f, et  - dt / 0.12f);
+            enz = juce::jmax(0.f, enz - dt / noiseDecay);
+            tt += dt;
+
+            mix[i] += (toneOut + noiseOut) * 0.55f * gain;
+            if (enz <= 0.f) { alive = false; break; }
+        }
 
-        return (toneOut + noiseOut) * 0.55f;
+        tonePhase[v] = ph; envTone[v] = et; envNoise[v] = enz; t[v] = tt;
+        hp[v] = hp2; bp[v] = bp2;
+        return alive;
     }
+
+private:
+    VoiceArray<float> tonePhase {}, envTone {}, envNoise {}, t {}, hp {}, bp {};
+    VoiceArray<float> noiseDecayTime;
+    VoiceArray<juce::Random> rng;
 };
 
 // ═════════════════════════════════════════════════════════════════════════════
-//  HIHAT VOICE
+//  HIHAT
 //  5 detuned square oscillators + noise HPF 9kHz+
 // ═════════════════════════════════════════════════════════════════════════════
-struct HihatVoice
+class HihatBank : public VoiceBank<HihatBank>
 {
-    float sr = 44100.f;
-    std::array<float, 5> phases{};
-    float env = 0.f;
-    bool active = false;
-    bool isOpen = false;
-
-    // HPF state for noise
-    float hpState = 0.f;
-    juce::Random rng;
-
-    // base freqs in "metallic" ratio
-    const std::array<float, 5> freqMults = { 1.0f, 1.483f, 1.727f, 2.017f, 2.278f };
-    static constexpr float baseFreq = 3200.f;
-
-    // Settable
-    float chDecayTime = 0.06f;
-    void setDecay(float d) { chDecayTime = juce::jlimit(0.01f, 0.30f, d); }
+public:
+    HihatBank() { chDecayTime.fill(0.06f); }
 
-    void prepare(float sampleRate) { sr = sampleRate; }
+    void setDecay(int v, float d) { chDecayTime[v] = juce::jlimit(0.01f, 0.30f, d); }
 
-    void trigger(bool open = false)
+    void trigger(int v, bool open = false, float late = 0.f, juce::int64 seed = 0)
     {
-        active = true;
-        isOpen = open;
-        env = 1.f;
-        hpState = 0.f;
-        for (auto& p : phases) p = 0.f;
+        rng[v].setSeed(seed);
+        isOpen[v] = open;
+        env[v] = decayAt(open ? 0.35f : chDecayTime[v], late);
+        hpState[v] = 0.f;
+        for (int o = 0; o < 5; ++o) phases[o][v] = phaseAt(baseFreq * freqMults[o], late);
+        start(v);
     }
 
-    float process()
+    bool renderVoice(int v, float* mix, int n, float gain)
     {
-        if (!active) return 0.f;
+        const float dt    = 1.f / sr;
+        const float alpha = 1.f - std::exp(-kTwoPi * 9000.f / sr);
+        const float decay = isOpen[v] ? 0.35f : chDecayTime[v];
 
-        float dt = 1.f / sr;
-        float out = 0.f;
+        std::array<float, 5> ph;
+        for (int o = 0; o < 5; ++o) ph[o] = phases[o][v];
+        float e = env[v], hs = hpState[v];
+        bool alive = true;
 
-        // 5 detuned square oscillators
-        for (int i = 0; i < 5; ++i)
+        for (int i = 0; i < n; ++i)
         {
-            phases[i] += kTwoPi * baseFreq * freqMults[i] * dt;
-            if (phases[i] > kTwoPi) phases[i] -= kTwoPi;
-            out += (phases[i] < juce::MathConstants<float>::pi ? 1.f : -1.f);
+            float out = 0.f;
+            for (int o = 0; o < 5; ++o)
+            {
+                ph[o] += kTwoPi * baseFreq * freqMults[o] * dt;
+                if (ph[o] > kTwoPi) ph[o] -= kTwoPi;
+                out += (ph[o] < juce::MathConstants<float>::pi ? 1.f : -1.f);
+            }
+            out *= 0.5f / 5.f;
+
+            float noise = rng[v].nextFloat() * 2.f - 1.f;
+            hs += alpha * (noise - hs);
+            out += (noise - hs) * 0.4f;
+
+            mix[i] += out * e * 0.35f * gain;
+
+            e -= dt / decay;
+            if (e <= 0.f) { e = 0.f; alive = false; break; }
         }
-        out /= 5.f;
-        out *= 0.5f;
 
-        // noise HPF at 9kHz
-        float noise = rng.nextFloat() * 2.f - 1.f;
-        float alpha = 1.f - std::exp(-kTwoPi * 9000.f / sr);
-        hpState += alpha * (noise - hpState);
-        float noiseHP = noise - hpState;
-        out += noiseHP * 0.4f;
-
-        out *= env;
+        for (int o = 0; o < 5; ++o) phases[o][v] = ph[o];
+        env[v] = e; hpState[v] = hs;
+        return alive;
+    }
 
-        float decayTime = isOpen ? 0.35f : chDecayTime;
-        env -= dt / decayTime;
-        if (env <= 0.f) { env = 0.f; active = false; }
+private:
+    static constexpr float baseFreq = 3200.f;
+    static constexpr std::array<float, 5> freqMults = { 1.0f, 1.483f, 1.727f, 2.017f, 2.278f };
 
-        return out * 0.35f;
-    }
+    std::array<VoiceArray<float>, 5> phases {};
+    VoiceArray<float> env {}, hpState {};
+    VoiceArray<bool>  isOpen {};
+    VoiceArray<float> chDecayTime;
+    VoiceArray<juce::Random> rng;
 };
 
 // ═════════════════════════════════════════════════════════════════════════════
-//  BASS VOICE  (Trentemøller style)
+//  BASS  (Trentemøller style)
 //  2x detuned sawtooth + sub sine + filter envelope opens→closes
 // ═════════════════════════════════════════════════════════════════════════════
-struct BassVoice
+class BassBank : public VoiceBank<BassBank>
 {
-    float sr = 44100.f;
-    float phase1 = 0.f, phase2 = 0.f, subPhase = 0.f;
-    float envAmp = 0.f;
-    float filterEnv = 0.f;
-    float filterState = 0.f;
-    bool active = false;
-    float t = 0.f;
-    float noteFreq = 55.f;
-
-    // Settable: 0=dark/closed, 1=full brightness
-    float filterOpenAmt = 1.0f;
-    void setFilterOpen(float v) { filterOpenAmt = juce::jlimit(0.f, 1.f, v); }
+public:
+    BassBank() { filterOpenAmt.fill(1.0f); noteFreq.fill(55.f); }
 
-    void prepare(float sampleRate) { sr = sampleRate; }
+    // 0=dark/closed, 1=full brightness
+    void setFilterOpen(int v, float x) { filterOpenAmt[v] = juce::jlimit(0.f, 1.f, x); }
 
-    void trigger(float freq = 55.f)
+    void trigger(int v, float freq = 55.f, float late = 0.f)
     {
-        active = true;
-        noteFreq = freq;
-        t = 0.f;
-        phase1 = phase2 = subPhase = 0.f;
-        envAmp = 1.f;
-        filterEnv = 0.f;
-        filterState = 0.f;
+        noteFreq[v] = freq;
+        t[v] = late / sr;   // position on the filter and amp envelopes
+        phase1[v]   = phaseAt(freq, late);
+        phase2[v]   = phaseAt(freq * 1.012f, late);
+        subPhase[v] = phaseAt(freq * 0.5f, late);
+        envAmp[v] = 1.f;
+        filterState[v] = -0.8f * 0.003f * late;   // closed filter, `late` samples into the saws' -1 start
+        start(v);
     }
 
-    float process()
+    bool renderVoice(int v, float* mix, int n, float gain)
     {
-        if (!active) return 0.f;
+        const float dt       = 1.f / sr;
+        const float pi       = juce::MathConstants<float>::pi;
+        const float freq     = noteFreq[v];
+        const float detuneHz = freq * 0.012f;
+        const float open     = filterOpenAmt[v];
 
-        float dt = 1.f / sr;
-        float detuneHz = noteFreq * 0.012f;
+        float p1 = phase1[v], p2 = phase2[v], ps = subPhase[v];
+        float amp = envAmp[v], fs = filterState[v], tt = t[v];
+        bool alive = true;
 
-        phase1 += kTwoPi * noteFreq * dt;
-        phase2 += kTwoPi * (noteFreq + detuneHz) * dt;
-        if (phase1 > kTwoPi) phase1 -= kTwoPi;
-        if (phase2 > kTwoPi) phase2 -= kTwoPi;
+        for (int i = 0; i < n; ++i)
+        {
+            p1 += kTwoPi * freq * dt;
+            p2 += kTwoPi * (freq + detuneHz) * dt;
+            if (p1 > kTwoPi) p1 -= kTwoPi;
+            if (p2 > kTwoPi) p2 -= kTwoPi;
 
-        float saw1 = phase1 / juce::MathConstants<float>::pi - 1.f;
-        float saw2 = phase2 / juce::MathConstants<float>::pi - 1.f;
+            float saw1 = p1 / pi - 1.f;
+            float saw2 = p2 / pi - 1.f;
 
-        subPhase += kTwoPi * (noteFreq * 0.5f) * dt;
-        if (subPhase > kTwoPi) subPhase -= kTwoPi;
-        float sub = std::sin(subPhase) * 0.6f;
+            ps += kTwoPi * (freq * 0.5f) * dt;
+            if (ps > kTwoPi) ps -= kTwoPi;
+            float sub = std::sin(ps) * 0.6f;
 
-        float rawOut = (saw1 + saw2) * 0.4f + sub;
+            float rawOut = (saw1 + saw2) * 0.4f + sub;
 
-        float attackTime  = 0.02f;
-        float decayTime   = 0.22f;
-        if (t < attackTime)
-            filterEnv = t / attackTime;
-        else
-            filterEnv = juce::jmax(0.f, 1.f - (t - attackTime) / decayTime);
+            // filter envelope: 20ms attack, 220ms decay
+            float filterEnv = (tt < 0.02f) ? tt / 0.02f
+                                           : juce::jmax(0.f, 1.f - (tt - 0.02f) / 0.22f);
 
-        // cutoff range scaled by filterOpenAmt
-        float cutNorm = 0.003f + filterEnv * (filterOpenAmt * 0.18f);
-        filterState += cutNorm * (rawOut - filterState);
-        float filtOut = filterState;
+            float cutNorm = 0.003f + filterEnv * (open * 0.18f);
+            fs += cutNorm * (rawOut - fs);
 
-        filtOut *= envAmp;
+            mix[i] += fs * amp * 0.7f * gain;
 
-        float holdTime = 0.25f;
-        float releaseTime = 0.3f;
-        if (t > holdTime)
-            envAmp = juce::jmax(0.f, 1.f - (t - holdTime) / releaseTime);
+            // 250ms hold, 300ms release
+            if (tt > 0.25f)
+                amp = juce::jmax(0.f, 1.f - (tt - 0.25f) / 0.3f);
 
-        t += dt;
-        if (envAmp <= 0.f) active = false;
+            tt += dt;
+            if (amp <= 0.f) { alive = false; break; }
+        }
 
-        return filtOut * 0.7f;
+        phase1[v] = p1; phase2[v] = p2; subPhase[v] = ps;
+        envAmp[v] = amp; filterState[v] = fs; t[v] = tt;
+        return alive;
     }
+
+private:
+    VoiceArray<float> phase1 {}, phase2 {}, subPhase {}, envAmp {}, filterState {}, t {};
+    VoiceArray<float> noteFreq, filterOpenAmt;
 };
 
 // ═════════════════════════════════════════════════════════════════════════════
-//  LEAD VOICE
+//  LEAD
 //  2x micro-detuned sawtooth + 0.8 Hz vibrato LFO + square sub-octave
 // ═════════════════════════════════════════════════════════════════════════════
-struct LeadVoice
+class LeadBank : public VoiceBank<LeadBank>
 {
-    float sr = 44100.f;
-    float phase1 = 0.f, phase2 = 0.f, subPhase = 0.f;
-    float lfoPhase = 0.f;
-    Env ampEnv;
-    bool active = false;
-    float noteFreq = 220.f;
+public:
+    LeadBank() { attack.fill(0.12f); noteFreq.fill(220.f); envPhase.fill(Env::Idle); }
 
-    // Settable
-    void setAttack(float a) { ampEnv.a = juce::jlimit(0.001f, 0.50f, a); }
+    void setAttack(int v, float a) { attack[v] = juce::jlimit(0.001f, 0.50f, a); }
 
-    void prepare(float sampleRate)
+    void trigger(int v, float freq = 220.f, float late = 0.f)
     {
-        sr = sampleRate;
-        ampEnv.setSampleRate(sampleRate);
-        ampEnv.setADSR(0.12f, 0.1f, 0.7f, 0.4f);
+        noteFreq[v] = freq;
+        phase1[v]   = phaseAt(freq, late);
+        phase2[v]   = phaseAt(freq * 1.003f, late);
+        subPhase[v] = phaseAt(freq * 0.5f, late);
+        lfoPhase[v] = phaseAt(0.8f, late);   // vibrato restarts with the note
+        envPhase[v] = Env::Attack;
+        envVal[v]   = attackAt(attack[v], late);
+        start(v);
     }
 
-    void trigger(float freq = 220.f)
+    void noteOff(int v) { if (envPhase[v] != Env::Idle) envPhase[v] = Env::Release; }
+
+    bool renderVoice(int v, float* mix, int n, float gain)
     {
-        active = true;
-        noteFreq = freq;
-        phase1 = phase2 = subPhase = 0.f;
-        ampEnv.trigger();
-    }
+        const float dt   = 1.f / sr;
+        const float pi   = juce::MathConstants<float>::pi;
+        const float freq = noteFreq[v];
+        const float a    = attack[v];
 
-    void noteOff() { ampEnv.release(); }
+        float p1 = phase1[v], p2 = phase2[v], ps = subPhase[v], lfoPh = lfoPhase[v];
+        Env::Phase eph = envPhase[v];
+        float ev = envVal[v];
+        bool alive = true;
 
-    float process()
-    {
-        if (!active) return 0.f;
+        for (int i = 0; i < n; ++i)
+        {
+            lfoPh += kTwoPi * 0.8f * dt;
+            if (lfoPh > kTwoPi) lfoPh -= kTwoPi;
+            float lfo = std::sin(lfoPh) * 4.f;
+
+            p1 += kTwoPi * (freq + lfo) * dt;
+            p2 += kTwoPi * (freq * 1.003f + lfo) * dt;
+            if (p1 > kTwoPi) p1 -= kTwoPi;
+            if (p2 > kTwoPi) p2 -= kTwoPi;
+
+            float saw1 = p1 / pi - 1.f;
+            float saw2 = p2 / pi - 1.f;
+
+            ps += kTwoPi * (freq * 0.5f) * dt;
+            if (ps > kTwoPi) ps -= kTwoPi;
+            float sq = (ps < pi) ? 0.5f : -0.5f;
 
-        float dt = 1.f / sr;
+            float env = Env::tick(eph, ev, a, 0.1f, 0.7f, 0.4f, sr);
+            mix[i] += ((saw1 + saw2) * 0.4f + sq * 0.25f) * env * 0.55f * gain;
+            if (eph == Env::Idle) { alive = false; break; }
+        }
+
+        phase1[v] = p1; phase2[v] = p2; subPhase[v] = ps; lfoPhase[v] = lfoPh;
+        envPhase[v] = eph; envVal[v] = ev;
+        return alive;
+    }
+
+private:
+    VoiceArray<float> phase1 {}, phase2 {}, subPhase {}, lfoPhase {}, envVal {};
+    VoiceArray<Env::Phase> envPhase;
+    VoiceArray<float> noteFreq, attack;
+};
+
+// ═════════════════════════════════════════════════════════════════════════════
+//  PAD
+//  4-voice detuned sine cluster, slow attack
+// ═════════════════════════════════════════════════════════════════════════════
+class PadBank : public VoiceBank<PadBank>
+{
+public:
+    PadBank() { attack.fill(1.5f); noteFreq.fill(110.f); envPhase.fill(Env::Idle); }
 
-        lfoPhase += kTwoPi * 0.8f * dt;
-        if (lfoPhase > kTwoPi) lfoPhase -= kTwoPi;
-        float lfo = std::sin(lfoPhase) * 4.f;
+    void setAttack(int v, float a) { attack[v] = juce::jlimit(0.05f, 5.0f, a); }
 
-        float f1 = noteFreq + lfo;
-        float f2 = noteFreq * 1.003f + lfo;
+    void trigger(int v, float freq = 110.f, float late = 0.f)
+    {
+        noteFreq[v] = freq;
+        for (int o = 0; o < 4; ++o) phases[o][v] = phaseAt(freq * detunes[o], late);
+        envPhase[v] = Env::Attack;
+        envVal[v]   = attackAt(attack[v], late);
+        start(v);
+    }
 
-        phase1 += kTwoPi * f1 * dt;
-        phase2 += kTwoPi * f2 * dt;
-        if (phase1 > kTwoPi) phase1 -= kTwoPi;
-        if (phase2 > kTwoPi) phase2 -= kTwoPi;
+    void noteOff(int v) { if (envPhase[v] != Env::Idle) envPhase[v] = Env::Release; }
 
-        float saw1 = phase1 / juce::MathConstants<float>::pi - 1.f;
-        float saw2 = phase2 / juce::MathConstants<float>::pi - 1.f;
+    bool renderVoice(int v, float* mix, int n, float gain)
+    {
+        const float dt = 1.f / sr;
+        const float a  = attack[v];
 
-        subPhase += kTwoPi * (noteFreq * 0.5f) * dt;
-        if (subPhase > kTwoPi) subPhase -= kTwoPi;
-        float sq = (subPhase < juce::MathConstants<float>::pi) ? 0.5f : -0.5f;
+        std::array<float, 4> inc, ph;
+        for (int o = 0; o < 4; ++o)
+        {
+            inc[o] = kTwoPi * noteFreq[v] * detunes[o] * dt;
+            ph[o]  = phases[o][v];
+        }
+        Env::Phase eph = envPhase[v];
+        float ev = envVal[v];
+        bool alive = true;
 
-        float env = ampEnv.tick();
-        if (!ampEnv.isActive()) active = false;
+        for (int i = 0; i < n; ++i)
+        {
+            float out = 0.f;
+            for (int o = 0; o < 4; ++o)
+            {
+                ph[o] += inc[o];
+                if (ph[o] > kTwoPi) ph[o] -= kTwoPi;
+                out += std::sin(ph[o]);
+            }
+
+            float env = Env::tick(eph, ev, a, 0.5f, 0.6f, 2.0f, sr);
+            mix[i] += out * 0.25f * env * 0.5f * gain;
+            if (eph == Env::Idle) { alive = false; break; }
+        }
 
-        return ((saw1 + saw2) * 0.4f + sq * 0.25f) * env * 0.55f;
+        for (int o = 0; o < 4; ++o) phases[o][v] = ph[o];
+        envPhase[v] = eph; envVal[v] = ev;
+        return alive;
     }
+
+private:
+    static constexpr std::array<float, 4> detunes = { 0.998f, 1.000f, 1.002f, 1.004f };
+
+    std::array<VoiceArray<float>, 4> phases {};
+    VoiceArray<float> envVal {};
+    VoiceArray<Env::Phase> envPhase;
+    VoiceArray<float> noteFreq, attack;
 };
 
 // ═════════════════════════════════════════════════════════════════════════════
-//  PAD VOICE
-//  4-voice detuned sine cluster, slow attack
+//  SAMPLE
+//  one-shot playback of the track's audio file, read straight from its memory
+//  map (SamplePool) at the file's own rate, linearly interpolated
 // ═════════════════════════════════════════════════════════════════════════════
-struct PadVoice
+class SampleBank : public VoiceBank<SampleBank>
 {
-    float sr = 44100.f;
-    std::array<float, 4> phases{};
-    Env ampEnv;
-    bool active = false;
-    float noteFreq = 110.f;
+public:
+    SampleBank() { length.fill(60.f); }
 
-    const std::array<float, 4> detunes = { 0.998f, 1.000f, 1.002f, 1.004f };
+    // How long a hit plays before a 5 ms fade (seconds)
+    void setLength(int v, float seconds) { length[v] = juce::jlimit(0.02f, 60.f, seconds); }
 
-    // Settable
-    void setAttack(float a) { ampEnv.a = juce::jlimit(0.05f, 5.0f, a); }
+    // The file slot v plays from its next trigger (audio thread, at the start
+    // of every block). A voice still playing another file stops: that file
+    // may be freed once this block is over.
+    void setSource(int v, const SampleSource* s)
+    {
+        if (s == source[v]) return;
+        source[v] = s;
+        stop(v);
+    }
 
-    void prepare(float sampleRate)
+    void trigger(int v, float late = 0.f)
     {
-        sr = sampleRate;
-        ampEnv.setSampleRate(sampleRate);
-        ampEnv.setADSR(1.5f, 0.5f, 0.6f, 2.0f);
+        const auto* s = source[v];
+        if (s == nullptr || s->length == 0) return;
+        step[v] = s->sampleRate / sr;
+        pos[v]  = late * step[v];
+        t[v]    = late / sr;
+        start(v);
     }
 
-    void trigger(float freq = 110.f)
+    // Frame the voice is on, for the prefetch thread (-1: silent)
+    juce::int64 getPosition(int v) const { return isActive(v) ? (juce::int64)pos[v] : -1; }
+
+    bool renderVoice(int v, float* mix, int n, float gain)
     {
-        active = true;
-        noteFreq = freq;
-        for (auto& p : phases) p = 0.f;
-        ampEnv.trigger();
+        const auto* s = source[v];
+        const double inc = step[v];
+        const float  dt  = 1.f / sr;
+        const float  end = length[v];
+        double p  = pos[v];
+        float  tt = t[v];
+
+        auto k = (juce::int64)p;
+        float a = s->mono(k), b = s->mono(k + 1);
+        bool alive = true;
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (k >= s->length || tt > end + kFade) { alive = false; break; }
+
+            const float level = tt > end ? 1.f - (tt - end) / kFade : 1.f;
+            mix[i] += (a + (float)(p - (double)k) * (b - a)) * level * gain;
+
+            p  += inc;
+            tt += dt;
+            while ((juce::int64)p > k)
+            {
+                ++k;
+                a = b;
+                b = s->mono(k + 1);
+            }
+        }
+
+        pos[v] = p; t[v] = tt;
+        return alive;
     }
 
-    void noteOff() { ampEnv.release(); }
+private:
+    static constexpr float kFade = 0.005f;
 
-    float process()
+    VoiceArray<const SampleSource*> source {};
+    VoiceArray<double> pos {}, step {};
+    VoiceArray<float>  t {};
+    VoiceArray<float>  length;
+};
+
+// ═════════════════════════════════════════════════════════════════════════════
+//  VOICE ENGINE — dispatch by voice type, render all banks
+// ═════════════════════════════════════════════════════════════════════════════
+struct VoiceEngine
+{
+    KickBank  kick;
+    SnareBank snare;
+    HihatBank hihat;
+    BassBank  bass;
+    LeadBank  lead;
+    PadBank    pad;
+    SampleBank sample;
+
+    void prepare(float sampleRate)
     {
-        if (!active) return 0.f;
+        kick.prepare(sampleRate);  snare.prepare(sampleRate); hihat.prepare(sampleRate);
+        bass.prepare(sampleRate);  lead.prepare(sampleRate);  pad.prepare(sampleRate);
+        sample.prepare(sampleRate);
+    }
 
-        float dt = 1.f / sr;
-        float out = 0.f;
+    // late: how far past the trigger's exact time the next rendered sample is;
+    // when: the clock sample it plays on (seeds the noise); level: the note's
+    // gain (sequenced hits play at 1, played notes at their velocity)
+    void trigger(int type, int v, float freq, float late = 0.f, int64_t when = 0, float level = 1.f)
+    {
+        switch (type)
+        {
+            case KICK:  kick.trigger(v, late, noiseSeed(KICK, v, when));           kick.setLevel(v, level);   break;
+            case SNARE: snare.trigger(v, late, noiseSeed(SNARE, v, when));         snare.setLevel(v, level);  break;
+            case HIHAT: hihat.trigger(v, false, late, noiseSeed(HIHAT, v, when));  hihat.setLevel(v, level);  break;
+            case BASS:  bass.trigger(v, freq, late);   bass.setLevel(v, level);    break;
+            case LEAD:  lead.trigger(v, freq, late);   lead.setLevel(v, level);    break;
+            case PAD:   pad.trigger(v, freq, late);    pad.setLevel(v, level);     break;
+            case SAMPLE: sample.trigger(v, late);      sample.setLevel(v, level);  break;
+            default: break;
+        }
+    }
 
-        for (int i = 0; i < 4; ++i)
+    void stop(int type, int v)
+    {
+        switch (type)
+        {
+            case KICK:  kick.stop(v);  break;
+            case SNARE: snare.stop(v); break;
+            case HIHAT: hihat.stop(v); break;
+            case BASS:  bass.stop(v);  break;
+            case LEAD:  lead.stop(v);  break;
+            case PAD:   pad.stop(v);   break;
+            case SAMPLE: sample.stop(v); break;
+            default: break;
+        }
+    }
+
+    // Key released: lead and pad fade out; the other voices are one-shots
+    void noteOff(int type, int v)
+    {
+        if (type == LEAD)     lead.noteOff(v);
+        else if (type == PAD) pad.noteOff(v);
+    }
+
+    // The per-track "tone" control: decay, filter openness or attack
+    void setTone(int type, int v, float x)
+    {
+        switch (type)
         {
-            phases[i] += kTwoPi * noteFreq * detunes[i] * dt;
-            if (phases[i] > kTwoPi) phases[i] -= kTwoPi;
-            out += std::sin(phases[i]);
+            case KICK:  kick.setDecay(v, x);      break;
+            case SNARE: snare.setDecay(v, x);     break;
+            case HIHAT: hihat.setDecay(v, x);     break;
+            case BASS:  bass.setFilterOpen(v, x); break;
+            case LEAD:  lead.setAttack(v, x);     break;
+            case PAD:   pad.setAttack(v, x);      break;
+            case SAMPLE: sample.setLength(v, x);  break;
+            default: break;
         }
-        out /= 4.f;
+    }
+
+    // dest[track][0, n) += every sounding voice × gains[track]
+    //  (tracks usually share the one mix buffer; aux-routed tracks have their own)
+    void render(float* const* dest, int n, const float* gains)
+    {
+        kick.render(dest, n, gains);  snare.render(dest, n, gains); hihat.render(dest, n, gains);
+        bass.render(dest, n, gains);  lead.render(dest, n, gains);  pad.render(dest, n, gains);
+        sample.render(dest, n, gains);
+    }
 
-        float env = ampEnv.tick();
-        if (!ampEnv.isActive()) active = false;
+    int getNumActive() const
+    {
+        return kick.getNumActive() + snare.getNumActive() + hihat.getNumActive()
+             + bass.getNumActive() + lead.getNumActive()  + pad.getNumActive()
+             + sample.getNumActive();
+    }
+
+    // ── Per-voice access (parallel rendering) ─────────────────────────────────
+    //  Distinct voices share no state, so any two may render concurrently.
+    //  Bank bookkeeping is not thread-safe: stop() silent voices afterwards.
+    struct VoiceRef { uint8_t type, voice; };
 
-        return out * env * 0.5f;
+    int collectActive(VoiceRef* out) const
+    {
+        int n = 0;
+        auto add = [&] (const auto& bank, int type) {
+            for (int k = 0; k < bank.getNumActive(); ++k)
+                out[n++] = { (uint8_t)type, (uint8_t)bank.getActiveVoice(k) };
+        };
+        add(kick, KICK);  add(snare, SNARE); add(hihat, HIHAT);
+        add(bass, BASS);  add(lead, LEAD);   add(pad, PAD);
+        add(sample, SAMPLE);
+        return n;
+    }
+
+    // mix[0, n) += voice × gain × its level; false once the voice has gone silent
+    bool renderVoice(int type, int v, float* mix, int n, float gain)
+    {
+        switch (type)
+        {
+            case KICK:  return kick.renderVoice(v, mix, n, gain * kick.getLevel(v));
+            case SNARE: return snare.renderVoice(v, mix, n, gain * snare.getLevel(v));
+            case HIHAT: return hihat.renderVoice(v, mix, n, gain * hihat.getLevel(v));
+            case BASS:  return bass.renderVoice(v, mix, n, gain * bass.getLevel(v));
+            case LEAD:  return lead.renderVoice(v, mix, n, gain * lead.getLevel(v));
+            case PAD:   return pad.renderVoice(v, mix, n, gain * pad.getLevel(v));
+            case SAMPLE: return sample.renderVoice(v, mix, n, gain * sample.getLevel(v));
+            default:    return false;
+        }
     }
 };
 
 // ═════════════════════════════════════════════════════════════════════════════
 //  FX CHAIN
-//  LP filter → soft clip → dotted-8th delay → 4s reverb → compressor
+//  LP filter → soft clip, per bus → dotted-8th delay → 4s reverb → compressor
+//  Delay and reverb are shared send buses fed by per-track send levels
 // ═════════════════════════════════════════════════════════════════════════════
 class FXChain
 {
@@ -536,7 +850,7 @@ public:
         delayBuf.assign(int(sr * 2.0f), 0.f);
         delayIdx = 0;
 
-        lpState = 0.f;
+        lpState = lpStateDelay = lpStateReverb = 0.f;
         rmsState = 0.f;
         gainState = 1.f;
     }
@@ -547,32 +861,39 @@ public:
         delaySamples = int((beat * 0.75f) * sr);
     }
 
-    float process(float in)
+    float process(float in) { return process(in, in, in); }
+
+    // Direct bus + delay / reverb send buses. The delay and reverb run once
+    // over the summed sends; the direct bus never enters them. The reverb mix
+    // crossfades only what was sent to the reverb, so the part of the direct
+    // bus that was not keeps its level. With every send at unity the three
+    // inputs are equal and this is the plain insert chain, sample for sample.
+    float process(float direct, float delaySend, float reverbSend)
     {
-        // ── 1. LP filter ────────────────────────────────────────────────────
+        // ── 1. LP filter + 2. soft clip, per bus (shared when buses match) ──
         float alpha = 1.f - std::exp(-kTwoPi * lpCutHz / sr);
-        lpState += alpha * (in - lpState);
-        float x = lpState;
-
-        // ── 2. Soft clip (drive parameter) ─────────────────────────────────
-        x = softClip(x, driveAmt);
+        float x = tone(lpState, direct, alpha);
+        float d = x, r = x;
+        if (delaySend  == direct) lpStateDelay  = lpState; else d = tone(lpStateDelay,  delaySend,  alpha);
+        if (reverbSend == direct) lpStateReverb = lpState; else r = tone(lpStateReverb, reverbSend, alpha);
 
         // ── 3. Dotted-8th delay ─────────────────────────────────────────────
         int dLen = (int)delayBuf.size();
         int readIdx = (delayIdx - juce::jlimit(1, dLen - 1, delaySamples) + dLen) % dLen;
         float delayOut = delayBuf[readIdx];
-        delayBuf[delayIdx] = x + delayOut * delayFbk;
+        delayBuf[delayIdx] = d + delayOut * delayFbk;
         delayIdx = (delayIdx + 1) % dLen;
+        const float unsent = (x - r) * 0.7f;   // direct bus the reverb never sees
         x = x * 0.7f + delayOut * delayMixAmt;
+        r = r * 0.7f + delayOut * delayMixAmt;   // delay return feeds the reverb
 
         // ── 4. Schroeder reverb (4 comb + 2 allpass) ────────────────────────
-        float dryPreRev = x;
         float combOut = 0.f;
         for (int i = 0; i < 4; ++i)
         {
             int len = (int)combDelay[i].size();
             float y = combDelay[i][combIdx[i]];
-            combDelay[i][combIdx[i]] = x + y * combG[i];
+            combDelay[i][combIdx[i]] = r + y * combG[i];
             combIdx[i] = (combIdx[i] + 1) % len;
             combOut += y;
         }
@@ -588,7 +909,7 @@ public:
             combOut = y + w * 0.5f;
         }
 
-        x = dryPreRev * (1.f - reverbMixAmt) + combOut * reverbMixAmt;
+        x = x * (1.f - reverbMixAmt) + combOut * reverbMixAmt + unsent * reverbMixAmt;
 
         // ── 5. Simple RMS compressor ─────────────────────────────────────────
         float rmsTC  = std::exp(-1.f / (0.05f * sr));
@@ -607,19 +928,27 @@ public:
     }
 
 private:
+    // Send filters follow the direct one while their inputs match, so a send
+    // can diverge later without a filter transient
+    float tone(float& state, float in, float alpha)
+    {
+        state += alpha * (in - state);
+        return softClip(state, driveAmt);
+    }
+
     float sr = 44100.f;
-    float lpState = 0.f;
+    float lpState = 0.f, lpStateDelay = 0.f, lpStateReverb = 0.f;
 
     std::vector<float> delayBuf;
     int delayIdx = 0;
     int delaySamples = 0;
 
-    const std::array<float, 4> combTimes = { 0.0297f, 0.0371f, 0.0411f, 0.0437f };
-    const std::array<float, 4> combG     = { 0.805f,  0.827f,  0.783f,  0.764f  };
+    static constexpr std::array<float, 4> combTimes = { 0.0297f, 0.0371f, 0.0411f, 0.0437f };
+    static constexpr std::array<float, 4> combG     = { 0.805f,  0.827f,  0.783f,  0.764f  };
     std::array<std::vector<float>, 4> combDelay;
     std::array<int, 4> combIdx{};
 
-    const std::array<float, 2> apTimes = { 0.0090f, 0.0061f };
+    static constexpr std::array<float, 2> apTimes = { 0.0090f, 0.0061f };
     std::array<std::vector<float>, 2> apDelay;
     std::array<int, 2> apIdx{};
 
@@ -0,0 +1,668 @@
+// ─────────────────────────────────────────────────────────────────────────────
+//  OBSTACLE — offline renderer
+//  Runs the processor without an editor as fast as the machine allows and
+//  streams the song chain, played once from slot 0, to a WAV file. Optionally
+//  writes the trigger stream (the MIDI the plug-in sends to the host) as a
+//  standard MIDI file, and one stem per track. Prints the real-time factor.
+//
+//    obstacle_render [state] [options]
+//
+//      state              a saved plug-in state (host preset / .obstacle blob);
+//                         without one the built-in default session plays
+//      --preset NAME      load a library entry on top (kit or pattern; the
+//                         first whose name contains NAME)
+//      -o, --out FILE     output WAV (default: render.wav)
+//      --midi FILE        also write the trigger stream as a MIDI file
+//      --stems DIR        also write every track as a stem: DIR/01 Kick.wav ...
+//      --stems-fx         stems through the track's own FX chain, not dry
+//      --segments N       split the song at slot boundaries into N segments
+//                         rendered side by side
+//      --preroll S        shortest pre-roll of a segment, for the FX tails
+//                         (seconds, default 8)
+//      --verify           check the stems against a serial render and their
+//                         sum against the dry master, or the segments
+//                         against a serial render
+//      --jobs N           threads (default: all cores)
+//      --rate HZ          sample rate (default 48000)
+//      --block N          block size (default 512)
+//      --bits N           16, 24 or 32 (float) bits per sample (default 24)
+//      --multicore        render voices on the worker pool
+//      --max-seconds S    stop after S seconds of audio (default 3600)
+//
+//  Stems render concurrently, one processor instance per track on its own
+//  thread: each plays the whole sequence with the other tracks muted and its
+//  track on its own output (the plug-in's PRE / POST multi-out). A track's
+//  voice state depends only on its own notes (seeded noise included), so a
+//  stem is the same, sample for sample, as that track's output in a full
+//  render; dry stems therefore sum to the dry mix. The master output runs
+//  every track through the shared FX chain (drive, compressor), which no sum
+//  of stems reproduces, so the stems are summed against a dry master: the
+//  main output with the FX chain bypassed. --verify renders the song once
+//  more with every track on its PRE output and compares each dry stem with
+//  it bit for bit, then adds those outputs up and compares the sum with a
+//  dry master render (it must stay below kSumToleranceDb: the same samples
+//  added in another order differ in the last bits).
+//
+//  Segments split one long render across cores. Each keeps only its part;
+//  the parts are joined as they are, with no crossfade. Voices restart
+//  completely at every trigger, so a segment starts early enough to play
+//  every voice that sounds at its first slot from its trigger: at the last
+//  hit before that slot on every track whose notes hold (Lead, Pad: until
+//  the track plays again; Sample: up to a minute), and at least --preroll
+//  seconds before the slot, for the delay and reverb tails (long enough at
+//  the default feedback). It starts on the song's own clock and block grid.
+//  A held part that plays rarely makes its segments start far back, which
+//  costs time but never changes the join. --verify renders the whole
+//  song serially, compares the join with it (it must stay below
+//  kJoinToleranceDb) and, at every segment start, checks that an engine
+//  snapshot restored there renders the same block bit for bit.
+//
+//    cmake -B build -DOBSTACLE_RENDER=ON && cmake --build build --target obstacle_render
+// ─────────────────────────────────────────────────────────────────────────────
+#include <JuceHeader.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "PluginProcessor.h"
+
+static constexpr int    kTicksPerQuarter = 960;
+static constexpr double kJoinToleranceDb = -120.0;   // dBFS, under a 20-bit step
+static constexpr double kSumToleranceDb  = -110.0;   // dBFS, float rounding of up to 16 tracks
+
+struct Options
+{
+    double            sampleRate = 48000.0;
+    int               blockSize  = 512;
+    int               bits       = 24;
+    juce::int64       maxSamples = 0;
+    bool              multiCore  = false;
+    juce::MemoryBlock state;         // empty: default session
+    juce::String      preset;
+};
+
+// One processor instance rendering to one file. Set up on the main thread,
+// rendered on any thread: instances share nothing.
+struct RenderJob
+{
+    std::unique_ptr<ObstacleProcessor>       proc;
+    int                                      bus = 0;   // written to the file: 0 = main, t + 1 = track t,
+                                                        // -1 = every track bus added up
+    juce::File                               file;
+    std::unique_ptr<juce::AudioFormatWriter> writer;    // none: verification only
+    bool                                     collectMidi = false;
+
+    // Clock samples: the first block starts at `start`; [from, end) is kept
+    juce::int64 start = 0, from = 0, end = std::numeric_limits<juce::int64>::max();
+
+    // Blocks to check snapshot / restore on (the block holding each sample)
+    std::vector<juce::int64> checkpoints;
+
+    // Results; hash = FNV-1a over channel 0 of every enabled bus (kept part)
+    juce::MidiMessageSequence            midi;   // in samples
+    std::array<uint64_t, MAX_TRACKS + 1> hash {};
+    juce::int64 rendered    = 0;     // samples kept
+    double      busy        = 0.0;   // seconds spent in processBlock
+    int         restoreMismatches = 0;
+    bool        writeFailed = false;
+};
+
+static int fail (const juce::String& message)
+{
+    std::fprintf (stderr, "obstacle_render: %s\n", message.toRawUTF8());
+    return 1;
+}
+
+static juce::String optionValue (const juce::ArgumentList& args, const char* option, const char* fallback)
+{
+    return args.containsOption (option) ? args.getValueForOption (option) : juce::String (fallback);
+}
+
+// First library entry whose name contains `name`, exact (case-insensitive) matches first
+static int findPreset (const PatternLibrary& library, const juce::String& name)
+{
+    int total = 0;
+    const auto matches = library.find (name, 0, library.size(), total);
+    for (int index : matches)
+    {
+        PatternLibrary::Entry entry;
+        if (library.getEntry (index, entry) && entry.name.equalsIgnoreCase (name))
+            return index;
+    }
+    return matches.empty() ? -1 : matches.front();
+}
+
+// A processor with the session loaded; nullptr if the preset is missing
+static std::unique_ptr<ObstacleProcessor> loadSession (const Options& opt)
+{
+    auto proc = std::make_unique<ObstacleProcessor>();
+    if (! opt.state.isEmpty())
+        proc->setStateInformation (opt.state.getData(), (int)opt.state.getSize());
+
+    if (opt.preset.isNotEmpty())
+    {
+        const int index = findPreset (proc->library, opt.preset);
+        if (index < 0 || ! proc->loadFromLibrary (index))
+            return nullptr;
+    }
+    return proc;
+}
+
+static std::unique_ptr<juce::AudioFormatWriter> makeWriter (const juce::File& file, double sampleRate, int bits)
+{
+    file.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream = file.createOutputStream();
+    if (stream == nullptr)
+        return nullptr;
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate, 2,
+                                                                          bits, {}, 0));
+    if (writer != nullptr)
+        stream.release();   // owned by the writer
+    return writer;
+}
+
+static std::unique_ptr<juce::AudioFormatReader> makeReader (const juce::File& file)
+{
+    juce::WavAudioFormat wav;
+    return std::unique_ptr<juce::AudioFormatReader> (wav.createReaderFor (file.createInputStream().release(), true));
+}
+
+// Offline: no play head, so the processor runs on its own clock; with loop
+// mode off it stops itself at the end of the chain (main thread)
+static void prepare (RenderJob& job, const Options& opt)
+{
+    auto& proc = *job.proc;
+    proc.setNonRealtime (true);
+    proc.setRateAndBufferSizeDetails (opt.sampleRate, opt.blockSize);
+    proc.prepareToPlay (opt.sampleRate, opt.blockSize);
+    proc.setMultiCore (opt.multiCore);
+    proc.songLoopMode = false;
+    if (job.start > 0)
+        proc.startSongAt (job.start);
+    proc.playing.store (true);
+}
+
+static void render (RenderJob& job, const Options& opt)
+{
+    auto& proc = *job.proc;
+    const int blockSize = opt.blockSize;
+
+    juce::AudioBuffer<float> buffer (juce::jmax (2, proc.getTotalNumOutputChannels()), blockSize);
+    juce::AudioBuffer<float> first;   // a checkpoint block before the restore
+    juce::AudioBuffer<float> sum (2, job.bus < 0 ? blockSize : 0);
+    juce::MidiBuffer midi;
+    std::unique_ptr<ObstacleProcessor::EngineState> snapshot;
+    if (! job.checkpoints.empty())
+    {
+        snapshot = std::make_unique<ObstacleProcessor::EngineState>();
+        first.makeCopyOf (buffer);
+    }
+
+    // First channel of each bus in the block buffer (-1 = disabled)
+    std::array<int, MAX_TRACKS + 1> channel;
+    for (int b = 0; b <= MAX_TRACKS; ++b)
+    {
+        const auto* bus = proc.getBus (false, b);
+        channel[(size_t)b] = bus != nullptr && bus->isEnabled() ? bus->getChannelIndexInProcessBlockBuffer (0) : -1;
+    }
+    for (auto& h : job.hash)
+        h = 0xcbf29ce484222325ull;
+
+    auto nextCheck = job.checkpoints.begin();
+    for (juce::int64 pos = job.start; proc.playing.load() && pos < job.end && pos < opt.maxSamples; pos += blockSize)
+    {
+        // Checkpoint: render the block, rewind to the snapshot, render it again
+        const bool check = nextCheck != job.checkpoints.end() && *nextCheck < pos + blockSize;
+        if (check)
+        {
+            ++nextCheck;
+            proc.saveEngine (*snapshot);
+            midi.clear();
+            proc.processBlock (first, midi);
+            proc.restoreEngine (*snapshot);
+        }
+
+        // The buffer goes in as MIDI input: it must not replay the last block's output
+        midi.clear();
+        const auto t0 = std::chrono::steady_clock::now();
+        proc.processBlock (buffer, midi);
+        job.busy += std::chrono::duration<double> (std::chrono::steady_clock::now() - t0).count();
+
+        if (check)
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                if (std::memcmp (first.getReadPointer (ch), buffer.getReadPointer (ch), sizeof (float) * (size_t)blockSize) != 0)
+                {
+                    ++job.restoreMismatches;
+                    break;
+                }
+
+        // The part of this block to keep
+        const int keep0 = (int)juce::jlimit ((juce::int64)0, (juce::int64)blockSize, job.from - pos);
+        const int keep1 = (int)juce::jlimit ((juce::int64)0, (juce::int64)blockSize, job.end - pos);
+        if (keep1 <= keep0)
+            continue;
+
+        if (job.writer != nullptr)
+        {
+            const float* out[2] = {};
+            if (job.bus < 0)
+            {
+                sum.clear();
+                for (int b = 1; b <= MAX_TRACKS; ++b)
+                    if (const int ch = channel[(size_t)b]; ch >= 0)
+                        for (int c = 0; c < 2; ++c)
+                        {
+                            const float* x = buffer.getReadPointer (ch + c);
+                            float*       s = sum.getWritePointer (c);
+                            for (int i = keep0; i < keep1; ++i)
+                                s[i] += x[i];
+                        }
+                out[0] = sum.getReadPointer (0) + keep0;
+                out[1] = sum.getReadPointer (1) + keep0;
+            }
+            else
+            {
+                const int ch = channel[(size_t)job.bus];
+                out[0] = buffer.getReadPointer (ch) + keep0;
+                out[1] = buffer.getReadPointer (ch + 1) + keep0;
+            }
+            if (! job.writer->writeFromFloatArrays (out, 2, keep1 - keep0))
+            {
+                job.writeFailed = true;
+                return;
+            }
+        }
+
+        for (int b = 0; b <= MAX_TRACKS; ++b)
+        {
+            if (channel[(size_t)b] < 0) continue;
+            const float* x = buffer.getReadPointer (channel[(size_t)b]);
+            uint64_t h = job.hash[(size_t)b];
+            for (int i = keep0; i < keep1; ++i)
+            {
+                uint32_t bits;
+                std::memcpy (&bits, x + i, sizeof bits);
+                h = (h ^ bits) * 0x100000001b3ull;
+            }
+            job.hash[(size_t)b] = h;
+        }
+
+        if (job.collectMidi)
+            for (const auto meta : midi)
+                if (meta.samplePosition >= keep0 && meta.samplePosition < keep1)
+                    job.midi.addEvent (meta.getMessage(), (double)(pos + meta.samplePosition));
+
+        job.rendered += keep1 - keep0;
+    }
+
+    job.writer.reset();   // flush on this thread
+    proc.releaseResources();
+}
+
+// Every job on the first free thread; returns the wall time
+static double runJobs (std::vector<std::unique_ptr<RenderJob>>& jobs, const Options& opt, int threads)
+{
+    std::atomic<size_t> nextJob { 0 };
+    std::vector<std::thread> pool;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < threads; ++i)
+        pool.emplace_back ([&] {
+            for (size_t j; (j = nextJob.fetch_add (1)) < jobs.size();)
+                render (*jobs[j], opt);
+        });
+    for (auto& thread : pool)
+        thread.join();
+
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+}
+
+// Segment starts: the slot boundary nearest each equal share of the song
+static std::vector<int> planSegments (const ObstacleProcessor& proc, int numSegments)
+{
+    const int         numSlots = proc.songChainLength;
+    const juce::int64 total    = proc.getSlotStartSample (numSlots);
+
+    std::vector<int> slots { 0 };
+    int slot = 1;
+    for (int k = 1; k < numSegments; ++k)
+    {
+        const juce::int64 want = total * k / numSegments;
+        while (slot + 1 < numSlots
+               && std::abs (proc.getSlotStartSample (slot + 1) - want) <= std::abs (proc.getSlotStartSample (slot) - want))
+            ++slot;
+        if (slot < numSlots && proc.getSlotStartSample (slot) > proc.getSlotStartSample (slots.back()))
+            slots.push_back (slot++);
+    }
+    return slots;
+}
+
+// Largest difference between the files played back to back (the segments,
+// or one sum of stems) and a reference render; false if they are not the
+// same length
+static bool compareJoin (const std::vector<juce::File>& parts, const juce::File& whole,
+                         float& maxDiff, juce::int64& maxAt)
+{
+    auto reference = makeReader (whole);
+    if (reference == nullptr)
+        return false;
+
+    constexpr int kChunk = 8192;
+    juce::AudioBuffer<float> a (2, kChunk), b (2, kChunk);
+    juce::int64 pos = 0;
+    maxDiff = 0.f;
+    maxAt   = 0;
+
+    for (const auto& part : parts)
+    {
+        auto reader = makeReader (part);
+        if (reader == nullptr)
+            return false;
+
+        for (juce::int64 p = 0; p < reader->lengthInSamples; p += kChunk)
+        {
+            const int n = (int)juce::jmin ((juce::int64)kChunk, reader->lengthInSamples - p);
+            reader->read (&a, 0, n, p, true, true);
+            reference->read (&b, 0, n, pos, true, true);
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < n; ++i)
+                    if (const float d = std::abs (a.getSample (ch, i) - b.getSample (ch, i)); d > maxDiff)
+                    {
+                        maxDiff = d;
+                        maxAt   = pos + i;
+                    }
+            pos += n;
+        }
+    }
+    return pos == reference->lengthInSamples;
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;   // message manager for the processors' timers
+
+    juce::ArgumentList args (argc, argv);
+    Options opt;
+    opt.sampleRate = optionValue (args, "--rate", "48000").getDoubleValue();
+    opt.blockSize  = optionValue (args, "--block", "512").getIntValue();
+    opt.bits       = optionValue (args, "--bits", "24").getIntValue();
+    opt.maxSamples = (juce::int64)(optionValue (args, "--max-seconds", "3600").getDoubleValue() * opt.sampleRate);
+    opt.multiCore  = args.containsOption ("--multicore");
+    opt.preset     = optionValue (args, "--preset", "");
+
+    const bool   stems       = args.containsOption ("--stems");
+    const bool   stemsFx     = args.containsOption ("--stems-fx");
+    const bool   verify      = args.containsOption ("--verify");
+    const int    numSegments = optionValue (args, "--segments", "1").getIntValue();
+    const double preroll     = optionValue (args, "--preroll", "8").getDoubleValue();
+    const int    threads     = args.containsOption ("--jobs") ? args.getValueForOption ("--jobs").getIntValue()
+                                                              : (int)std::thread::hardware_concurrency();
+
+    if (opt.sampleRate < 8000.0 || opt.sampleRate > 384000.0) return fail ("sample rate out of range");
+    if (opt.blockSize < 16 || opt.blockSize > 65536)           return fail ("block size out of range");
+    if (opt.bits != 16 && opt.bits != 24 && opt.bits != 32)    return fail ("bits must be 16, 24 or 32");
+    if (numSegments < 1 || numSegments > 4096)                 return fail ("--segments out of range");
+    if (preroll < 0.0)                                         return fail ("--preroll must not be negative");
+    if (stemsFx && ! stems)                                    return fail ("--stems-fx needs --stems");
+    if (stems && numSegments > 1)                              return fail ("--stems and --segments do not mix");
+    if (verify && ! stems && numSegments == 1)                 return fail ("--verify needs --stems or --segments");
+    if (verify && stemsFx)                                     return fail ("--verify compares dry stems only");
+    if (verify && opt.multiCore)                               return fail ("--verify needs one thread per render (no --multicore)");
+
+    if (args.size() > 0 && ! args[0].isOption())
+    {
+        const auto stateFile = args[0].resolveAsFile();
+        if (! stateFile.loadFileAsData (opt.state) || opt.state.isEmpty())
+            return fail ("cannot read " + stateFile.getFullPathName());
+    }
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+    // ── Jobs: the master (or the first segment), then one per track or
+    //    segment, then the verification render ────────────────────────────────
+    std::vector<std::unique_ptr<RenderJob>> jobs;
+    auto addJob = [&]() -> RenderJob& {
+        auto job  = std::make_unique<RenderJob>();
+        job->proc = loadSession (opt);
+        jobs.push_back (std::move (job));
+        return *jobs.back();
+    };
+
+    auto& master = addJob();
+    if (master.proc == nullptr)
+        return fail ("no library entry named \"" + opt.preset + "\"");
+
+    const auto outFile = cwd.getChildFile (optionValue (args, "-o|--out", "render.wav"));
+    master.file        = outFile;
+    master.collectMidi = args.containsOption ("--midi");
+
+    const int numTracks = master.proc->layout.numTracks;
+    std::vector<std::unique_ptr<juce::TemporaryFile>> temps;
+    std::vector<juce::File> segmentFiles;
+    RenderJob* serialStems = nullptr;   // --stems --verify: every track on its PRE output, summed
+    RenderJob* dryMaster   = nullptr;   // and the main output without FX, to compare the sum with
+    juce::int64 longestPreroll = 0;     // --segments: samples played before a segment's part
+
+    auto addTempWriter = [&] (RenderJob& job) {
+        temps.push_back (std::make_unique<juce::TemporaryFile> (".wav"));
+        job.file   = temps.back()->getFile();
+        job.writer = makeWriter (job.file, opt.sampleRate, 32);
+        return job.writer != nullptr;
+    };
+
+    if (numSegments > 1)
+    {
+        // Planned on the prepared clock; every segment's engine starts clean
+        prepare (master, opt);
+        const auto slots = planSegments (*master.proc, numSegments);
+        const auto tail  = (juce::int64)(preroll * opt.sampleRate);
+
+        std::vector<juce::int64> starts;
+        for (int slot : slots)
+            starts.push_back (master.proc->getSlotStartSample (slot));
+
+        for (size_t k = 0; k < starts.size(); ++k)
+        {
+            auto& job = k == 0 ? master : addJob();
+            job.from  = starts[k];
+            job.end   = k + 1 < starts.size() ? starts[k + 1] : std::numeric_limits<juce::int64>::max();
+            const auto warm = juce::jmin (job.from - tail, (juce::int64) master.proc->getHeldNotesStart (slots[k]));
+            job.start = juce::jmax ((juce::int64)0, warm) / opt.blockSize * opt.blockSize;   // the song's block grid
+            longestPreroll = juce::jmax (longestPreroll, job.from - job.start);
+            job.collectMidi = master.collectMidi;
+
+            temps.push_back (std::make_unique<juce::TemporaryFile> (".wav"));
+            job.file   = temps.back()->getFile();
+            job.writer = makeWriter (job.file, opt.sampleRate, 32);
+            if (job.writer == nullptr)
+                return fail ("cannot write " + job.file.getFullPathName());
+            segmentFiles.push_back (job.file);
+        }
+
+        if (verify)
+        {
+            auto& serial = addJob();
+            temps.push_back (std::make_unique<juce::TemporaryFile> (".wav"));
+            serial.file        = temps.back()->getFile();
+            serial.writer      = makeWriter (serial.file, opt.sampleRate, 32);
+            serial.checkpoints = std::vector<juce::int64> (starts.begin() + 1, starts.end());
+            if (serial.writer == nullptr)
+                return fail ("cannot write " + serial.file.getFullPathName());
+        }
+    }
+    else
+    {
+        master.writer = makeWriter (outFile, opt.sampleRate, opt.bits);
+        if (master.writer == nullptr)
+            return fail ("cannot write " + outFile.getFullPathName());
+    }
+
+    if (stems)
+    {
+        const auto dir = cwd.getChildFile (args.getValueForOption ("--stems"));
+        if (! dir.createDirectory())
+            return fail ("cannot create " + dir.getFullPathName());
+
+        for (int t = 0; t < numTracks; ++t)
+        {
+            auto& job  = addJob();
+            auto& proc = *job.proc;
+            for (int u = 0; u < numTracks; ++u)
+                if (u != t)
+                    *proc.trackMuteParam[u] = true;   // no notes: costs nothing
+            proc.setTrackOutput (t, stemsFx ? ObstacleProcessor::OUT_AUX_POST : ObstacleProcessor::OUT_AUX_PRE);
+            proc.getBus (false, t + 1)->enable();
+
+            job.bus    = t + 1;
+            job.file   = dir.getChildFile (juce::String (t + 1).paddedLeft ('0', 2) + " "
+                                           + kVoiceTypeNames[proc.layout.voice[(size_t)t]] + ".wav");
+            job.writer = makeWriter (job.file, opt.sampleRate, opt.bits);
+            if (job.writer == nullptr)
+                return fail ("cannot write " + job.file.getFullPathName());
+        }
+
+        if (verify)
+        {
+            serialStems = &addJob();
+            serialStems->bus = -1;
+            for (int t = 0; t < numTracks; ++t)
+            {
+                serialStems->proc->setTrackOutput (t, ObstacleProcessor::OUT_AUX_PRE);
+                serialStems->proc->getBus (false, t + 1)->enable();
+            }
+
+            dryMaster = &addJob();
+            dryMaster->proc->setDryMaster (true);
+            for (int t = 0; t < numTracks; ++t)
+                dryMaster->proc->setTrackOutput (t, ObstacleProcessor::OUT_MAIN);
+
+            for (auto* job : { serialStems, dryMaster })
+                if (! addTempWriter (*job))
+                    return fail ("cannot write " + job->file.getFullPathName());
+        }
+    }
+
+    // ── Render ───────────────────────────────────────────────────────────────
+    for (auto& job : jobs)
+        prepare (*job, opt);
+
+    const int    numThreads = juce::jlimit (1, (int)jobs.size(), threads);
+    const double wall       = runJobs (jobs, opt, numThreads);
+
+    for (const auto& job : jobs)
+        if (job->writeFailed)
+            return fail ("write failed: " + job->file.getFullPathName());
+
+    // Segments, back to back, without crossfades
+    juce::int64 rendered = master.rendered;
+    if (numSegments > 1)
+    {
+        auto writer = makeWriter (outFile, opt.sampleRate, opt.bits);
+        if (writer == nullptr)
+            return fail ("cannot write " + outFile.getFullPathName());
+
+        rendered = 0;
+        for (const auto& f : segmentFiles)
+        {
+            auto reader = makeReader (f);
+            if (reader == nullptr || ! writer->writeFromAudioReader (*reader, 0, -1))
+                return fail ("write failed: " + outFile.getFullPathName());
+            rendered += reader->lengthInSamples;
+        }
+    }
+
+    if (master.collectMidi)
+    {
+        // Sample positions → ticks at the session tempo (fixed: no host, no automation)
+        const double bpm = master.proc->bpm.load();
+        juce::MidiMessageSequence triggers;
+        for (const auto& job : jobs)
+            if (job->collectMidi)
+                triggers.addSequence (job->midi, 0.0);
+        for (auto* e : triggers)
+            e->message.setTimeStamp (e->message.getTimeStamp() / opt.sampleRate * bpm / 60.0 * kTicksPerQuarter);
+
+        triggers.addEvent (juce::MidiMessage::tempoMetaEvent ((int)std::lround (60'000'000.0 / bpm)), 0.0);
+        triggers.sort();
+        triggers.updateMatchedPairs();
+
+        juce::MidiFile file;
+        file.setTicksPerQuarterNote (kTicksPerQuarter);
+        file.addTrack (triggers);
+
+        const auto midiFile = cwd.getChildFile (args.getValueForOption ("--midi"));
+        midiFile.deleteFile();
+        juce::FileOutputStream out (midiFile);
+        if (! out.openedOk() || ! file.writeTo (out))
+            return fail ("cannot write " + midiFile.getFullPathName());
+    }
+
+    // ── Report: real-time factor of the engine alone and of the whole run ────
+    const double seconds = (double)rendered / opt.sampleRate;
+    double busy = 0.0;
+    for (const auto& job : jobs)
+        busy += job->busy;
+
+    std::printf ("%s: %.1f s at %.0f Hz%s\n", outFile.getFileName().toRawUTF8(), seconds, opt.sampleRate,
+                 rendered >= opt.maxSamples ? " (stopped at --max-seconds)" : "");
+
+    if (jobs.size() == 1)
+        std::printf ("engine %.3f s = %.1fx real time, total %.3f s = %.1fx real time\n",
+                     busy, busy > 0.0 ? seconds / busy : 0.0, wall, wall > 0.0 ? seconds / wall : 0.0);
+    else
+        std::printf ("%d renders on %d threads: engine %.3f s, wall %.3f s = %.2fx parallel speedup, "
+                     "song at %.1fx real time\n",
+                     (int)jobs.size(), numThreads, busy, wall, wall > 0.0 ? busy / wall : 0.0,
+                     wall > 0.0 ? seconds / wall : 0.0);
+
+    if (verify && stems)
+    {
+        const auto& serial = *serialStems;
+        int mismatches = 0;
+        for (int t = 0; t < numTracks; ++t)
+            if (jobs[(size_t)t + 1]->hash[(size_t)t + 1] != serial.hash[(size_t)t + 1])
+            {
+                std::printf ("stem %d differs from the serial render\n", t + 1);
+                ++mismatches;
+            }
+        if (mismatches > 0)
+            return 1;
+        std::printf ("%d stems match the serial multi-out render bit for bit\n", numTracks);
+
+        // Bit-identical stems: their sum is the serial render's sum of track outputs
+        float       maxDiff = 0.f;
+        juce::int64 maxAt   = 0;
+        const bool  sameLength = compareJoin ({ serial.file }, dryMaster->file, maxDiff, maxAt);
+        const double db = juce::Decibels::gainToDecibels (maxDiff, -200.f);
+
+        std::printf ("sum of stems vs dry master: max difference %.1f dBFS at %.3f s%s\n",
+                     db, (double)maxAt / opt.sampleRate, sameLength ? "" : ", lengths differ");
+        if (! sameLength || db > kSumToleranceDb)
+            return 1;
+    }
+
+    if (verify && numSegments > 1)
+    {
+        const auto& serial = *jobs.back();
+        float       maxDiff = 0.f;
+        juce::int64 maxAt   = 0;
+        const bool  sameLength = compareJoin (segmentFiles, serial.file, maxDiff, maxAt);
+        const double db = juce::Decibels::gainToDecibels (maxDiff, -200.f);
+
+        std::printf ("%d segments (up to %.1f s pre-roll) vs serial render: max difference %.1f dBFS at %.3f s%s\n",
+                     (int)segmentFiles.size(), (double)longestPreroll / opt.sampleRate, db, (double)maxAt / opt.sampleRate,
+                     sameLength ? "" : ", lengths differ");
+        std::printf ("snapshot restore at %d segment starts: %d blocks differ\n",
+                     (int)serial.checkpoints.size(), serial.restoreMismatches);
+
+        if (! sameLength || db > kJoinToleranceDb || serial.restoreMismatches > 0)
+            return 1;
+    }
+    return 0;
+}